@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////////
+// AppendOnlyVector.h
+//
+// class template AppendOnlyVector
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef APPEND_ONLY_VECTOR_H
+#define APPEND_ONLY_VECTOR_H
+
+#include <atomic> // std::atomic
+#include <cstddef> // std::size_t
+#include <utility> // std::move
+
+namespace PackageTracking {
+
+  // An AppendOnlyVector is a sequence that one writer grows at the
+  // back while any number of readers index into it without locks.
+  //
+  // Elements live in chunks of 64, 128, 256, ... elements, which are
+  // allocated as needed and never moved or freed before the vector
+  // is, so a reference to an element stays valid as long as the
+  // vector does. The writer publishes each element by storing the new
+  // size with release ordering; a reader that loads the size with
+  // acquire ordering (through Size) may then read every element below
+  // it.
+  //
+  // Calls to PushBack must not overlap each other; callers with more
+  // than one writer must serialize them.
+  template <typename T>
+  class AppendOnlyVector {
+  public:
+
+    AppendOnlyVector() noexcept
+    : size_(0) {
+      for (std::atomic<T*>& chunk : chunks_) {
+	chunk.store(nullptr, std::memory_order_relaxed);
+      }
+    }
+
+    ~AppendOnlyVector() {
+      for (std::atomic<T*>& chunk : chunks_) {
+	delete[] chunk.load(std::memory_order_relaxed);
+      }
+    }
+
+    AppendOnlyVector(const AppendOnlyVector&) = delete;
+    AppendOnlyVector& operator=(const AppendOnlyVector&) = delete;
+
+    // Number of published elements.
+    std::size_t Size() const noexcept {
+      return size_.load(std::memory_order_acquire);
+    }
+
+    // Number of elements the allocated chunks have room for.
+    std::size_t Capacity() const noexcept {
+      std::size_t size = Size();
+      if (size == 0) {
+	return 0;
+      }
+      std::size_t chunk, offset;
+      Locate(size - 1, chunk, offset);
+      return kFirstChunkSize * ((std::size_t(2) << chunk) - 1);
+    }
+
+    // Return the element at index, which must be below a value
+    // returned by Size.
+    const T& operator[](std::size_t index) const noexcept {
+      std::size_t chunk, offset;
+      Locate(index, chunk, offset);
+      return chunks_[chunk].load(std::memory_order_acquire)[offset];
+    }
+
+    // Append value, and publish it to readers.
+    void PushBack(T value) {
+      std::size_t index = size_.load(std::memory_order_relaxed), chunk, offset;
+      Locate(index, chunk, offset);
+      T* elements = chunks_[chunk].load(std::memory_order_relaxed);
+      if (elements == nullptr) {
+	elements = new T[kFirstChunkSize << chunk];
+	chunks_[chunk].store(elements, std::memory_order_release);
+      }
+      elements[offset] = std::move(value);
+      size_.store(index + 1, std::memory_order_release);
+    }
+
+  private:
+    static constexpr std::size_t kFirstChunkBits = 6,
+      kFirstChunkSize = std::size_t(1) << kFirstChunkBits,
+      kChunks = 40;
+
+    // Find the chunk that holds index, and its offset within it.
+    // Chunk k starts at index kFirstChunkSize * (2^k - 1).
+    static void Locate(std::size_t index, std::size_t& chunk, std::size_t& offset) noexcept {
+      std::size_t biased = index + kFirstChunkSize;
+      unsigned top = 8 * sizeof(unsigned long long) - 1 - __builtin_clzll(biased);
+      chunk = top - kFirstChunkBits;
+      offset = biased - (std::size_t(1) << top);
+    }
+
+    std::atomic<T*> chunks_[kChunks];
+    std::atomic<std::size_t> size_;
+  };
+
+}
+
+#endif
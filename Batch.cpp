@@ -0,0 +1,224 @@
+////////////////////////////////////////////////////////////////////////////////
+// Batch.cpp
+//
+// Answering many track queries in one run.
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Batch.h"
+
+#include <condition_variable> // std::condition_variable
+#include <deque> // std::deque
+#include <memory> // std::shared_ptr, std::make_shared
+#include <mutex> // std::mutex, std::lock_guard, std::unique_lock
+#include <stdexcept> // std::invalid_argument
+#include <string> // std::string, std::getline
+#include <unordered_map> // std::unordered_map
+
+#include "PackageStatus.h"
+#include "Query.h"
+#include "Serialize.h"
+#include "Stats.h"
+#include "ThreadPool.h"
+
+namespace PackageTracking {
+
+  namespace {
+
+    // Output is written once this much of it is buffered.
+    constexpr std::size_t kFlushSize = 1 << 16;
+
+    // At most this many queries per worker are read ahead of the
+    // oldest one not yet written.
+    constexpr std::size_t kWindowPerThread = 64;
+
+    struct File;
+
+    // One line of input, and its answer once it has one. done is
+    // guarded by the window's mutex.
+    struct Entry {
+      std::string line;
+      Query query;
+      std::shared_ptr<File> file;
+      std::string answer;
+      bool failed = false;
+      bool done = false;
+    };
+
+    // A file named by queries in the window. Its queries are answered
+    // in order by one task at a time, which loads the file the first
+    // time. queue and running are guarded by mutex; the rest belongs
+    // to the running task.
+    struct File {
+      std::mutex mutex;
+      std::deque<Entry*> queue;
+      bool running = false;
+      bool loaded = false;
+      std::string error;
+      PackageStatus status;
+      // entries in the window that name this file; touched only by the
+      // reading thread
+      std::size_t uses = 0;
+    };
+
+    void Fail(Entry& entry, const std::string& message) {
+      entry.answer = "error: " + message + "\n";
+      entry.failed = true;
+    }
+
+    // The queries read but not yet written, oldest first, and the
+    // files they name.
+    class Window {
+    public:
+      Window(std::ostream& output, unsigned threads)
+      : output_(output), failures_(0), pool_(threads) { }
+
+      std::size_t Capacity() const noexcept {
+	return kWindowPerThread * pool_.Size();
+      }
+
+      std::size_t Size() const noexcept {
+	return entries_.size();
+      }
+
+      // Add the query on line, and start answering it.
+      void Add(const std::string& line) {
+	entries_.emplace_back();
+	Entry& entry = entries_.back();
+	entry.line = line;
+	std::string error;
+	if (!ParseQuery(line, entry.query, error)) {
+	  Fail(entry, error);
+	  entry.done = true;
+	  return;
+	}
+	std::shared_ptr<File>& file = files_[entry.query.path];
+	if (!file) {
+	  file = std::make_shared<File>();
+	}
+	file->uses++;
+	entry.file = file;
+
+	std::lock_guard<std::mutex> lock(file->mutex);
+	file->queue.push_back(&entry);
+	if (!file->running) {
+	  file->running = true;
+	  pool_.Submit([this, file] { Answer(*file); });
+	}
+      }
+
+      // Wait for the oldest query's answer, and write it.
+      void WriteOldest() {
+	Entry& entry = entries_.front();
+	{
+	  std::unique_lock<std::mutex> lock(mutex_);
+	  if (!entry.done) {
+	    // the workers are behind, so let the reader have what is ready
+	    // while this one is answered
+	    lock.unlock();
+	    if (!buffer_.empty()) {
+	      Flush();
+	    }
+	    lock.lock();
+	    done_.wait(lock, [&] { return entry.done; });
+	  }
+	}
+	failures_ += entry.failed;
+	buffer_ += "==> ";
+	buffer_ += entry.line;
+	buffer_ += " <==\n";
+	buffer_ += entry.answer;
+	if (buffer_.size() >= kFlushSize) {
+	  Flush();
+	}
+	if (entry.file && (--entry.file->uses == 0)) {
+	  files_.erase(entry.query.path);
+	}
+	entries_.pop_front();
+      }
+
+      void Flush() {
+	output_.write(buffer_.data(), buffer_.size());
+	output_.flush();
+	buffer_.clear();
+      }
+
+      std::size_t Failures() const noexcept {
+	return failures_;
+      }
+
+    private:
+      // Answer file's queued queries until there are none left.
+      void Answer(File& file) {
+	TRACK_SPAN("AnswerFile");
+	for (;;) {
+	  Entry* entry;
+	  {
+	    std::lock_guard<std::mutex> lock(file.mutex);
+	    if (file.queue.empty()) {
+	      file.running = false;
+	      return;
+	    }
+	    entry = file.queue.front();
+	    file.queue.pop_front();
+	  }
+	  if (!file.loaded) {
+	    file.loaded = true;
+	    try {
+	      file.status = PackageStatusFromJSON(entry->query.path);
+	    } catch (std::invalid_argument& e) {
+	      file.error = e.what();
+	    }
+	  }
+	  if (!file.error.empty()) {
+	    Fail(*entry, file.error);
+	  } else if (!DescribeQuery(file.status, entry->query, entry->answer)) {
+	    Fail(*entry, "index out of range");
+	  }
+	  std::lock_guard<std::mutex> lock(mutex_);
+	  entry->done = true;
+	  done_.notify_one();
+	}
+      }
+
+      std::ostream& output_;
+      std::string buffer_;
+      std::size_t failures_;
+
+      // a deque, so adding and removing entries at the ends leaves the
+      // others where the tasks answering them expect
+      std::deque<Entry> entries_;
+      std::unordered_map<std::string, std::shared_ptr<File>> files_;
+
+      std::mutex mutex_;
+      std::condition_variable done_;
+
+      // last, so it finishes its tasks before the rest is destroyed
+      ThreadPool pool_;
+    };
+
+  }
+
+  std::size_t AnswerQueries(std::istream& input, std::ostream& output, unsigned threads) {
+    TRACK_SPAN("AnswerQueries");
+
+    Window window(output, threads);
+    std::string line;
+    while (std::getline(input, line)) {
+      std::size_t end = line.find_last_not_of(" \t\r");
+      if (end == std::string::npos) {
+	continue;
+      }
+      line.resize(end + 1);
+      window.Add(line);
+      if (window.Size() >= window.Capacity()) {
+	window.WriteOldest();
+      }
+    }
+    while (window.Size() > 0) {
+      window.WriteOldest();
+    }
+    window.Flush();
+    return window.Failures();
+  }
+
+}
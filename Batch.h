@@ -0,0 +1,41 @@
+////////////////////////////////////////////////////////////////////////////////
+// Batch.h
+//
+// Answering many track queries in one run.
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstddef> // std::size_t
+#include <istream> // std::istream
+#include <ostream> // std::ostream
+
+namespace PackageTracking {
+
+  // Answer the queries in input, one per line in the forms ParseQuery
+  // accepts; blank lines are skipped. Each query's answer is written
+  // to output under a header line
+  //
+  //   ==> <QUERY> <==
+  //
+  // in input order, with an error such as an index out of range
+  // written in its place as "error: <MESSAGE>".
+  //
+  // Input is read as the queries are answered, keeping at most 64 per
+  // worker in flight ahead of the oldest unwritten answer, so memory
+  // stays bounded however long input is. The queries are answered on
+  // a ThreadPool with threads workers (0 means one per core). The
+  // queries in flight that name the same file are answered in order
+  // by one task, which loads the file once for all of them. Every
+  // query seeks the cursor itself, so its answer is the same as a
+  // separate track run would give. Output goes through one buffer,
+  // written in large blocks, or whenever the oldest answer is not
+  // ready yet.
+  //
+  // Returns the number of queries that failed.
+  std::size_t AnswerQueries(std::istream& input, std::ostream& output, unsigned threads = 0);
+
+}
+
+#endif
@@ -0,0 +1,334 @@
+////////////////////////////////////////////////////////////////////////////////
+// Bench.cpp
+//
+// Benchmarks for the hot paths of ShippingUpdate and PackageStatus,
+// run with Google Benchmark over synthetic histories of 10 to 10
+// million updates. Built and run by `make bench`, which writes the
+// results as JSON to bench.json.
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdint> // std::uint16_t, std::uint64_t
+#include <cstdio> // std::remove
+#include <ctime> // std::time_t
+#include <fstream> // std::ofstream
+#include <map> // std::map
+#include <ostream> // std::ostream
+#include <random> // std::mt19937_64, std::uniform_int_distribution
+#include <streambuf> // std::streambuf
+#include <string> // std::string
+#include <string_view> // std::string_view
+#include <vector> // std::vector
+
+#include "benchmark/benchmark.h"
+
+#include "ShippingUpdate.h"
+#include "PackageStatus.h"
+#include "Serialize.h"
+
+using namespace PackageTracking;
+
+namespace {
+
+  // Every history is generated from this seed, so runs are
+  // comparable across releases.
+  constexpr std::uint64_t kSeed = 20180115;
+
+  // History sizes, and the largest one written out as a file for
+  // PackageStatusFromJSON; a 10 million update file is about 800 MB.
+  constexpr long kMinUpdates = 10, kMaxUpdates = 10000000, kMaxFileUpdates = 1000000;
+
+  // Text drawn from real carrier feeds.
+  const std::vector<std::string_view> kFacilityEvents = {
+    "Shipment arrived at Amazon facility",
+    "Shipment departed from Amazon facility",
+    "Package arrived at a carrier facility",
+    "Package departed from a carrier facility",
+    "Arrived at Facility",
+    "Departed from Facility",
+    "In transit",
+    "Processing at UPS Facility",
+  };
+  const std::vector<std::string_view> kLocations = {
+    "Hebron, KENTUCKY US", "San Bernardino, CALIFORNIA US", "Chino US, CALIFORNIA US",
+    "Ontario, CA US", "Louisville, KY US", "Hodgkins, IL US", "Dallas, TX US",
+    "Atlanta, GA US", "Secaucus, NJ US", "Phoenix, AZ US", "Sacramento, CA US",
+    "Salt Lake City, UT US", "Denver, CO US", "Memphis, TN US", "Fullerton, CA US",
+    "Diamond Bar, US",
+  };
+  constexpr std::string_view kFirstEvent =
+    "Package has left seller facility and is in transit to carrier";
+  constexpr std::string_view kOutForDelivery = "Out for delivery";
+  constexpr std::string_view kDelivered = "Delivered";
+
+  // One generated update, as indices into the tables above; 0 is the
+  // first event, and the tables' sizes stand for out for delivery and
+  // delivered. Compact, so that 10 million of them fit comfortably.
+  struct Event {
+    std::uint16_t description, location;
+    std::time_t timestamp;
+  };
+
+  std::string_view Description(const Event& event) {
+    if (event.description == 0) {
+      return kFirstEvent;
+    } else if (event.description <= kFacilityEvents.size()) {
+      return kFacilityEvents[event.description - 1];
+    }
+    return (event.description == kFacilityEvents.size() + 1) ? kOutForDelivery : kDelivered;
+  }
+
+  std::string_view Location(const Event& event) {
+    return (event.location < kLocations.size()) ? kLocations[event.location] : "N/A";
+  }
+
+  // Generate a history of count updates shaped like a real one: left
+  // the seller, a run of facility scans minutes to a day apart, then
+  // out for delivery and, if delivered, delivered. The same count
+  // always gives the same history.
+  std::vector<Event> GenerateHistory(long count, bool delivered) {
+    std::mt19937_64 random(kSeed);
+    std::uniform_int_distribution<int> event(1, kFacilityEvents.size()),
+      location(0, kLocations.size() - 1), gap(60, 86400);
+    std::vector<Event> history;
+    history.reserve(count);
+    std::time_t timestamp = 1515978000;
+    for (long i = 0; i < count; i++) {
+      Event next{static_cast<std::uint16_t>(event(random)),
+		 static_cast<std::uint16_t>(location(random)), timestamp};
+      if (i == 0) {
+	next = Event{0, static_cast<std::uint16_t>(kLocations.size()), timestamp};
+      } else if (delivered && (i == count - 1)) {
+	next.description = kFacilityEvents.size() + 2;
+      } else if (delivered && (i == count - 2)) {
+	next.description = kFacilityEvents.size() + 1;
+      }
+      history.push_back(next);
+      timestamp += gap(random);
+    }
+    return history;
+  }
+
+  // The undelivered history of count updates, generated once.
+  const std::vector<Event>& History(long count) {
+    static std::map<long, std::vector<Event>> histories;
+    auto it = histories.find(count);
+    if (it == histories.end()) {
+      it = histories.emplace(count, GenerateHistory(count, false)).first;
+    }
+    return it->second;
+  }
+
+  PackageStatus StatusOf(const std::vector<Event>& history) {
+    PackageStatus status("1Z4310X3YW25357495");
+    for (const Event& event : history) {
+      status.AddUpdate(Description(event), Location(event), event.timestamp);
+    }
+    return status;
+  }
+
+  // The path of a package file holding a delivered history of count
+  // updates, written once and removed at exit.
+  const std::string& PackageFile(long count) {
+    struct Files {
+      ~Files() {
+	for (auto& file : paths) {
+	  std::remove(file.second.c_str());
+	}
+      }
+      std::map<long, std::string> paths;
+    };
+    static Files files;
+    auto it = files.paths.find(count);
+    if (it == files.paths.end()) {
+      std::string path = "/tmp/bench_package_" + std::to_string(count) + ".json";
+      std::ofstream out(path);
+      out << "{\n    \"tracking_number\" : \"1Z4310X3YW25357495\",\n    \"updates\" : [";
+      const char* separator = "\n";
+      for (const Event& event : GenerateHistory(count, true)) {
+	out << separator << "\t[\"" << Description(event) << "\", \"" << Location(event)
+	    << "\", " << event.timestamp << "]";
+	separator = ",\n";
+      }
+      out << "\n    ]\n}\n";
+      it = files.paths.emplace(count, path).first;
+    }
+    return it->second;
+  }
+
+  // Discards what is written to it, so ostream benchmarks measure
+  // formatting rather than I/O.
+  class NullBuffer : public std::streambuf {
+  protected:
+    int_type overflow(int_type c) override {
+      return c;
+    }
+    std::streamsize xsputn(const char*, std::streamsize count) override {
+      return count;
+    }
+  };
+
+  void BM_ShippingUpdateDescribe(benchmark::State& state) {
+    ShippingUpdate update(std::string(kFacilityEvents[0]), std::string(kLocations[0]), 1516111440);
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(update.Describe());
+    }
+    state.SetItemsProcessed(state.iterations());
+  }
+
+  void BM_AddUpdate(benchmark::State& state) {
+    const std::vector<Event>& history = History(state.range(0));
+    for (auto _ : state) {
+      PackageStatus status = StatusOf(history);
+      benchmark::DoNotOptimize(status);
+    }
+    state.SetItemsProcessed(state.iterations() * history.size());
+  }
+
+  // One step forward through the whole history, then back.
+  void BM_MoveCursor(benchmark::State& state) {
+    PackageStatus status = StatusOf(History(state.range(0)));
+    for (auto _ : state) {
+      status.SeekCursor(0);
+      while (status.MoveCursorForward()) { }
+      while (status.MoveCursorBackward()) { }
+    }
+    state.SetItemsProcessed(state.iterations() * 2 * (status.Size() - 1));
+  }
+
+  void BM_SeekCursor(benchmark::State& state) {
+    PackageStatus status = StatusOf(History(state.range(0)));
+    std::mt19937_64 random(kSeed);
+    std::uniform_int_distribution<int> index(0, status.Size() - 1);
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(status.SeekCursor(index(random)));
+    }
+    state.SetItemsProcessed(state.iterations());
+  }
+
+  void BM_SeekCursorToTime(benchmark::State& state) {
+    const std::vector<Event>& history = History(state.range(0));
+    PackageStatus status = StatusOf(history);
+    std::mt19937_64 random(kSeed);
+    std::uniform_int_distribution<std::time_t> t(history.front().timestamp,
+						 history.back().timestamp);
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(status.SeekCursorToTime(t(random)));
+    }
+    state.SetItemsProcessed(state.iterations());
+  }
+
+  // The Describe*Updates functions, by which updates they describe
+  // and where they write them. After the first call these are served
+  // from the render cache, so Cold measures that first call, writing
+  // to a buffer, on a fresh copy each time.
+  enum class Selection { Previous, Following, All, Between };
+  enum class Destination { String, Buffer, Stream, Sink, View, Cold };
+
+  void BM_DescribeUpdates(benchmark::State& state, Selection selection, Destination destination) {
+    const std::vector<Event>& history = History(state.range(0));
+    const PackageStatus fresh = StatusOf(history);
+    PackageStatus status = fresh;
+    // the cursor, and the time range, cover the middle of the history
+    status.SeekCursor(status.Size() / 2);
+    std::time_t t0 = history[history.size() / 4].timestamp,
+      t1 = history[3 * history.size() / 4].timestamp;
+
+    std::string buffer;
+    NullBuffer null_buffer;
+    std::ostream stream(&null_buffer);
+    std::size_t written = 0;
+    DescribeSink sink = [&written](std::string_view text) { written += text.size(); };
+    for (auto _ : state) {
+      if (destination == Destination::Cold) {
+	state.PauseTiming();
+	status = fresh;
+	status.SeekCursor(status.Size() / 2);
+	state.ResumeTiming();
+      }
+      buffer.clear();
+      switch (selection) {
+      case Selection::Previous:
+	switch (destination) {
+	case Destination::String: benchmark::DoNotOptimize(status.DescribePreviousUpdates()); break;
+	case Destination::Buffer:
+	case Destination::Cold: status.DescribePreviousUpdates(buffer); break;
+	case Destination::Stream: status.DescribePreviousUpdates(stream); break;
+	case Destination::Sink: status.DescribePreviousUpdates(sink); break;
+	case Destination::View: benchmark::DoNotOptimize(status.DescribePreviousUpdatesView()); break;
+	}
+	break;
+      case Selection::Following:
+	switch (destination) {
+	case Destination::String: benchmark::DoNotOptimize(status.DescribeFollowingUpdates()); break;
+	case Destination::Buffer:
+	case Destination::Cold: status.DescribeFollowingUpdates(buffer); break;
+	case Destination::Stream: status.DescribeFollowingUpdates(stream); break;
+	case Destination::Sink: status.DescribeFollowingUpdates(sink); break;
+	case Destination::View: benchmark::DoNotOptimize(status.DescribeFollowingUpdatesView()); break;
+	}
+	break;
+      case Selection::All:
+	switch (destination) {
+	case Destination::String: benchmark::DoNotOptimize(status.DescribeAllUpdates()); break;
+	case Destination::Buffer:
+	case Destination::Cold: status.DescribeAllUpdates(buffer); break;
+	case Destination::Stream: status.DescribeAllUpdates(stream); break;
+	case Destination::Sink: status.DescribeAllUpdates(sink); break;
+	case Destination::View: benchmark::DoNotOptimize(status.DescribeAllUpdatesView()); break;
+	}
+	break;
+      case Selection::Between:
+	switch (destination) {
+	case Destination::String: benchmark::DoNotOptimize(status.DescribeUpdatesBetween(t0, t1)); break;
+	case Destination::Buffer:
+	case Destination::Cold: status.DescribeUpdatesBetween(t0, t1, buffer); break;
+	case Destination::Stream: status.DescribeUpdatesBetween(t0, t1, stream); break;
+	case Destination::Sink: status.DescribeUpdatesBetween(t0, t1, sink); break;
+	case Destination::View: benchmark::DoNotOptimize(status.DescribeUpdatesBetweenView(t0, t1)); break;
+	}
+	break;
+      }
+      benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * status.Size());
+  }
+
+  void BM_PackageStatusFromJSON(benchmark::State& state) {
+    const std::string& path = PackageFile(state.range(0));
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(PackageStatusFromJSON(path));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+  }
+
+}
+
+BENCHMARK(BM_ShippingUpdateDescribe);
+BENCHMARK(BM_AddUpdate)->RangeMultiplier(10)->Range(kMinUpdates, kMaxUpdates)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_MoveCursor)->RangeMultiplier(10)->Range(kMinUpdates, kMaxUpdates)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_SeekCursor)->RangeMultiplier(10)->Range(kMinUpdates, kMaxUpdates);
+BENCHMARK(BM_SeekCursorToTime)->RangeMultiplier(10)->Range(kMinUpdates, kMaxUpdates);
+BENCHMARK(BM_PackageStatusFromJSON)->RangeMultiplier(10)->Range(kMinUpdates, kMaxFileUpdates)->Unit(benchmark::kMicrosecond);
+
+int main(int argc, char** argv) {
+  const char* functions[] = {"DescribePreviousUpdates", "DescribeFollowingUpdates",
+			     "DescribeAllUpdates", "DescribeUpdatesBetween"};
+  const char* destinations[] = {"String", "Buffer", "Stream", "Sink", "View", "Cold"};
+  for (int s = 0; s < 4; s++) {
+    for (int d = 0; d < 6; d++) {
+      std::string name = std::string("BM_") + functions[s] + "/" + destinations[d];
+      benchmark::RegisterBenchmark(name.c_str(), BM_DescribeUpdates,
+				   static_cast<Selection>(s), static_cast<Destination>(d))
+	->RangeMultiplier(10)->Range(kMinUpdates, kMaxUpdates)->Unit(benchmark::kMicrosecond);
+    }
+  }
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::AddCustomContext("seed", std::to_string(kSeed));
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////////////
+// ConcurrentPackage.cpp
+//
+// class ConcurrentPackage
+////////////////////////////////////////////////////////////////////////////////
+
+#include "ConcurrentPackage.h"
+
+#include <algorithm> // std::min
+#include <limits> // std::numeric_limits
+
+namespace PackageTracking {
+
+  ConcurrentPackage::ConcurrentPackage(const std::string& tracking_number,
+				       std::shared_ptr<StringPool> pool)
+  : tracking_number_(tracking_number), pool_(std::move(pool)),
+    last_timestamp_(std::numeric_limits<std::time_t>::min()) { }
+
+  const std::string& ConcurrentPackage::TrackingNumber() const noexcept {
+    return tracking_number_;
+  }
+
+  const StringPool& ConcurrentPackage::Pool() const noexcept {
+    return *pool_;
+  }
+
+  std::size_t ConcurrentPackage::Size() const noexcept {
+    return entries_.Size();
+  }
+
+  void ConcurrentPackage::AddUpdate(std::string_view description,
+				    std::string_view location,
+				    std::time_t timestamp) {
+    if (timestamp < last_timestamp_) {
+      throw std::invalid_argument("Given timestamp is invalid.");
+    }
+    entries_.PushBack(Entry{timestamp, pool_->Intern(description), pool_->Intern(location)});
+    last_timestamp_ = timestamp;
+  }
+
+  ConcurrentPackage::Snapshot ConcurrentPackage::Read() const noexcept {
+    return Snapshot(this, 0, entries_.Size());
+  }
+
+  PackageStatus ConcurrentPackage::ToPackageStatus() const {
+    PackageStatus status(tracking_number_, pool_);
+    for (std::size_t i = 0, size = entries_.Size(); i < size; i++) {
+      status.AddUpdate(UpdateAt(i));
+    }
+    return status;
+  }
+
+  ShippingUpdate ConcurrentPackage::UpdateAt(std::size_t index) const noexcept {
+    const Entry& entry = entries_[index];
+    return ShippingUpdate(*pool_, entry.description, entry.location, entry.timestamp);
+  }
+
+  ConcurrentPackage::Snapshot::Snapshot(const ConcurrentPackage* package,
+					std::size_t first, std::size_t last) noexcept
+  : package_(package), first_(first), last_(last) { }
+
+  std::size_t ConcurrentPackage::Snapshot::Size() const noexcept {
+    return last_ - first_;
+  }
+
+  bool ConcurrentPackage::Snapshot::Empty() const noexcept {
+    return first_ == last_;
+  }
+
+  ShippingUpdate ConcurrentPackage::Snapshot::At(std::size_t index) const {
+    if (index >= Size()) {
+      throw std::out_of_range("Snapshot index is out of range.");
+    }
+    return package_->UpdateAt(first_ + index);
+  }
+
+  ShippingUpdate ConcurrentPackage::Snapshot::Last() const {
+    if (Empty()) {
+      throw std::logic_error("Snapshot is empty.");
+    }
+    return package_->UpdateAt(last_ - 1);
+  }
+
+  ConcurrentPackage::Snapshot
+  ConcurrentPackage::Snapshot::Slice(std::size_t first, std::size_t count) const noexcept {
+    std::size_t begin = first_ + std::min(first, Size());
+    return Snapshot(package_, begin, begin + std::min(count, last_ - begin));
+  }
+
+  std::string ConcurrentPackage::Snapshot::Describe() const {
+    std::string buffer;
+    DescribeTo(buffer);
+    return buffer;
+  }
+
+  void ConcurrentPackage::Snapshot::DescribeTo(std::string& buffer) const {
+    DescribeRange(buffer);
+  }
+
+  void ConcurrentPackage::Snapshot::DescribeTo(std::ostream& out) const {
+    DescribeRange(out);
+  }
+
+  void ConcurrentPackage::Snapshot::DescribeTo(const DescribeSink& sink) const {
+    DescribeRange(sink);
+  }
+
+  template <typename Destination>
+  void ConcurrentPackage::Snapshot::DescribeRange(Destination& out) const {
+    const StringPool& pool = *package_->pool_;
+    for (std::size_t i = first_; i < last_; i++) {
+      const Entry& entry = package_->entries_[i];
+      WriteDescription(entry.timestamp, pool.Get(entry.description),
+		       pool.Get(entry.location), out);
+    }
+  }
+
+}
@@ -0,0 +1,135 @@
+////////////////////////////////////////////////////////////////////////////////
+// ConcurrentPackage.h
+//
+// class ConcurrentPackage
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef CONCURRENT_PACKAGE_H
+#define CONCURRENT_PACKAGE_H
+
+#include <cstddef> // std::size_t
+#include <ctime> // std::time_t
+#include <memory> // std::shared_ptr
+#include <ostream> // std::ostream
+#include <stdexcept> // std::invalid_argument, std::logic_error
+#include <string> // std::string
+#include <string_view> // std::string_view
+
+#include "AppendOnlyVector.h"
+#include "StringPool.h"
+#include "ShippingUpdate.h"
+#include "PackageStatus.h"
+
+namespace PackageTracking {
+
+  // A ConcurrentPackage is an append-only package that one writer
+  // thread adds updates to while any number of reader threads look
+  // at it, with no locks on either side.
+  //
+  // Each update is written in full before the update count is
+  // published, and updates are never changed or moved afterwards, so
+  // a reader that takes a Snapshot sees a consistent prefix of the
+  // updates for as long as it keeps the snapshot, however many
+  // updates the writer adds in the meantime. Unlike PackageStatus,
+  // there is no shared cursor; each reader keeps its own positions.
+  //
+  // Calls to AddUpdate must not overlap each other. Everything else
+  // may be called from any thread at any time.
+  class ConcurrentPackage {
+  public:
+
+    // An immutable view of the updates that were published when it
+    // was taken. It refers to the package it came from, which must
+    // outlive it.
+    class Snapshot {
+    public:
+
+      // Number of updates in the snapshot.
+      std::size_t Size() const noexcept;
+
+      bool Empty() const noexcept;
+
+      // Return the update at index, counting from the first update in
+      // the snapshot.
+      //
+      // Throws std::out_of_range if index is not below Size().
+      ShippingUpdate At(std::size_t index) const;
+
+      // Return the newest update in the snapshot.
+      //
+      // Throws std::logic_error if the snapshot is empty.
+      ShippingUpdate Last() const;
+
+      // Return the snapshot of up to count updates starting at first,
+      // clamped to the updates in this snapshot.
+      Snapshot Slice(std::size_t first, std::size_t count) const noexcept;
+
+      // Return, or write, the descriptions of every update in the
+      // snapshot, in the format of ShippingUpdate::Describe.
+      std::string Describe() const;
+      void DescribeTo(std::string& buffer) const;
+      void DescribeTo(std::ostream& out) const;
+      void DescribeTo(const DescribeSink& sink) const;
+
+    private:
+      friend class ConcurrentPackage;
+
+      Snapshot(const ConcurrentPackage* package, std::size_t first, std::size_t last) noexcept;
+
+      template <typename Destination>
+      void DescribeRange(Destination& out) const;
+
+      const ConcurrentPackage* package_;
+      std::size_t first_, last_;
+    };
+
+    // Initialize an empty package with the given tracking number, whose
+    // strings are interned into pool.
+    ConcurrentPackage(const std::string& tracking_number,
+		      std::shared_ptr<StringPool> pool = StringPool::Default());
+
+    ConcurrentPackage(const ConcurrentPackage&) = delete;
+    ConcurrentPackage& operator=(const ConcurrentPackage&) = delete;
+
+    const std::string& TrackingNumber() const noexcept;
+
+    const StringPool& Pool() const noexcept;
+
+    // Number of published updates.
+    std::size_t Size() const noexcept;
+
+    // Add and publish an update, following the rules of
+    // PackageStatus::AddUpdate. Writer only.
+    //
+    // Throws std::invalid_argument if the given timestamp is invalid.
+    void AddUpdate(std::string_view description,
+		   std::string_view location,
+		   std::time_t timestamp);
+
+    // Return a snapshot of the updates published so far.
+    Snapshot Read() const noexcept;
+
+    // Return a PackageStatus holding a copy of the updates published
+    // so far, sharing this package's pool.
+    PackageStatus ToPackageStatus() const;
+
+  private:
+    // One update, as written by AddUpdate.
+    struct Entry {
+      std::time_t timestamp;
+      StringId description, location;
+    };
+
+    ShippingUpdate UpdateAt(std::size_t index) const noexcept;
+
+    std::string tracking_number_;
+    std::shared_ptr<StringPool> pool_;
+    AppendOnlyVector<Entry> entries_;
+
+    // Timestamp of the newest update; only the writer uses it.
+    std::time_t last_timestamp_;
+  };
+
+}
+
+#endif
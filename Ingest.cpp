@@ -0,0 +1,349 @@
+////////////////////////////////////////////////////////////////////////////////
+// Ingest.cpp
+//
+// Loading many PackageStatus objects at once.
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Ingest.h"
+
+#include <algorithm> // std::count, std::min
+#include <optional> // std::optional
+#include <string_view> // std::string_view
+#include <thread> // std::thread
+
+#include <fcntl.h> // open
+#include <glob.h> // glob
+#include <sys/stat.h> // stat, fstat
+#include <unistd.h> // read, close
+
+#include "MappedFile.h"
+#include "PackageScanner.h"
+#include "Stats.h"
+#include "ThreadPool.h"
+#include "TrackingKey.h"
+
+namespace PackageTracking {
+
+  namespace {
+
+    // Chunks smaller than this are not worth a thread of their own.
+    constexpr std::size_t kMinChunkSize = 1 << 16;
+
+    // Parsed packages are held back in batches of this many, so that
+    // their tracking numbers can be validated together.
+    constexpr std::size_t kValidateBatch = 1024;
+
+    // Reported for a package whose tracking number fails
+    // ValidTrackingNumber.
+    constexpr const char* kMalformedTrackingNumber = "malformed tracking number";
+
+    // Builds a PackageStatus as a document is scanned.
+    class StatusBuilder : public PackageScanner::Visitor {
+    public:
+      StatusBuilder(std::shared_ptr<StringPool> pool)
+      : status_(std::string(), std::move(pool)) { }
+
+      void OnTrackingNumber(std::string_view tracking_number) override {
+	status_.SetTrackingNumber(std::string(tracking_number));
+      }
+
+      void OnUpdate(std::string_view description,
+		    std::string_view location,
+		    std::time_t timestamp) override {
+	status_.AddUpdate(description, location, timestamp);
+      }
+
+      PackageStatus& Status() noexcept {
+	return status_;
+      }
+
+    private:
+      PackageStatus status_;
+    };
+
+    // Parse the package on one line of a corpus, which must not be
+    // blank. Throws std::invalid_argument if it is malformed.
+    PackageStatus ParseLine(std::string_view line, const std::shared_ptr<StringPool>& pool) {
+      PackageScanner scanner(line);
+      StatusBuilder builder(pool);
+      scanner.ScanPackage(builder);
+      if (line.find_first_not_of(" \t\r", scanner.Position()) != std::string_view::npos) {
+	TRACK_COUNT(ExceptionsThrown, 1);
+	throw std::invalid_argument("JSON parse error");
+      }
+      return std::move(builder.Status());
+    }
+
+    // Split text into at most count chunks that each end just past a
+    // newline, or at the end of the text.
+    std::vector<std::string_view> SplitLines(std::string_view text, unsigned count) {
+      std::vector<std::string_view> chunks;
+      std::size_t target = std::max(kMinChunkSize, text.size() / count + 1);
+      std::size_t start = 0;
+      while (start < text.size()) {
+	std::size_t end = std::min(start + target, text.size());
+	if (end < text.size()) {
+	  end = text.find('\n', end);
+	  end = (end == std::string_view::npos) ? text.size() : end + 1;
+	}
+	chunks.push_back(text.substr(start, end - start));
+	start = end;
+      }
+      return chunks;
+    }
+
+    // Return the number of threads to use when threads were requested.
+    unsigned ThreadCount(unsigned threads) noexcept {
+      return (threads > 0) ? threads : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Replace the contents of buffer with the contents of the file at
+    // path. Throws std::invalid_argument if it cannot be read.
+    void ReadFile(const std::string& path, std::string& buffer) {
+      TRACK_SPAN("ReadFile");
+      int fd = open(path.c_str(), O_RDONLY);
+      struct stat info;
+      if ((fd < 0) || (fstat(fd, &info) != 0)) {
+	if (fd >= 0) {
+	  close(fd);
+	}
+	TRACK_COUNT(ExceptionsThrown, 1);
+	throw std::invalid_argument("could not open \"" + path + "\"");
+      }
+      buffer.resize(info.st_size);
+      std::size_t done = 0;
+      while (done < buffer.size()) {
+	ssize_t count = read(fd, &buffer[done], buffer.size() - done);
+	if (count < 0) {
+	  close(fd);
+	  TRACK_COUNT(ExceptionsThrown, 1);
+	  throw std::invalid_argument("could not open \"" + path + "\"");
+	}
+	if (count == 0) {
+	  // the file shrank while we were reading it
+	  break;
+	}
+	done += count;
+      }
+      buffer.resize(done);
+      close(fd);
+      TRACK_COUNT(BytesRead, done);
+    }
+
+    // Parse every line of the corpus at path on up to threads threads,
+    // calling on_package for each package and on_error for each failed
+    // line from the thread that parsed it, along with the index of its
+    // chunk. Sets chunk_count to the number of chunks, which is at most
+    // threads.
+    template <typename OnPackage, typename OnError>
+    void ParseCorpus(const std::string& path,
+		     const std::shared_ptr<StringPool>& pool,
+		     unsigned threads,
+		     std::size_t& chunk_count,
+		     OnPackage on_package,
+		     OnError on_error) {
+      MappedFile file(path);
+      std::vector<std::string_view> chunks = SplitLines(file.Text(), threads);
+      chunk_count = chunks.size();
+
+      // number the lines, so that each chunk knows where it starts
+      std::vector<std::size_t> first_line(chunks.size(), 1);
+      for (std::size_t i = 1; i < chunks.size(); i++) {
+	first_line[i] = first_line[i - 1]
+	  + std::count(chunks[i - 1].begin(), chunks[i - 1].end(), '\n');
+      }
+
+      auto parse_chunk = [&](std::size_t chunk) {
+	TRACK_SPAN("ParseCorpusChunk");
+	// packages parsed but not yet validated, with their line numbers
+	std::vector<std::size_t> lines;
+	std::vector<PackageStatus> packages;
+	auto flush = [&]() {
+	  std::vector<std::string_view> numbers;
+	  numbers.reserve(packages.size());
+	  for (const PackageStatus& package : packages) {
+	    numbers.push_back(package.TrackingNumber());
+	  }
+	  std::unique_ptr<bool[]> valid(new bool[packages.size()]);
+	  ValidateTrackingNumbers(numbers.data(), numbers.size(), valid.get());
+	  for (std::size_t i = 0; i < packages.size(); i++) {
+	    if (valid[i]) {
+	      on_package(chunk, lines[i], std::move(packages[i]));
+	    } else {
+	      on_error(chunk, LoadError{lines[i], kMalformedTrackingNumber});
+	    }
+	  }
+	  lines.clear();
+	  packages.clear();
+	};
+
+	std::string_view text = chunks[chunk];
+	std::size_t line_number = first_line[chunk];
+	while (!text.empty()) {
+	  std::size_t end = text.find('\n');
+	  std::string_view line = text.substr(0, end);
+	  text.remove_prefix((end == std::string_view::npos) ? text.size() : end + 1);
+	  if (line.find_first_not_of(" \t\r") != std::string_view::npos) {
+	    try {
+	      packages.push_back(ParseLine(line, pool));
+	      lines.push_back(line_number);
+	    } catch (std::invalid_argument& e) {
+	      // keep errors in line order
+	      flush();
+	      on_error(chunk, LoadError{line_number, e.what()});
+	    }
+	    if (packages.size() == kValidateBatch) {
+	      flush();
+	    }
+	  }
+	  line_number++;
+	}
+	flush();
+      };
+
+      ThreadPool(std::max<std::size_t>(1, chunks.size())).ParallelFor(chunks.size(), parse_chunk);
+    }
+
+    // Return text with a backslash before each character glob(3) would
+    // otherwise treat as a wildcard, so that it matches only itself.
+    std::string EscapeGlob(const std::string& text) {
+      std::string escaped;
+      escaped.reserve(text.size());
+      for (char c : text) {
+	if ((c == '*') || (c == '?') || (c == '[') || (c == ']') || (c == '\\')) {
+	  escaped += '\\';
+	}
+	escaped += c;
+      }
+      return escaped;
+    }
+
+  }
+
+  CorpusResult PackagesFromNDJSON(const std::string& path,
+				  std::shared_ptr<StringPool> pool,
+				  unsigned threads) {
+    // one result per chunk, so that threads never share one
+    threads = ThreadCount(threads);
+    std::vector<CorpusResult> partial(threads);
+    std::size_t chunk_count = 0;
+    ParseCorpus(path, pool, threads, chunk_count,
+		[&](std::size_t chunk, std::size_t, PackageStatus&& package) {
+		  partial[chunk].packages.push_back(std::move(package));
+		},
+		[&](std::size_t chunk, LoadError&& error) {
+		  partial[chunk].errors.push_back(std::move(error));
+		});
+
+    CorpusResult result;
+    for (std::size_t chunk = 0; chunk < chunk_count; chunk++) {
+      for (auto& package : partial[chunk].packages) {
+	result.packages.push_back(std::move(package));
+      }
+      for (auto& error : partial[chunk].errors) {
+	result.errors.push_back(std::move(error));
+      }
+    }
+    return result;
+  }
+
+  std::vector<LoadError> ForEachPackageInNDJSON(const std::string& path,
+						const PackageCallback& callback,
+						std::shared_ptr<StringPool> pool,
+						unsigned threads) {
+    threads = ThreadCount(threads);
+    std::vector<std::vector<LoadError>> partial(threads);
+    std::size_t chunk_count = 0;
+    ParseCorpus(path, pool, threads, chunk_count,
+		[&](std::size_t, std::size_t line, PackageStatus&& package) {
+		  callback(line, std::move(package));
+		},
+		[&](std::size_t chunk, LoadError&& error) {
+		  partial[chunk].push_back(std::move(error));
+		});
+
+    std::vector<LoadError> errors;
+    for (std::size_t chunk = 0; chunk < chunk_count; chunk++) {
+      for (auto& error : partial[chunk]) {
+	errors.push_back(std::move(error));
+      }
+    }
+    return errors;
+  }
+
+  FilesResult PackagesFromFiles(const std::vector<std::string>& paths,
+				std::shared_ptr<StringPool> pool,
+				unsigned threads) {
+    // one slot per file, so results come out in input order
+    std::vector<std::optional<PackageStatus>> packages(paths.size());
+    std::vector<std::string> errors(paths.size());
+
+    ThreadPool(ThreadCount(threads)).ParallelFor(paths.size(), [&](std::size_t i) {
+      // each worker reuses one read buffer for all of its files
+      thread_local std::string buffer;
+      try {
+	ReadFile(paths[i], buffer);
+	PackageScanner scanner(buffer);
+	StatusBuilder builder(pool);
+	scanner.ScanPackage(builder);
+	packages[i] = std::move(builder.Status());
+      } catch (std::invalid_argument& e) {
+	errors[i] = e.what();
+      }
+    });
+
+    // validate every loaded tracking number in one batch
+    std::vector<std::string_view> numbers(paths.size());
+    for (std::size_t i = 0; i < paths.size(); i++) {
+      if (packages[i]) {
+	numbers[i] = packages[i]->TrackingNumber();
+      }
+    }
+    std::unique_ptr<bool[]> valid(new bool[paths.size()]);
+    ValidateTrackingNumbers(numbers.data(), numbers.size(), valid.get());
+    for (std::size_t i = 0; i < paths.size(); i++) {
+      if (packages[i] && !valid[i]) {
+	packages[i].reset();
+	errors[i] = kMalformedTrackingNumber;
+      }
+    }
+
+    FilesResult result;
+    for (std::size_t i = 0; i < paths.size(); i++) {
+      if (packages[i]) {
+	result.paths.push_back(paths[i]);
+	result.packages.push_back(std::move(*packages[i]));
+      } else {
+	result.errors.push_back(FileError{paths[i], std::move(errors[i])});
+      }
+    }
+    return result;
+  }
+
+  FilesResult PackagesFromGlob(const std::string& pattern,
+			       std::shared_ptr<StringPool> pool,
+			       unsigned threads) {
+    glob_t matches;
+    int status = glob(pattern.c_str(), 0, nullptr, &matches);
+    if ((status != 0) && (status != GLOB_NOMATCH)) {
+      globfree(&matches);
+      throw std::invalid_argument("could not expand \"" + pattern + "\"");
+    }
+    // glob sorts its matches
+    std::vector<std::string> paths(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+    globfree(&matches);
+    return PackagesFromFiles(paths, std::move(pool), threads);
+  }
+
+  FilesResult PackagesFromDirectory(const std::string& directory,
+				    const std::string& pattern,
+				    std::shared_ptr<StringPool> pool,
+				    unsigned threads) {
+    struct stat info;
+    if ((stat(directory.c_str(), &info) != 0) || !S_ISDIR(info.st_mode)) {
+      throw std::invalid_argument("could not open directory \"" + directory + "\"");
+    }
+    return PackagesFromGlob(EscapeGlob(directory) + "/" + pattern, std::move(pool), threads);
+  }
+
+}
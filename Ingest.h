@@ -0,0 +1,125 @@
+////////////////////////////////////////////////////////////////////////////////
+// Ingest.h
+//
+// Loading many PackageStatus objects at once.
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <cstddef> // std::size_t
+#include <functional> // std::function
+#include <memory> // std::shared_ptr
+#include <stdexcept> // std::invalid_argument
+#include <string> // std::string
+#include <vector> // std::vector
+
+#include "PackageStatus.h"
+#include "StringPool.h"
+
+namespace PackageTracking {
+
+  // A package that could not be loaded, and why.
+  struct LoadError {
+    // 1-based line number in an NDJSON corpus
+    std::size_t line;
+    std::string message;
+  };
+
+  // The packages loaded from an NDJSON corpus, in line order, and the
+  // lines that failed, in line order.
+  struct CorpusResult {
+    std::vector<PackageStatus> packages;
+    std::vector<LoadError> errors;
+  };
+
+  // A file that could not be loaded, and why.
+  struct FileError {
+    std::string path;
+    std::string message;
+  };
+
+  // The packages loaded from a set of files, in the order the files
+  // were given, along with the path each one came from, and the files
+  // that failed, in the same order.
+  struct FilesResult {
+    std::vector<std::string> paths;
+    std::vector<PackageStatus> packages;
+    std::vector<FileError> errors;
+  };
+
+  // Called with each package loaded from a corpus and its 1-based line
+  // number.
+  using PackageCallback = std::function<void(std::size_t line, PackageStatus&& package)>;
+
+  // An NDJSON corpus holds one package per line, each a JSON object in
+  // the format read by PackageStatusFromJSON, for example
+  //
+  //   {"tracking_number" : "1Z...", "updates" : [["...", "...", 1515978000]]}
+  //
+  // Blank lines are skipped.
+  //
+  // The corpus is memory-mapped, split into line-aligned chunks, and
+  // the chunks are parsed in parallel on threads threads (0 means one
+  // per core). Strings are interned into pool. A line that cannot be
+  // parsed is reported as a LoadError with the message
+  // PackageStatusFromJSON would give, and one whose tracking number
+  // fails ValidTrackingNumber (see TrackingKey.h) with the message
+  // "malformed tracking number". Neither stops the rest of the corpus
+  // from loading.
+
+  // Load every package in the corpus at path.
+  //
+  // Throws std::invalid_argument if the file cannot be opened.
+  CorpusResult PackagesFromNDJSON(const std::string& path,
+				  std::shared_ptr<StringPool> pool = StringPool::Default(),
+				  unsigned threads = 0);
+
+  // Load every package in the corpus at path, and pass each one to
+  // callback as soon as it is parsed, without keeping it. callback is
+  // called from several threads at once, in no particular order, so
+  // it must be thread-safe, and it must not throw. Returns the lines
+  // that failed.
+  //
+  // Throws std::invalid_argument if the file cannot be opened.
+  std::vector<LoadError> ForEachPackageInNDJSON(const std::string& path,
+						const PackageCallback& callback,
+						std::shared_ptr<StringPool> pool = StringPool::Default(),
+						unsigned threads = 0);
+
+
+  // The following load many package files, each in the format read by
+  // PackageStatusFromJSON. Reading and parsing is spread over a
+  // work-stealing ThreadPool with threads workers (0 means one per
+  // core), and strings are interned into pool. A file that cannot be
+  // loaded is reported as a FileError with the message
+  // PackageStatusFromJSON would give, or "malformed tracking number"
+  // as for a corpus, and does not stop the others from loading.
+
+  // Load the files at paths.
+  FilesResult PackagesFromFiles(const std::vector<std::string>& paths,
+				std::shared_ptr<StringPool> pool = StringPool::Default(),
+				unsigned threads = 0);
+
+  // Load the files matching a shell wildcard pattern such as
+  // "archive/package_*.json", in sorted order. Like the shell,
+  // directories that cannot be read contribute no matches.
+  //
+  // Throws std::invalid_argument if the pattern cannot be expanded.
+  FilesResult PackagesFromGlob(const std::string& pattern,
+			       std::shared_ptr<StringPool> pool = StringPool::Default(),
+			       unsigned threads = 0);
+
+  // Load the files in directory whose names match a shell wildcard
+  // pattern, in sorted order. Only pattern is a wildcard; the name of
+  // directory is matched literally, even if it contains *, ? or [.
+  //
+  // Throws std::invalid_argument if directory cannot be read.
+  FilesResult PackagesFromDirectory(const std::string& directory,
+				    const std::string& pattern = "package_*.json",
+				    std::shared_ptr<StringPool> pool = StringPool::Default(),
+				    unsigned threads = 0);
+
+}
+
+#endif
@@ -0,0 +1,206 @@
+////////////////////////////////////////////////////////////////////////////////
+// LatestStatusTable.cpp
+//
+// class LatestStatusTable
+////////////////////////////////////////////////////////////////////////////////
+
+#include "LatestStatusTable.h"
+
+#include <cstdint> // std::uint32_t
+#include <mutex> // std::unique_lock
+#include <shared_mutex> // std::shared_mutex, std::shared_lock
+
+namespace PackageTracking {
+
+  // One shard: the rows of the packages whose keys hash to it. Row i
+  // of each column belongs to packages[i]. Aligned to a cache line so
+  // that neighbouring shards' locks do not share one.
+  struct alignas(64) LatestStatusTable::Shard {
+
+    // Whether row matches compiled. The caller must hold mutex.
+    bool Matches(const Compiled& compiled, std::size_t row) const noexcept {
+      // no short-circuiting, so that the scan loops stay branch-free
+      return (compiled.any_description | (descriptions[row] == compiled.description))
+	& (compiled.any_location | (locations[row] == compiled.location))
+	& (timestamps[row] >= compiled.since)
+	& (timestamps[row] <= compiled.until);
+    }
+
+    // Set the row of package, adding one if needed. The caller must
+    // hold mutex exclusively.
+    void Set(const TrackingKey& package, StringId description, StringId location,
+	     std::time_t timestamp) {
+      auto inserted = rows.emplace(package, packages.size());
+      std::uint32_t row = inserted.first->second;
+      if (inserted.second) {
+	packages.push_back(package);
+	descriptions.push_back(description);
+	locations.push_back(location);
+	timestamps.push_back(timestamp);
+      } else {
+	descriptions[row] = description;
+	locations[row] = location;
+	timestamps[row] = timestamp;
+      }
+    }
+
+    // Remove the row of package, if any, moving the last row into the
+    // hole. The caller must hold mutex exclusively.
+    void Erase(const TrackingKey& package) {
+      auto found = rows.find(package);
+      if (found == rows.end()) {
+	return;
+      }
+      std::uint32_t row = found->second, last = packages.size() - 1;
+      rows.erase(found);
+      if (row != last) {
+	packages[row] = packages[last];
+	descriptions[row] = descriptions[last];
+	locations[row] = locations[last];
+	timestamps[row] = timestamps[last];
+	rows[packages[row]] = row;
+      }
+      packages.pop_back();
+      descriptions.pop_back();
+      locations.pop_back();
+      timestamps.pop_back();
+    }
+
+    mutable std::shared_mutex mutex;
+    std::vector<TrackingKey> packages;
+    std::vector<StringId> descriptions, locations;
+    std::vector<std::time_t> timestamps;
+    std::unordered_map<TrackingKey, std::uint32_t, TrackingKeyHash> rows;
+  };
+
+  LatestStatusTable::LatestStatusTable(unsigned shard_count, std::shared_ptr<StringPool> pool)
+  : pool_(std::move(pool)), shard_count_(PackageStore::ShardCount(shard_count)) {
+    shards_.reset(new Shard[shard_count_]);
+  }
+
+  LatestStatusTable::~LatestStatusTable() { }
+
+  const StringPool& LatestStatusTable::Pool() const noexcept {
+    return *pool_;
+  }
+
+  std::size_t LatestStatusTable::Size() const {
+    std::size_t size = 0;
+    for (unsigned i = 0; i < shard_count_; i++) {
+      std::shared_lock<std::shared_mutex> lock(shards_[i].mutex);
+      size += shards_[i].packages.size();
+    }
+    return size;
+  }
+
+  void LatestStatusTable::PackageAdded(const PackageStatus& package) {
+    if (!package.Empty()) {
+      SetLatest(package, package.Size() - 1);
+    }
+  }
+
+  void LatestStatusTable::PackageRemoved(const PackageStatus& package) {
+    TrackingKey key;
+    if (!TrackingKey::TryFind(package.TrackingNumber(), key)) {
+      return;
+    }
+    Shard& shard = ShardFor(key);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    shard.Erase(key);
+  }
+
+  void LatestStatusTable::UpdateAdded(const PackageStatus& package, int position) {
+    // a late update does not change the newest one
+    if (position == package.Size() - 1) {
+      SetLatest(package, position);
+    }
+  }
+
+  std::size_t LatestStatusTable::Count(const Filter& filter) const {
+    Compiled compiled = Compile(filter);
+    std::size_t count = 0;
+    if (!compiled.possible) {
+      return count;
+    }
+    for (unsigned s = 0; s < shard_count_; s++) {
+      const Shard& shard = shards_[s];
+      std::shared_lock<std::shared_mutex> lock(shard.mutex);
+      for (std::size_t i = 0, size = shard.packages.size(); i < size; i++) {
+	count += shard.Matches(compiled, i);
+      }
+    }
+    return count;
+  }
+
+  std::vector<LatestStatusTable::Row> LatestStatusTable::Select(const Filter& filter) const {
+    Compiled compiled = Compile(filter);
+    std::vector<Row> rows;
+    if (!compiled.possible) {
+      return rows;
+    }
+    for (unsigned s = 0; s < shard_count_; s++) {
+      const Shard& shard = shards_[s];
+      std::shared_lock<std::shared_mutex> lock(shard.mutex);
+      for (std::size_t i = 0, size = shard.packages.size(); i < size; i++) {
+	if (shard.Matches(compiled, i)) {
+	  rows.push_back(Row{shard.packages[i], shard.descriptions[i], shard.locations[i],
+			     shard.timestamps[i]});
+	}
+      }
+    }
+    return rows;
+  }
+
+  std::unordered_map<StringId, std::size_t>
+  LatestStatusTable::CountBy(Column column, const Filter& filter) const {
+    Compiled compiled = Compile(filter);
+    std::unordered_map<StringId, std::size_t> counts;
+    if (!compiled.possible) {
+      return counts;
+    }
+    for (unsigned s = 0; s < shard_count_; s++) {
+      const Shard& shard = shards_[s];
+      std::shared_lock<std::shared_mutex> lock(shard.mutex);
+      const std::vector<StringId>& keys =
+	(column == Column::Description) ? shard.descriptions : shard.locations;
+      for (std::size_t i = 0, size = shard.packages.size(); i < size; i++) {
+	if (shard.Matches(compiled, i)) {
+	  counts[keys[i]]++;
+	}
+      }
+    }
+    return counts;
+  }
+
+  LatestStatusTable::Compiled LatestStatusTable::Compile(const Filter& filter) const {
+    Compiled compiled{filter.since <= filter.until, !filter.description, !filter.location,
+		      0, 0, filter.since, filter.until};
+    if (filter.description && !pool_->Find(*filter.description, compiled.description)) {
+      compiled.possible = false;
+    }
+    if (filter.location && !pool_->Find(*filter.location, compiled.location)) {
+      compiled.possible = false;
+    }
+    return compiled;
+  }
+
+  void LatestStatusTable::SetLatest(const PackageStatus& package, int position) {
+    TrackingKey key(package.TrackingNumber());
+    ShippingUpdate latest = *package.Updates(position, 1).begin();
+    // intern before locking, since interning takes the pool's lock
+    StringId description = Id(latest.Pool(), latest.DescriptionId()),
+      location = Id(latest.Pool(), latest.LocationId());
+    Shard& shard = ShardFor(key);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    shard.Set(key, description, location, latest.Timestamp());
+  }
+
+  StringId LatestStatusTable::Id(const StringPool& pool, StringId id) const {
+    return (&pool == pool_.get()) ? id : pool_->Intern(pool.Get(id));
+  }
+
+  LatestStatusTable::Shard& LatestStatusTable::ShardFor(const TrackingKey& package) const noexcept {
+    return shards_[PackageStore::ShardIndex(package.Hash(), shard_count_)];
+  }
+
+}
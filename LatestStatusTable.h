@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////////////
+// LatestStatusTable.h
+//
+// class LatestStatusTable
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LATEST_STATUS_TABLE_H
+#define LATEST_STATUS_TABLE_H
+
+#include <cstddef> // std::size_t
+#include <ctime> // std::time_t
+#include <limits> // std::numeric_limits
+#include <memory> // std::shared_ptr, std::unique_ptr
+#include <optional> // std::optional
+#include <string_view> // std::string_view
+#include <unordered_map> // std::unordered_map
+#include <vector> // std::vector
+
+#include "StringPool.h"
+#include "ShippingUpdate.h"
+#include "PackageStatus.h"
+#include "PackageStore.h"
+#include "TrackingKey.h"
+
+namespace PackageTracking {
+
+  // A LatestStatusTable holds the newest update of every package: its
+  // tracking number, description, location and timestamp. Dashboards
+  // can count or list packages by their current state without reading
+  // any histories.
+  //
+  // Each field is a column of keys, ids or timestamps, one row per
+  // package, so a scan streams through a few dense arrays, comparing
+  // ids rather than strings. Tracking numbers are kept as TrackingKeys
+  // and dropped with their rows; descriptions and locations, which
+  // repeat across packages, are ids into Pool().
+  //
+  // Register the table with PackageStore::AddListener and it is kept
+  // up to date in constant time per update. It is safe to use from
+  // several threads at once. Like PackageStore, the rows are split
+  // into shards by the hash of the tracking number, each with its own
+  // lock, so given the store's shard count, threads changing packages
+  // in different shards of the store never wait for each other here.
+  class LatestStatusTable : public PackageStore::Listener {
+  public:
+
+    // The newest update of one package. Ids are into Pool().
+    struct Row {
+      TrackingKey package;
+      StringId description, location;
+      std::time_t timestamp;
+    };
+
+    // Which rows a query looks at. A row matches when each field that
+    // is set matches, and its timestamp is between since and until,
+    // inclusive.
+    struct Filter {
+      std::optional<std::string_view> description, location;
+      std::time_t since = std::numeric_limits<std::time_t>::min(),
+	until = std::numeric_limits<std::time_t>::max();
+    };
+
+    // Columns that CountBy can group on.
+    enum class Column { Description, Location };
+
+    // Initialize an empty table with at least the given number of
+    // shards (see PackageStore::ShardCount), which interns
+    // descriptions and locations into pool.
+    LatestStatusTable(unsigned shard_count = 64,
+		      std::shared_ptr<StringPool> pool = StringPool::Default());
+
+    ~LatestStatusTable();
+
+    LatestStatusTable(const LatestStatusTable&) = delete;
+    LatestStatusTable& operator=(const LatestStatusTable&) = delete;
+
+    const StringPool& Pool() const noexcept;
+
+    // Number of packages with at least one update.
+    std::size_t Size() const;
+
+    // Keep the table up to date; see PackageStore::Listener.
+    //
+    // PackageAdded and UpdateAdded throw std::invalid_argument if the
+    // tracking number cannot be packed into a TrackingKey.
+    void PackageAdded(const PackageStatus& package) override;
+    void PackageRemoved(const PackageStatus& package) override;
+    void UpdateAdded(const PackageStatus& package, int position) override;
+
+    // Return the number of rows matching filter.
+    std::size_t Count(const Filter& filter) const;
+
+    // Return the rows matching filter, in no particular order.
+    std::vector<Row> Select(const Filter& filter) const;
+
+    // Return the number of rows matching filter for each distinct
+    // value of column, keyed by its id.
+    std::unordered_map<StringId, std::size_t> CountBy(Column column, const Filter& filter) const;
+
+  private:
+    struct Shard;
+
+    // A Filter with its strings resolved to ids. A string that is not
+    // in the pool matches nothing.
+    struct Compiled {
+      bool possible, any_description, any_location;
+      StringId description, location;
+      std::time_t since, until;
+    };
+
+    Compiled Compile(const Filter& filter) const;
+
+    // Set the row of package to the update at position, which is its
+    // newest.
+    void SetLatest(const PackageStatus& package, int position);
+
+    // Return the id in pool_ of the string with the given id in pool.
+    StringId Id(const StringPool& pool, StringId id) const;
+
+    // Return the shard of package.
+    Shard& ShardFor(const TrackingKey& package) const noexcept;
+
+    std::shared_ptr<StringPool> pool_;
+    std::unique_ptr<Shard[]> shards_;
+    unsigned shard_count_;
+  };
+
+}
+
+#endif
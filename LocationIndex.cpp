@@ -0,0 +1,252 @@
+////////////////////////////////////////////////////////////////////////////////
+// LocationIndex.cpp
+//
+// class LocationIndex
+////////////////////////////////////////////////////////////////////////////////
+
+#include "LocationIndex.h"
+
+#include <algorithm> // std::sort, std::lower_bound, std::upper_bound, std::swap
+#include <mutex> // std::unique_lock
+#include <shared_mutex> // std::shared_mutex, std::shared_lock
+#include <string> // std::string
+#include <unordered_map> // std::unordered_map
+
+namespace PackageTracking {
+
+  namespace {
+
+    // Order postings by timestamp, breaking ties by package and
+    // position so that each posting is distinct, and find them by
+    // timestamp.
+    struct PostingOrder {
+      using is_transparent = void;
+
+      bool operator()(const LocationIndex::Posting& a,
+		      const LocationIndex::Posting& b) const noexcept {
+	if (a.timestamp != b.timestamp) {
+	  return a.timestamp < b.timestamp;
+	}
+	if (a.package != b.package) {
+	  return a.package < b.package;
+	}
+	return a.position < b.position;
+      }
+
+      bool operator()(const LocationIndex::Posting& posting, std::time_t t) const noexcept {
+	return posting.timestamp < t;
+      }
+
+      bool operator()(std::time_t t, const LocationIndex::Posting& posting) const noexcept {
+	return t < posting.timestamp;
+      }
+    };
+
+  }
+
+  // One shard: the postings of the packages whose keys hash to it, by
+  // location. Aligned to a cache line so that neighbouring shards'
+  // locks do not share one.
+  struct alignas(64) LocationIndex::Shard {
+
+    // The postings at one location, sorted by PostingOrder, and the
+    // location's name, which the key in locations views.
+    struct Location {
+      std::string name;
+      std::vector<Posting> postings;
+    };
+
+    // Return the postings at location, or nullptr. The caller must
+    // hold mutex.
+    const std::vector<Posting>* Find(std::string_view location) const {
+      auto found = locations.find(location);
+      return (found == locations.end()) ? nullptr : &found->second->postings;
+    }
+
+    // Add posting to, or remove it from, the postings at location, or
+    // give the posting at location equal to posting a new position.
+    // The caller must hold mutex exclusively.
+    void Insert(std::string_view location, const Posting& posting) {
+      auto found = locations.find(location);
+      if (found == locations.end()) {
+	auto added = std::make_unique<Location>();
+	added->name = location;
+	std::string_view name = added->name;
+	found = locations.emplace(name, std::move(added)).first;
+      }
+      std::vector<Posting>& postings = found->second->postings;
+      // updates mostly arrive in order, and go on the end; a late one
+      // is inserted in its place
+      if (postings.empty() || !PostingOrder()(posting, postings.back())) {
+	postings.push_back(posting);
+      } else {
+	postings.insert(std::upper_bound(postings.begin(), postings.end(), posting,
+					 PostingOrder()),
+			posting);
+      }
+      size++;
+    }
+
+    void Erase(std::string_view location, const Posting& posting) {
+      auto found = locations.find(location);
+      if (found == locations.end()) {
+	return;
+      }
+      std::vector<Posting>& postings = found->second->postings;
+      auto at = FindPosting(postings, posting);
+      if (at == postings.end()) {
+	return;
+      }
+      postings.erase(at);
+      size--;
+      if (postings.empty()) {
+	locations.erase(found);
+      }
+    }
+
+    void Move(std::string_view location, const Posting& posting, int position) {
+      auto found = locations.find(location);
+      if (found == locations.end()) {
+	return;
+      }
+      std::vector<Posting>& postings = found->second->postings;
+      auto at = FindPosting(postings, posting);
+      if (at == postings.end()) {
+	return;
+      }
+      // only postings of the same package at the same time can now be
+      // out of order, and they are next to it
+      at->position = position;
+      PostingOrder less;
+      while ((at + 1 != postings.end()) && less(*(at + 1), *at)) {
+	std::swap(*at, *(at + 1));
+	++at;
+      }
+      while ((at != postings.begin()) && less(*at, *(at - 1))) {
+	std::swap(*at, *(at - 1));
+	--at;
+      }
+    }
+
+    // Return the posting in postings equal to posting, or the end.
+    static std::vector<Posting>::iterator FindPosting(std::vector<Posting>& postings,
+						      const Posting& posting) {
+      auto at = std::lower_bound(postings.begin(), postings.end(), posting, PostingOrder());
+      if ((at == postings.end()) || PostingOrder()(posting, *at)) {
+	return postings.end();
+      }
+      return at;
+    }
+
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::string_view, std::unique_ptr<Location>> locations;
+    std::size_t size = 0;
+  };
+
+  LocationIndex::LocationIndex(unsigned shard_count)
+  : shard_count_(PackageStore::ShardCount(shard_count)) {
+    shards_.reset(new Shard[shard_count_]);
+  }
+
+  LocationIndex::~LocationIndex() { }
+
+  std::size_t LocationIndex::Size() const {
+    std::size_t size = 0;
+    for (unsigned i = 0; i < shard_count_; i++) {
+      std::shared_lock<std::shared_mutex> lock(shards_[i].mutex);
+      size += shards_[i].size;
+    }
+    return size;
+  }
+
+  void LocationIndex::PackageAdded(const PackageStatus& package) {
+    TrackingKey key(package.TrackingNumber());
+    Shard& shard = ShardFor(key);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    int position = 0;
+    for (ShippingUpdate update : package.Updates()) {
+      shard.Insert(update.Location(), Posting{key, position, update.Timestamp()});
+      position++;
+    }
+  }
+
+  void LocationIndex::PackageRemoved(const PackageStatus& package) {
+    TrackingKey key;
+    if (!TrackingKey::TryFind(package.TrackingNumber(), key)) {
+      return;
+    }
+    Shard& shard = ShardFor(key);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    int position = 0;
+    for (ShippingUpdate update : package.Updates()) {
+      shard.Erase(update.Location(), Posting{key, position, update.Timestamp()});
+      position++;
+    }
+  }
+
+  void LocationIndex::UpdateAdded(const PackageStatus& package, int position) {
+    TrackingKey key(package.TrackingNumber());
+    if (position == package.Size() - 1) {
+      // appended, so nothing moved
+      ShippingUpdate update = *package.Updates(position, 1).begin();
+      Shard& shard = ShardFor(key);
+      std::unique_lock<std::shared_mutex> lock(shard.mutex);
+      shard.Insert(update.Location(), Posting{key, position, update.Timestamp()});
+      return;
+    }
+
+    // the added update, then every update it pushed forward
+    PackageStatus::UpdateRange range = package.Updates(position, package.Size() - position);
+    std::vector<ShippingUpdate> moved(range.begin(), range.end());
+
+    Shard& shard = ShardFor(key);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    // last first, so that no two postings of the package ever share a
+    // position
+    for (std::size_t i = moved.size() - 1; i > 0; i--) {
+      int old_position = position + i - 1;
+      shard.Move(moved[i].Location(), Posting{key, old_position, moved[i].Timestamp()},
+		 old_position + 1);
+    }
+    shard.Insert(moved[0].Location(), Posting{key, position, moved[0].Timestamp()});
+  }
+
+  std::vector<LocationIndex::Posting>
+  LocationIndex::Lookup(std::string_view location, std::time_t t0, std::time_t t1) const {
+    std::vector<Posting> found;
+    if (t1 < t0) {
+      return found;
+    }
+    for (unsigned i = 0; i < shard_count_; i++) {
+      std::shared_lock<std::shared_mutex> lock(shards_[i].mutex);
+      if (auto postings = shards_[i].Find(location)) {
+	found.insert(found.end(),
+		     std::lower_bound(postings->begin(), postings->end(), t0, PostingOrder()),
+		     std::upper_bound(postings->begin(), postings->end(), t1, PostingOrder()));
+      }
+    }
+    std::sort(found.begin(), found.end(), PostingOrder());
+    return found;
+  }
+
+  std::size_t LocationIndex::Count(std::string_view location,
+				   std::time_t t0, std::time_t t1) const {
+    if (t1 < t0) {
+      return 0;
+    }
+    std::size_t count = 0;
+    for (unsigned i = 0; i < shard_count_; i++) {
+      std::shared_lock<std::shared_mutex> lock(shards_[i].mutex);
+      if (auto postings = shards_[i].Find(location)) {
+	count += std::upper_bound(postings->begin(), postings->end(), t1, PostingOrder())
+	  - std::lower_bound(postings->begin(), postings->end(), t0, PostingOrder());
+      }
+    }
+    return count;
+  }
+
+  LocationIndex::Shard& LocationIndex::ShardFor(const TrackingKey& package) const noexcept {
+    return shards_[PackageStore::ShardIndex(package.Hash(), shard_count_)];
+  }
+
+}
@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////////
+// LocationIndex.h
+//
+// class LocationIndex
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef LOCATION_INDEX_H
+#define LOCATION_INDEX_H
+
+#include <cstddef> // std::size_t
+#include <ctime> // std::time_t
+#include <memory> // std::unique_ptr
+#include <string_view> // std::string_view
+#include <vector> // std::vector
+
+#include "StringPool.h"
+#include "ShippingUpdate.h"
+#include "PackageStatus.h"
+#include "PackageStore.h"
+#include "TrackingKey.h"
+
+namespace PackageTracking {
+
+  // A LocationIndex maps each location to the updates, across many
+  // packages, that happened there, sorted by time, so that questions
+  // like "which packages were scanned at this facility in the last six
+  // hours" cost time proportional to the number of answers rather than
+  // to the number of packages.
+  //
+  // Register it with PackageStore::AddListener to keep it up to date
+  // as the store changes, or call PackageAdded directly to index
+  // packages kept elsewhere. It is safe to use from several threads at
+  // once.
+  //
+  // The index keeps its own copies of tracking numbers, as the
+  // TrackingKeys in its postings, and of location names, and drops a
+  // name with the last posting at it, so it never grows a StringPool.
+  // Like PackageStore it is split into shards by the hash of the
+  // tracking number, each with its own lock; given the store's shard
+  // count, threads changing packages in different shards of the store
+  // never wait for each other here either. Within a shard, the
+  // postings at each location are kept in a sorted vector, 32 bytes a
+  // posting. Updates that arrive in order are appended in constant
+  // time; a late one, or a removal, shifts the later postings at its
+  // location. Lookup and Count visit every shard.
+  class LocationIndex : public PackageStore::Listener {
+  public:
+
+    // One update at a location. package is the package's tracking
+    // number, and position is the update's index within the package.
+    // Positions are kept current as late updates move later ones
+    // forward.
+    struct Posting {
+      TrackingKey package;
+      int position;
+      std::time_t timestamp;
+    };
+
+    // Initialize an empty index with at least the given number of
+    // shards; see PackageStore::ShardCount.
+    LocationIndex(unsigned shard_count = 64);
+
+    ~LocationIndex();
+
+    LocationIndex(const LocationIndex&) = delete;
+    LocationIndex& operator=(const LocationIndex&) = delete;
+
+    // Total number of postings.
+    std::size_t Size() const;
+
+    // Index every update of package, or remove them all again. The
+    // package must not already be indexed, or must be, respectively.
+    //
+    // PackageAdded throws std::invalid_argument if the tracking number
+    // cannot be packed into a TrackingKey.
+    void PackageAdded(const PackageStatus& package) override;
+    void PackageRemoved(const PackageStatus& package) override;
+
+    // Index the update at position in package, which is already
+    // indexed apart from that update.
+    //
+    // Throws std::invalid_argument if the tracking number cannot be
+    // packed into a TrackingKey.
+    void UpdateAdded(const PackageStatus& package, int position) override;
+
+    // Return the postings at location with timestamps between t0 and
+    // t1, inclusive, in chronological order.
+    std::vector<Posting> Lookup(std::string_view location,
+				std::time_t t0, std::time_t t1) const;
+
+    // Return the number of postings Lookup would return.
+    std::size_t Count(std::string_view location, std::time_t t0, std::time_t t1) const;
+
+  private:
+    struct Shard;
+
+    // Return the shard of package.
+    Shard& ShardFor(const TrackingKey& package) const noexcept;
+
+    std::unique_ptr<Shard[]> shards_;
+    unsigned shard_count_;
+  };
+
+}
+
+#endif
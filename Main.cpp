@@ -5,28 +5,226 @@
 // PackageStatus class.
 ////////////////////////////////////////////////////////////////////////////////
 
-#include <iostream> // cout, endl
-#include <string> // stoi
+#include <csignal> // signal, SIGINT, SIGTERM
+#include <ctime> // time_t
+#include <fstream> // ifstream, ofstream
+#include <iostream> // cin, cout, cerr, endl
+#include <string> // string
 
+#include "Batch.h"
+#include "Ingest.h"
+#include "MemoryReport.h"
+#include "PackageWatcher.h"
 #include "PackageStatus.h"
+#include "Query.h"
+#include "QueryServer.h"
 #include "Serialize.h"
+#include "Stats.h"
 
 using namespace std;
 using namespace PackageTracking;
 
-// Methods of selecting updates
-enum class How { Previous, Following, All };
+// Whether to print a memory report for loaded packages (--memory).
+static bool report_memory = false;
+
+// The server running in --serve mode, for the signal handler.
+static QueryServer* volatile serving = nullptr;
+
+// Stop serving on SIGINT or SIGTERM, so that the socket is removed.
+extern "C" void StopServing(int) {
+  if (serving != nullptr) {
+    serving->Stop();
+  }
+}
 
 // Print usage information on usage error.
 void PrintUsage() {
   cout << "Usage:" << endl << endl
-       << "    ./track <FILENAME> <HOW> <INDEX>" << endl << endl
+       << "    ./track <FILENAME> <HOW> <INDEX>" << endl
+       << "    ./track --dir <DIRECTORY> <HOW> <INDEX>" << endl
+       << "    ./track <FILENAME> between <T0> <T1>" << endl
+       << "    ./track --serve <SOCKET>" << endl
+       << "    ./track --batch [QUERIES]" << endl
+       << "    ./track --follow <FILENAME>" << endl
+       << "    ./track [--stats] [--trace <TRACE>] [--memory] <any of the above>" << endl << endl
        << "<FILENAME>: a .json file containing tracking info" << endl
+       << "<DIRECTORY>: a directory of package_*.json files, which are all printed" << endl
        << "<HOW>: one of the following: previous following all" << endl
-       << "<INDEX>: the index (starting from 0) to prent before/after (ignored when HOW=all)" << endl << endl;
+       << "<INDEX>: the index (starting from 0) to prent before/after (ignored when HOW=all)" << endl
+       << "<T0> <T1>: Unix timestamps; updates from T0 through T1 are printed" << endl
+       << "<SOCKET>: a Unix domain socket to answer queries on, one per line, in the" << endl
+       << "          forms above (without ./track); see QueryServer.h" << endl
+       << "[QUERIES]: a file of queries, one per line, in the same forms; standard" << endl
+       << "           input if omitted; see Batch.h" << endl
+       << "--follow: print every update, then each update appended later, until" << endl
+       << "          interrupted; see PackageWatcher.h" << endl
+       << "--stats: print timings and counters to standard error when done" << endl
+       << "<TRACE>: a file to write a Chrome trace-event JSON timeline to" << endl
+       << "(--stats and --trace need a build with STATS=1; see Stats.h)" << endl
+       << "--memory: print the memory held by the loaded packages to standard error" << endl
+       << "          (file, between and --dir modes); see MemoryReport.h" << endl << endl;
 }
 
-int main(int argc, char* argv[]) {
+// Print a memory report for count packages to standard error, if
+// --memory was given.
+void ReportMemoryIfAsked(const PackageStatus* packages, size_t count) {
+  if (report_memory) {
+    WriteMemoryReport(ReportMemory(packages, count), cerr);
+  }
+}
+
+// Print the updates of status selected by how and index. Returns false
+// after printing an error if index is out of range.
+bool PrintUpdates(PackageStatus& status, How how, int index) {
+  if (!DescribeSelection(status, how, index, cout)) {
+    cout << "error: index out of range" << endl;
+    return false;
+  }
+  return true;
+}
+
+// Answer queries on the Unix domain socket at path until interrupted.
+int Serve(const string& path) {
+  try {
+    QueryServer server(path);
+    serving = &server;
+    signal(SIGINT, StopServing);
+    signal(SIGTERM, StopServing);
+    cerr << "serving on " << path << endl;
+    server.Run();
+    serving = nullptr;
+  } catch (std::invalid_argument& e) {
+    cout << "error: " << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
+
+// Answer the queries in the file at path, or on standard input if
+// path is empty. Returns nonzero if any query failed.
+int Batch(const string& path) {
+  if (path.empty()) {
+    return (AnswerQueries(cin, cout) == 0) ? 0 : 1;
+  }
+  ifstream input(path);
+  if (!input) {
+    cout << "error: could not open \"" << path << "\"" << endl;
+    return 1;
+  }
+  return (AnswerQueries(input, cout) == 0) ? 0 : 1;
+}
+
+// Print every update of the package file at path, then follow it,
+// printing updates as they are appended, until killed. When the file
+// is rewritten in some other way, it is printed again in full.
+int Follow(const string& path) {
+  try {
+    PackageWatcher watcher(path);
+    watcher.Status().DescribeAllUpdates(cout);
+    cout.flush();
+    while (true) {
+      int size = watcher.Status().Size();
+      PackageWatcher::Change change;
+      try {
+	change = watcher.Wait();
+      } catch (std::invalid_argument& e) {
+	// perhaps half written; the next change is tried again
+	cout << "error: " << e.what() << endl;
+	continue;
+      }
+      PackageStatus& status = watcher.Status();
+      if (change == PackageWatcher::Change::Appended) {
+	status.Updates(size, status.Size() - size).DescribeTo(cout);
+      } else if (change == PackageWatcher::Change::Reloaded) {
+	cout << "==> " << path << " reloaded <==" << endl;
+	status.DescribeAllUpdates(cout);
+      }
+      cout.flush();
+    }
+  } catch (std::invalid_argument& e) {
+    cout << "error: " << e.what() << endl;
+    return 1;
+  }
+}
+
+// Load every package file in directory in parallel, and print each
+// one's updates in turn, under a header naming its file. Files that
+// could not be loaded are listed at the end.
+int TrackDirectory(const string& directory, How how, int index) {
+
+  FilesResult result;
+  try {
+    result = PackagesFromDirectory(directory);
+  } catch (std::invalid_argument& e) {
+    cout << "error: " << e.what() << endl;
+    return 1;
+  }
+
+  ReportMemoryIfAsked(result.packages.data(), result.packages.size());
+
+  bool success = result.errors.empty();
+  for (size_t i = 0; i < result.packages.size(); i++) {
+    cout << "==> " << result.paths[i] << " <==" << endl;
+    success &= PrintUpdates(result.packages[i], how, index);
+  }
+  for (auto& error : result.errors) {
+    cout << "error: " << error.path << ": " << error.message << endl;
+  }
+  return success ? 0 : 1;
+}
+
+// Run the command in argv, which has had any instrumentation options
+// removed.
+int Track(int argc, char* argv[]) {
+
+  // daemon mode
+  if ((argc == 3) && (string(argv[1]) == "--serve")) {
+    return Serve(argv[2]);
+  }
+
+  // batch mode
+  if (((argc == 2) || (argc == 3)) && (string(argv[1]) == "--batch")) {
+    return Batch((argc == 3) ? argv[2] : "");
+  }
+
+  // follow mode
+  if ((argc == 3) && (string(argv[1]) == "--follow")) {
+    return Follow(argv[2]);
+  }
+
+  // directory mode
+  if ((argc == 5) && (string(argv[1]) == "--dir")) {
+    How how;
+    if (!ParseHow(argv[3], how)) {
+      PrintUsage();
+      return 1;
+    }
+    int index;
+    if (!ParseIndex(argv[4], index)) {
+      cout << "error: invalid index" << endl;
+      return 1;
+    }
+    return TrackDirectory(argv[2], how, index);
+  }
+
+  // time range mode
+  if ((argc == 5) && (string(argv[2]) == "between")) {
+    time_t t0, t1;
+    if (!ParseTime(argv[3], t0) || !ParseTime(argv[4], t1)) {
+      cout << "error: invalid timestamp" << endl;
+      return 1;
+    }
+    PackageStatus status;
+    try {
+      status = PackageStatusFromJSON(argv[1]);
+    } catch (std::invalid_argument& e) {
+      cout << "error: " << e.what() << endl;
+      return 1;
+    }
+    status.DescribeUpdatesBetween(t0, t1, cout);
+    ReportMemoryIfAsked(&status, 1);
+    return 0;
+  }
 
   // check number of commandline arguments
   if (argc != 4) {
@@ -43,7 +241,7 @@ int main(int argc, char* argv[]) {
   PackageStatus status;
   try {
     status = PackageStatusFromJSON(filename);
-  } catch (std::invalid_argument e) {
+  } catch (std::invalid_argument& e) {
     // read failure
     cout << "error: " << e.what() << endl;
     return 1;
@@ -51,13 +249,7 @@ int main(int argc, char* argv[]) {
 
   // decode the how argument
   How how;
-  if (how_string == "previous") {
-    how = How::Previous;
-  } else if (how_string == "following") {
-    how = How::Following;
-  } else if (how_string == "all") {
-    how = How::All;
-  } else {
+  if (!ParseHow(how_string, how)) {
     // invalid how
     PrintUsage();
     return 1;
@@ -65,41 +257,60 @@ int main(int argc, char* argv[]) {
 
   // decode the index argument
   int index;
-  try {
-    index = stoi(index_string);
-  } catch (exception e) {
+  if (!ParseIndex(index_string, index)) {
     cout << "error: invalid index" << endl;
     return 1;
   }
 
-  // check index range
-  if ((index < 0) || (index >= status.Size())) {
-    cout << "error: index out of range" << endl;
+  // print the chosen updates
+  bool printed = PrintUpdates(status, how, index);
+  ReportMemoryIfAsked(&status, 1);
+  if (!printed) {
     return 1;
   }
 
-  // move cursor to chosen index
-  for (int i = 0; i < index; i++) {
-    status.MoveCursorForward();
-  }
+  // done, success
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
 
-  // create output
-  string output;
-  switch (how) {
-  case How::Previous:
-    output = status.DescribePreviousUpdates();
-    break;
-  case How::Following:
-    output = status.DescribeFollowingUpdates();
-    break;
-  case How::All:
-    output = status.DescribeAllUpdates();
-    break;
+  // strip instrumentation options, which come first
+  bool stats = false;
+  string trace_path;
+  int first = 1;
+  while (first < argc) {
+    string option = argv[first];
+    if (option == "--stats") {
+      stats = true;
+      first++;
+    } else if (option == "--memory") {
+      report_memory = true;
+      first++;
+    } else if ((option == "--trace") && (first + 1 < argc)) {
+      trace_path = argv[first + 1];
+      first += 2;
+    } else {
+      break;
+    }
   }
+  argv[first - 1] = argv[0];
+  argc -= first - 1;
+  argv += first - 1;
 
-  // print output
-  cout << output;
+  Stats::SetTracing(!trace_path.empty());
+  int result = Track(argc, argv);
 
-  // done, success
-  return 0;
+  if (stats) {
+    Stats::WriteReport(cerr);
+  }
+  if (!trace_path.empty()) {
+    ofstream trace(trace_path);
+    Stats::WriteChromeTrace(trace);
+    if (!trace) {
+      cerr << "error: could not write \"" << trace_path << "\"" << endl;
+      return 1;
+    }
+  }
+  return result;
 }
@@ -0,0 +1,62 @@
+////////////////////////////////////////////////////////////////////////////////
+// MappedFile.cpp
+//
+// class MappedFile
+////////////////////////////////////////////////////////////////////////////////
+
+#include "MappedFile.h"
+
+#include <fcntl.h> // open
+#include <sys/mman.h> // mmap, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h> // close
+
+#include "Stats.h"
+
+namespace PackageTracking {
+
+  MappedFile::MappedFile(const std::string& path)
+  : path_(path), data_(nullptr), size_(0) {
+    TRACK_SPAN("MappedFile");
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      TRACK_COUNT(ExceptionsThrown, 1);
+      throw std::invalid_argument("could not open \"" + path + "\"");
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+      close(fd);
+      TRACK_COUNT(ExceptionsThrown, 1);
+      throw std::invalid_argument("could not open \"" + path + "\"");
+    }
+    size_ = info.st_size;
+    // mmap rejects empty mappings, so an empty file maps to no text
+    if (size_ > 0) {
+      void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+	close(fd);
+	TRACK_COUNT(ExceptionsThrown, 1);
+	throw std::invalid_argument("could not map \"" + path + "\"");
+      }
+      data_ = static_cast<const char*>(data);
+    }
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+    TRACK_COUNT(BytesRead, size_);
+  }
+
+  MappedFile::~MappedFile() {
+    if (data_) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+  std::string_view MappedFile::Text() const noexcept {
+    return std::string_view(data_, size_);
+  }
+
+  const std::string& MappedFile::Path() const noexcept {
+    return path_;
+  }
+
+}
@@ -0,0 +1,54 @@
+////////////////////////////////////////////////////////////////////////////////
+// MappedFile.h
+//
+// class MappedFile
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef> // std::size_t
+#include <stdexcept> // std::invalid_argument
+#include <string> // std::string
+#include <string_view> // std::string_view
+
+namespace PackageTracking {
+
+  // A MappedFile maps the contents of a file read-only into memory,
+  // and unmaps it when destroyed. The text stays valid for the
+  // lifetime of the MappedFile, so views into it must not outlive it.
+  //
+  // The mapping is MAP_PRIVATE, which does not copy the file: if
+  // another process truncates it while it is mapped, reading the
+  // pages past the new end raises SIGBUS. Files that are rewritten in
+  // place should be read with std::ifstream instead, or replaced by
+  // renaming a new file over them, which leaves the mapped one
+  // intact. The descriptor is closed once the file is mapped, so
+  // holding many MappedFiles does not hold as many descriptors.
+  class MappedFile {
+  public:
+
+    // Map the file at path.
+    //
+    // Throws std::invalid_argument if the file cannot be opened or
+    // mapped.
+    MappedFile(const std::string& path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Accessors
+    std::string_view Text() const noexcept;
+    const std::string& Path() const noexcept;
+
+  private:
+    std::string path_;
+    const char* data_;
+    std::size_t size_;
+  };
+
+}
+
+#endif
@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////////////
+// MemoryReport.cpp
+//
+// Memory accounting over many PackageStatus objects.
+////////////////////////////////////////////////////////////////////////////////
+
+#include "MemoryReport.h"
+
+#include <iomanip> // std::setw, std::fixed, std::setprecision
+#include <unordered_set> // std::unordered_set
+
+namespace PackageTracking {
+
+  namespace {
+
+    void WriteRow(std::ostream& out, const char* name, const MemoryUsage& usage) {
+      out << "  " << std::left << std::setw(12) << name << std::right
+	  << std::setw(14) << usage.payload
+	  << std::setw(14) << usage.overhead
+	  << std::setw(14) << usage.slack
+	  << std::setw(14) << usage.Total() << std::endl;
+    }
+
+  }
+
+  MemoryUsage MemoryReport::Total() const noexcept {
+    MemoryUsage total = package_usage;
+    total += pool_usage;
+    return total;
+  }
+
+  MemoryReport ReportMemory(const PackageStatus* packages, std::size_t count) {
+    MemoryReport report;
+    std::unordered_set<const StringPool*> pools;
+    for (std::size_t i = 0; i < count; i++) {
+      const PackageStatus& package = packages[i];
+      report.packages++;
+      report.updates += package.Size();
+      report.frozen += package.Frozen();
+      report.package_usage += package.MemoryUsage();
+      if (pools.insert(package.Pool().get()).second) {
+	report.pool_usage += package.Pool()->MemoryUsage();
+      }
+    }
+    report.pools = pools.size();
+    return report;
+  }
+
+  MemoryReport ReportMemory(const std::vector<PackageStatus>& packages) {
+    return ReportMemory(packages.data(), packages.size());
+  }
+
+  void WriteMemoryReport(const MemoryReport& report, std::ostream& out) {
+    out << "memory: " << report.packages << " packages, " << report.updates << " updates, "
+	<< report.frozen << " frozen, " << report.pools << " string pools" << std::endl;
+    out << "  " << std::left << std::setw(12) << "bytes" << std::right
+	<< std::setw(14) << "payload" << std::setw(14) << "overhead"
+	<< std::setw(14) << "slack" << std::setw(14) << "total" << std::endl;
+    WriteRow(out, "packages", report.package_usage);
+    WriteRow(out, "pools", report.pool_usage);
+    WriteRow(out, "total", report.Total());
+
+    double total = report.Total().Total();
+    out << std::fixed << std::setprecision(1);
+    if (report.packages > 0) {
+      out << "  per package " << total / report.packages << std::endl;
+    }
+    if (report.updates > 0) {
+      out << "  per update  " << total / report.updates << std::endl;
+    }
+    out.unsetf(std::ios::floatfield);
+    out << std::setprecision(6);
+  }
+
+}
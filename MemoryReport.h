@@ -0,0 +1,41 @@
+////////////////////////////////////////////////////////////////////////////////
+// MemoryReport.h
+//
+// Memory accounting over many PackageStatus objects.
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MEMORY_REPORT_H
+#define MEMORY_REPORT_H
+
+#include <cstddef> // std::size_t
+#include <ostream> // std::ostream
+#include <vector> // std::vector
+
+#include "MemoryUsage.h"
+#include "PackageStatus.h"
+
+namespace PackageTracking {
+
+  // The memory held by a collection of packages: the sum of their
+  // PackageStatus::MemoryUsage, and separately the StringPools they
+  // intern into, each counted once however many packages share it.
+  struct MemoryReport {
+    std::size_t packages = 0, updates = 0, frozen = 0, pools = 0;
+    MemoryUsage package_usage, pool_usage;
+
+    // Both usages together.
+    MemoryUsage Total() const noexcept;
+  };
+
+  // Account for count packages, starting at packages.
+  MemoryReport ReportMemory(const PackageStatus* packages, std::size_t count);
+  MemoryReport ReportMemory(const std::vector<PackageStatus>& packages);
+
+  // Write report as a table of payload, overhead, slack and total
+  // bytes for the packages, the pools and both, followed by the total
+  // per package and per update.
+  void WriteMemoryReport(const MemoryReport& report, std::ostream& out);
+
+}
+
+#endif
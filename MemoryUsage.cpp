@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////////
+// MemoryUsage.cpp
+//
+// struct MemoryUsage
+////////////////////////////////////////////////////////////////////////////////
+
+#include "MemoryUsage.h"
+
+#include <algorithm> // std::max
+
+namespace PackageTracking {
+
+  namespace {
+
+    // glibc's malloc: each block has a size header, and is a multiple
+    // of 16 bytes and at least 32.
+    constexpr std::size_t kMallocHeader = sizeof(std::size_t),
+      kMallocAlignment = 16, kMallocMinimum = 32;
+
+    // Bytes malloc takes for a request of size bytes, header included.
+    std::size_t BlockSize(std::size_t size) noexcept {
+      std::size_t block = (size + kMallocHeader + kMallocAlignment - 1) & ~(kMallocAlignment - 1);
+      return std::max(block, kMallocMinimum);
+    }
+
+  }
+
+  std::size_t MemoryUsage::Total() const noexcept {
+    return payload + overhead + slack;
+  }
+
+  MemoryUsage& MemoryUsage::operator+=(const MemoryUsage& other) noexcept {
+    payload += other.payload;
+    overhead += other.overhead;
+    slack += other.slack;
+    return *this;
+  }
+
+  void MemoryUsage::AddAllocation(std::size_t used, std::size_t capacity, bool is_payload) noexcept {
+    if (capacity == 0) {
+      return;
+    }
+    (is_payload ? payload : overhead) += used;
+    overhead += kMallocHeader;
+    slack += BlockSize(capacity) - kMallocHeader - used;
+  }
+
+  void MemoryUsage::AddString(const std::string& text, bool is_payload) noexcept {
+    const char* object = reinterpret_cast<const char*>(&text);
+    if ((text.data() >= object) && (text.data() < object + sizeof(text))) {
+      // the short-string buffer, counted with the object as overhead
+      overhead -= text.capacity();
+      (is_payload ? payload : overhead) += text.size();
+      slack += text.capacity() - text.size();
+    } else {
+      // the terminating null is slack
+      AddAllocation(text.size(), text.capacity() + 1, is_payload);
+    }
+  }
+
+}
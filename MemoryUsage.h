@@ -0,0 +1,57 @@
+////////////////////////////////////////////////////////////////////////////////
+// MemoryUsage.h
+//
+// struct MemoryUsage
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <cstddef> // std::size_t
+#include <string> // std::string
+#include <vector> // std::vector
+
+namespace PackageTracking {
+
+  // The memory an object holds, split three ways:
+  //
+  //   payload   bytes of the data itself
+  //   overhead  bytes spent on keeping it: the object's own fields
+  //             other than payload, such as pointers and sizes,
+  //             caches, indexes, and malloc's per-block headers
+  //   slack     bytes allocated but unused: spare capacity, an unused
+  //             short-string buffer, and malloc's rounding
+  //
+  // Heap blocks are sized as glibc's malloc sizes them on 64-bit
+  // targets, with an 8-byte header and 16-byte granularity, so the
+  // totals are estimates for other allocators.
+  struct MemoryUsage {
+    std::size_t payload = 0, overhead = 0, slack = 0;
+
+    std::size_t Total() const noexcept;
+
+    MemoryUsage& operator+=(const MemoryUsage& other) noexcept;
+
+    // Account for a heap block of capacity bytes, of which used bytes
+    // are in use, counting them as payload or, if not payload, as
+    // overhead. A capacity of 0 means no block.
+    void AddAllocation(std::size_t used, std::size_t capacity, bool is_payload = true) noexcept;
+
+    // Account for the characters of a std::string whose own size is
+    // already counted as overhead, as it is for a member. A short
+    // string kept inside the object moves its characters from
+    // overhead to payload, and its unused buffer to slack; a longer
+    // one adds its heap block.
+    void AddString(const std::string& text, bool is_payload = true) noexcept;
+
+    // Account for the elements of a std::vector of trivially copyable
+    // elements, whose own size is already counted as overhead.
+    template <typename T>
+    void AddVector(const std::vector<T>& elements, bool is_payload = true) noexcept {
+      AddAllocation(elements.size() * sizeof(T), elements.capacity() * sizeof(T), is_payload);
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////////
+// PackageCache.cpp
+//
+// class PackageCache
+////////////////////////////////////////////////////////////////////////////////
+
+#include "PackageCache.h"
+
+#include <memory> // std::make_shared
+
+#include <sys/stat.h> // stat
+
+#include "Serialize.h"
+#include "Stats.h"
+
+namespace PackageTracking {
+
+  PackageCache::PackageCache(std::size_t capacity)
+  : capacity_(capacity) {
+    if (capacity == 0) {
+      throw std::invalid_argument("cache capacity must be positive");
+    }
+  }
+
+  void PackageCache::Answer(const Query& query, std::string& buffer) {
+    TRACK_SPAN("PackageCache::Answer");
+    std::shared_ptr<Entry> entry = EntryFor(query.path);
+    std::lock_guard<std::mutex> lock(entry->mutex);
+
+    struct stat info;
+    if (stat(query.path.c_str(), &info) != 0) {
+      entry->status.reset();
+      Drop(query.path, entry);
+      throw std::invalid_argument("could not open \"" + query.path + "\"");
+    }
+    if (!entry->status
+	|| (entry->mtime_seconds != info.st_mtim.tv_sec)
+	|| (entry->mtime_nanoseconds != info.st_mtim.tv_nsec)
+	|| (entry->size != info.st_size)
+	|| (entry->inode != static_cast<long long>(info.st_ino))) {
+      // forget the old contents first, in case loading fails, and
+      // load into a fresh pool, so the old strings go with them
+      entry->status.reset();
+      try {
+	entry->status = PackageStatusFromJSON(query.path, std::make_shared<StringPool>());
+      } catch (std::invalid_argument&) {
+	Drop(query.path, entry);
+	throw;
+      }
+      entry->mtime_seconds = info.st_mtim.tv_sec;
+      entry->mtime_nanoseconds = info.st_mtim.tv_nsec;
+      entry->size = info.st_size;
+      entry->inode = info.st_ino;
+      std::lock_guard<std::mutex> count_lock(mutex_);
+      loads_++;
+      Trim();
+    }
+
+    if (!DescribeQuery(*entry->status, query, buffer)) {
+      throw std::out_of_range("index out of range");
+    }
+  }
+
+  std::size_t PackageCache::Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
+
+  std::size_t PackageCache::Capacity() const noexcept {
+    return capacity_;
+  }
+
+  std::size_t PackageCache::Loads() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return loads_;
+  }
+
+  std::shared_ptr<PackageCache::Entry> PackageCache::EntryFor(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto [it, inserted] = entries_.try_emplace(path);
+    Slot& slot = it->second;
+    if (!inserted) {
+      recent_.splice(recent_.begin(), recent_, slot.recent);
+      return slot.entry;
+    }
+    slot.entry = std::make_shared<Entry>();
+    slot.recent = recent_.insert(recent_.begin(), path);
+    return slot.entry;
+  }
+
+  void PackageCache::Trim() {
+    // a query still using a dropped entry keeps it until it is done
+    while (entries_.size() > capacity_) {
+      entries_.erase(recent_.back());
+      recent_.pop_back();
+    }
+  }
+
+  void PackageCache::Drop(const std::string& path, const std::shared_ptr<Entry>& entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(path);
+    if ((it != entries_.end()) && (it->second.entry == entry)) {
+      recent_.erase(it->second.recent);
+      entries_.erase(it);
+    }
+  }
+
+}
@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////
+// PackageCache.h
+//
+// class PackageCache
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PACKAGE_CACHE_H
+#define PACKAGE_CACHE_H
+
+#include <cstddef> // std::size_t
+#include <list> // std::list
+#include <memory> // std::shared_ptr
+#include <mutex> // std::mutex
+#include <optional> // std::optional
+#include <stdexcept> // std::invalid_argument, std::out_of_range
+#include <string> // std::string
+#include <unordered_map> // std::unordered_map
+
+#include "PackageStatus.h"
+#include "Query.h"
+
+namespace PackageTracking {
+
+  // A PackageCache answers queries about package files, loading each
+  // file once and keeping it, so that repeated queries skip the open
+  // and parse. Before each query the file is checked with stat(2), and
+  // it is loaded again if its modification time, size or inode has
+  // changed.
+  //
+  // At most a fixed number of files are kept; past that, the least
+  // recently queried is dropped. A file that cannot be loaded is not
+  // kept at all. Each load interns into a StringPool of its own, so a
+  // file that is reloaded or dropped gives back its strings.
+  //
+  // It is safe to use from several threads at once. Each file has its
+  // own lock, held while the file is (re)loaded and while a query
+  // moves its cursor, so queries about different files run in
+  // parallel.
+  class PackageCache {
+  public:
+
+    // Files kept by default.
+    static constexpr std::size_t kDefaultCapacity = 1024;
+
+    // Keep at most capacity files, which must be positive.
+    //
+    // Throws std::invalid_argument if capacity is 0.
+    PackageCache(std::size_t capacity = kDefaultCapacity);
+
+    PackageCache(const PackageCache&) = delete;
+    PackageCache& operator=(const PackageCache&) = delete;
+
+    // Append the answer to query to buffer, in the format of the
+    // PackageStatus Describe functions.
+    //
+    // Throws std::invalid_argument with the message
+    // PackageStatusFromJSON gives if the file cannot be loaded, and
+    // std::out_of_range if a selection's index is out of range.
+    void Answer(const Query& query, std::string& buffer);
+
+    // Number of files cached, and the most that may be.
+    std::size_t Size() const;
+    std::size_t Capacity() const noexcept;
+
+    // Number of times any file has been loaded.
+    std::size_t Loads() const;
+
+  private:
+    // One cached file, and what stat(2) said about it when it was
+    // loaded.
+    struct Entry {
+      std::mutex mutex;
+      std::optional<PackageStatus> status;
+      long long mtime_seconds = 0, mtime_nanoseconds = 0, size = 0, inode = 0;
+    };
+
+    // Return the entry for path, adding an empty one if needed, and
+    // make it the most recently used.
+    std::shared_ptr<Entry> EntryFor(const std::string& path);
+
+    // Drop the least recently used entries while there are too many.
+    // Called with mutex_ held, once a file has loaded, so a path that
+    // fails to load never pushes out one that did.
+    void Trim();
+
+    // Drop the entry for path, if it is still entry.
+    void Drop(const std::string& path, const std::shared_ptr<Entry>& entry);
+
+    // An entry, and its place in recent_.
+    struct Slot {
+      std::shared_ptr<Entry> entry;
+      std::list<std::string>::iterator recent;
+    };
+
+    const std::size_t capacity_;
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Slot> entries_;
+    // the cached paths, most recently used first
+    std::list<std::string> recent_;
+    std::size_t loads_ = 0;
+  };
+
+}
+
+#endif
@@ -0,0 +1,448 @@
+////////////////////////////////////////////////////////////////////////////////
+// PackageScanner.cpp
+//
+// class PackageScanner
+////////////////////////////////////////////////////////////////////////////////
+
+#include "PackageScanner.h"
+
+#include <charconv> // std::from_chars
+#include <cstdlib> // std::strtod
+#include <cstdint> // std::uint32_t
+
+#include "Stats.h"
+
+namespace PackageTracking {
+
+  namespace {
+
+    // Values nested deeper than this are rejected rather than risk
+    // running out of stack while skipping them.
+    constexpr int kMaxDepth = 512;
+
+    bool IsDigit(char c) noexcept {
+      return (c >= '0') && (c <= '9');
+    }
+
+    // Return the value of a hexadecimal digit, or -1.
+    int HexValue(char c) noexcept {
+      if (IsDigit(c)) {
+	return c - '0';
+      } else if ((c >= 'a') && (c <= 'f')) {
+	return c - 'a' + 10;
+      } else if ((c >= 'A') && (c <= 'F')) {
+	return c - 'A' + 10;
+      }
+      return -1;
+    }
+
+    // Append the UTF-8 encoding of code_point to out.
+    void AppendUtf8(std::uint32_t code_point, std::string& out) {
+      if (code_point < 0x80) {
+	out += static_cast<char>(code_point);
+      } else if (code_point < 0x800) {
+	out += static_cast<char>(0xC0 | (code_point >> 6));
+	out += static_cast<char>(0x80 | (code_point & 0x3F));
+      } else if (code_point < 0x10000) {
+	out += static_cast<char>(0xE0 | (code_point >> 12));
+	out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+	out += static_cast<char>(0x80 | (code_point & 0x3F));
+      } else {
+	out += static_cast<char>(0xF0 | (code_point >> 18));
+	out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+	out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+	out += static_cast<char>(0x80 | (code_point & 0x3F));
+      }
+    }
+
+  }
+
+  PackageScanner::PackageScanner(std::string_view text) noexcept
+  : text_(text), pos_(0), updates_end_(std::string_view::npos) { }
+
+  void PackageScanner::ScanPackage(Visitor& visitor) {
+    TRACK_TIMER("PackageScanner::ScanPackage");
+    if (Peek() != '{') {
+      // anything other than an object is missing the entries, as long
+      // as it is valid JSON
+      SkipValue();
+      MissingEntries();
+    }
+    pos_++;
+
+    bool seen_tracking_number = false, seen_updates = false;
+    if (!Consume('}')) {
+      do {
+	ScanMember(visitor, seen_tracking_number, seen_updates);
+      } while (Consume(','));
+      Expect('}');
+    }
+
+    if (!seen_tracking_number || !seen_updates) {
+      MissingEntries();
+    }
+  }
+
+  void PackageScanner::ResumePackage(std::size_t updates_end, Visitor& visitor) {
+    TRACK_TIMER("PackageScanner::ResumePackage");
+    if ((updates_end == 0) || (updates_end > text_.size())) {
+      ParseError();
+    }
+    pos_ = updates_end;
+    updates_end_ = updates_end;
+
+    // the rest of the updates array
+    if ((text_[updates_end - 1] == '[') ? !Consume(']') : Consume(',')) {
+      do {
+	ScanUpdate(visitor);
+	updates_end_ = pos_;
+      } while (Consume(','));
+      Expect(']');
+    } else if (text_[updates_end - 1] != '[') {
+      Expect(']');
+    }
+
+    // the members after it; the tracking number may have come before
+    bool seen_tracking_number = false, seen_updates = true;
+    while (Consume(',')) {
+      ScanMember(visitor, seen_tracking_number, seen_updates);
+    }
+    Expect('}');
+  }
+
+  std::size_t PackageScanner::Position() const noexcept {
+    return pos_;
+  }
+
+  std::size_t PackageScanner::UpdatesEnd() const noexcept {
+    return updates_end_;
+  }
+
+  bool PackageScanner::InText(std::string_view view) const noexcept {
+    return (view.data() >= text_.data())
+      && (view.data() + view.size() <= text_.data() + text_.size());
+  }
+
+  void PackageScanner::ScanMember(Visitor& visitor,
+				  bool& seen_tracking_number,
+				  bool& seen_updates) {
+    if (Peek() != '"') {
+      ParseError();
+    }
+    std::string_view key = ScanString(scratch_[2]);
+    Expect(':');
+    if (key == "tracking_number") {
+      if (seen_tracking_number) {
+	ParseError();
+      }
+      seen_tracking_number = true;
+      if (Peek() != '"') {
+	SkipValue();
+	MissingEntries();
+      }
+      visitor.OnTrackingNumber(ScanString(scratch_[0]));
+    } else if (key == "updates") {
+      if (seen_updates) {
+	ParseError();
+      }
+      seen_updates = true;
+      ScanUpdates(visitor);
+    } else {
+      SkipValue();
+    }
+  }
+
+  void PackageScanner::ScanUpdates(Visitor& visitor) {
+    char next = Peek();
+    if (next == 'n') {
+      // an updates value of null holds no updates
+      SkipLiteral("null");
+      return;
+    }
+    if (next != '[') {
+      SkipValue();
+      MissingEntries();
+    }
+    pos_++;
+    updates_end_ = pos_;
+    if (Consume(']')) {
+      return;
+    }
+    do {
+      ScanUpdate(visitor);
+      updates_end_ = pos_;
+    } while (Consume(','));
+    Expect(']');
+  }
+
+  void PackageScanner::ScanUpdate(Visitor& visitor) {
+    if (Peek() != '[') {
+      SkipValue();
+      MissingEntries();
+    }
+    pos_++;
+
+    std::string_view description, location;
+    std::time_t timestamp = 0;
+    int element = 0;
+    if (!Consume(']')) {
+      do {
+	char next = Peek();
+	if ((element == 0) || (element == 1)) {
+	  if (next != '"') {
+	    SkipValue();
+	    MissingEntries();
+	  }
+	  (element == 0 ? description : location) = ScanString(scratch_[element]);
+	} else if (element == 2) {
+	  if ((next != '-') && !IsDigit(next)) {
+	    SkipValue();
+	    MissingEntries();
+	  }
+	  timestamp = ScanNumber();
+	} else {
+	  SkipValue();
+	}
+	element++;
+      } while (Consume(','));
+      Expect(']');
+    }
+    if (element < 3) {
+      MissingEntries();
+    }
+
+    TRACK_COUNT(UpdatesParsed, 1);
+    visitor.OnUpdate(description, location, timestamp);
+  }
+
+  std::string_view PackageScanner::ScanString(std::string& scratch) {
+    // pos_ is at the opening quote
+    std::size_t start = ++pos_;
+    while ((pos_ < text_.size()) && (text_[pos_] != '"') && (text_[pos_] != '\\')) {
+      if (static_cast<unsigned char>(text_[pos_]) < 0x20) {
+	ParseError();
+      }
+      pos_++;
+    }
+    if (pos_ >= text_.size()) {
+      ParseError();
+    }
+    if (text_[pos_] == '"') {
+      // no escapes, so the string can be used where it is
+      return text_.substr(start, pos_++ - start);
+    }
+
+    scratch.assign(text_, start, pos_ - start);
+    while (true) {
+      if (pos_ >= text_.size()) {
+	ParseError();
+      }
+      char c = text_[pos_++];
+      if (c == '"') {
+	return scratch;
+      }
+      if (static_cast<unsigned char>(c) < 0x20) {
+	ParseError();
+      }
+      if (c != '\\') {
+	scratch += c;
+	continue;
+      }
+      if (pos_ >= text_.size()) {
+	ParseError();
+      }
+      switch (text_[pos_++]) {
+      case '"': scratch += '"'; break;
+      case '\\': scratch += '\\'; break;
+      case '/': scratch += '/'; break;
+      case 'b': scratch += '\b'; break;
+      case 'f': scratch += '\f'; break;
+      case 'n': scratch += '\n'; break;
+      case 'r': scratch += '\r'; break;
+      case 't': scratch += '\t'; break;
+      case 'u': {
+	auto read_hex4 = [this]() {
+	  if (pos_ + 4 > text_.size()) {
+	    ParseError();
+	  }
+	  std::uint32_t value = 0;
+	  for (int i = 0; i < 4; i++) {
+	    int digit = HexValue(text_[pos_++]);
+	    if (digit < 0) {
+	      ParseError();
+	    }
+	    value = (value << 4) | digit;
+	  }
+	  return value;
+	};
+	std::uint32_t code_point = read_hex4();
+	if ((code_point >= 0xD800) && (code_point <= 0xDBFF)) {
+	  // high surrogate, which must be followed by a low one
+	  if ((pos_ + 2 > text_.size()) || (text_[pos_] != '\\') || (text_[pos_ + 1] != 'u')) {
+	    ParseError();
+	  }
+	  pos_ += 2;
+	  std::uint32_t low = read_hex4();
+	  if ((low < 0xDC00) || (low > 0xDFFF)) {
+	    ParseError();
+	  }
+	  code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+	} else if ((code_point >= 0xDC00) && (code_point <= 0xDFFF)) {
+	  ParseError();
+	}
+	AppendUtf8(code_point, scratch);
+	break;
+      }
+      default:
+	ParseError();
+      }
+    }
+  }
+
+  std::time_t PackageScanner::ScanNumber() {
+    // match the JSON number grammar
+    std::size_t start = pos_;
+    bool integral = true;
+    if ((pos_ < text_.size()) && (text_[pos_] == '-')) {
+      pos_++;
+    }
+    if ((pos_ >= text_.size()) || !IsDigit(text_[pos_])) {
+      ParseError();
+    }
+    if (text_[pos_] == '0') {
+      pos_++;
+    } else {
+      while ((pos_ < text_.size()) && IsDigit(text_[pos_])) {
+	pos_++;
+      }
+    }
+    if ((pos_ < text_.size()) && (text_[pos_] == '.')) {
+      integral = false;
+      pos_++;
+      if ((pos_ >= text_.size()) || !IsDigit(text_[pos_])) {
+	ParseError();
+      }
+      while ((pos_ < text_.size()) && IsDigit(text_[pos_])) {
+	pos_++;
+      }
+    }
+    if ((pos_ < text_.size()) && ((text_[pos_] == 'e') || (text_[pos_] == 'E'))) {
+      integral = false;
+      pos_++;
+      if ((pos_ < text_.size()) && ((text_[pos_] == '+') || (text_[pos_] == '-'))) {
+	pos_++;
+      }
+      if ((pos_ >= text_.size()) || !IsDigit(text_[pos_])) {
+	ParseError();
+      }
+      while ((pos_ < text_.size()) && IsDigit(text_[pos_])) {
+	pos_++;
+      }
+    }
+
+    const char* first = text_.data() + start;
+    const char* last = text_.data() + pos_;
+    if (integral) {
+      std::time_t value;
+      auto result = std::from_chars(first, last, value);
+      if (result.ec == std::errc()) {
+	return value;
+      }
+      // out of range, so fall back to floating point like
+      // PackageStatusFromJSON does
+    }
+    std::string number(first, last);
+    return static_cast<std::time_t>(std::strtod(number.c_str(), nullptr));
+  }
+
+  void PackageScanner::SkipValue(int depth) {
+    if (depth > kMaxDepth) {
+      ParseError();
+    }
+    switch (Peek()) {
+    case '"':
+      ScanString(scratch_[2]);
+      break;
+    case '{':
+      pos_++;
+      if (!Consume('}')) {
+	do {
+	  if (Peek() != '"') {
+	    ParseError();
+	  }
+	  ScanString(scratch_[2]);
+	  Expect(':');
+	  SkipValue(depth + 1);
+	} while (Consume(','));
+	Expect('}');
+      }
+      break;
+    case '[':
+      pos_++;
+      if (!Consume(']')) {
+	do {
+	  SkipValue(depth + 1);
+	} while (Consume(','));
+	Expect(']');
+      }
+      break;
+    case 't':
+      SkipLiteral("true");
+      break;
+    case 'f':
+      SkipLiteral("false");
+      break;
+    case 'n':
+      SkipLiteral("null");
+      break;
+    default:
+      ScanNumber();
+    }
+  }
+
+  void PackageScanner::SkipLiteral(std::string_view literal) {
+    if (text_.substr(pos_, literal.size()) != literal) {
+      ParseError();
+    }
+    pos_ += literal.size();
+  }
+
+  void PackageScanner::SkipWhitespace() noexcept {
+    while ((pos_ < text_.size())
+	   && ((text_[pos_] == ' ') || (text_[pos_] == '\t')
+	       || (text_[pos_] == '\n') || (text_[pos_] == '\r'))) {
+      pos_++;
+    }
+  }
+
+  bool PackageScanner::Consume(char c) noexcept {
+    SkipWhitespace();
+    if ((pos_ < text_.size()) && (text_[pos_] == c)) {
+      pos_++;
+      return true;
+    }
+    return false;
+  }
+
+  void PackageScanner::Expect(char c) {
+    if (!Consume(c)) {
+      ParseError();
+    }
+  }
+
+  char PackageScanner::Peek() noexcept {
+    SkipWhitespace();
+    return (pos_ < text_.size()) ? text_[pos_] : '\0';
+  }
+
+  void PackageScanner::ParseError() {
+    TRACK_COUNT(ExceptionsThrown, 1);
+    throw std::invalid_argument("JSON parse error");
+  }
+
+  void PackageScanner::MissingEntries() {
+    TRACK_COUNT(ExceptionsThrown, 1);
+    throw std::invalid_argument("JSON is missing entries");
+  }
+
+}
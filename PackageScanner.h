@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////
+// PackageScanner.h
+//
+// class PackageScanner
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PACKAGE_SCANNER_H
+#define PACKAGE_SCANNER_H
+
+#include <cstddef> // std::size_t
+#include <ctime> // std::time_t
+#include <stdexcept> // std::invalid_argument
+#include <string> // std::string
+#include <string_view> // std::string_view
+
+namespace PackageTracking {
+
+  // A PackageScanner reads package JSON documents, in the format
+  // accepted by PackageStatusFromJSON, straight out of a block of text
+  // in memory, without building a tree.
+  //
+  // Strings that contain no escape sequences are handed to the
+  // visitor as views into the text itself. Strings that do are
+  // unescaped into scratch storage owned by the scanner, which is
+  // reused by later strings; InText tells the two apart.
+  //
+  // Like PackageStatusFromJSON, the scanner skips unknown members of
+  // the root object and extra elements of an update, but it does not
+  // validate UTF-8.
+  class PackageScanner {
+  public:
+
+    // Receives the parts of a package as they are scanned.
+    class Visitor {
+    public:
+      virtual ~Visitor() = default;
+
+      virtual void OnTrackingNumber(std::string_view tracking_number) = 0;
+
+      // Called once per update, in document order.
+      virtual void OnUpdate(std::string_view description,
+			    std::string_view location,
+			    std::time_t timestamp) = 0;
+    };
+
+    // Initialize to scan text, starting at its first character. text
+    // must outlive the scanner.
+    PackageScanner(std::string_view text) noexcept;
+
+    // Scan one package document starting at Position(), and leave
+    // Position() just past its closing brace.
+    //
+    // Throws std::invalid_argument with the same messages as
+    // PackageStatusFromJSON if the document is malformed or missing
+    // entries. Exceptions thrown by the visitor propagate.
+    void ScanPackage(Visitor& visitor);
+
+    // Scan the rest of a package document whose text, up to the
+    // offset updates_end, is the same as that of a document on which
+    // UpdatesEnd() returned updates_end: the updates after that
+    // offset, then the members after the updates array. Only those
+    // updates, and a tracking number that comes after the updates,
+    // are handed to the visitor. Leaves Position() just past the
+    // closing brace.
+    //
+    // This is how a document that has grown by appending updates is
+    // brought up to date without scanning its old updates again. The
+    // text may start anywhere before updates_end, as long as
+    // updates_end is at least 1 and offsets are relative to the text.
+    //
+    // Throws std::invalid_argument as ScanPackage does.
+    void ResumePackage(std::size_t updates_end, Visitor& visitor);
+
+    // Offset in the text of the next character to scan.
+    std::size_t Position() const noexcept;
+
+    // Offset in the text just past the last update scanned, or just
+    // past the opening bracket of the updates array if it is empty, or
+    // std::string_view::npos if no updates array has been scanned.
+    std::size_t UpdatesEnd() const noexcept;
+
+    // Return true if view points into the scanned text, or false if it
+    // points into the scanner's scratch storage.
+    bool InText(std::string_view view) const noexcept;
+
+  private:
+    // The members below scan one piece of JSON starting at pos_, and
+    // leave pos_ just past it. They throw std::invalid_argument on
+    // syntax errors.
+    // ScanMember scans one member of the root object, and rejects a
+    // repeat of one already seen.
+    void ScanMember(Visitor& visitor, bool& seen_tracking_number, bool& seen_updates);
+    void ScanUpdates(Visitor& visitor);
+    void ScanUpdate(Visitor& visitor);
+    std::string_view ScanString(std::string& scratch);
+    std::time_t ScanNumber();
+    void SkipValue(int depth = 0);
+    void SkipLiteral(std::string_view literal);
+    void SkipWhitespace() noexcept;
+
+    // Skip whitespace, then consume c if it is next.
+    bool Consume(char c) noexcept;
+    // Skip whitespace, then consume c, which must be next.
+    void Expect(char c);
+    // Skip whitespace, then return the next character, or '\0' at the
+    // end of the text.
+    char Peek() noexcept;
+
+    [[noreturn]] static void ParseError();
+    [[noreturn]] static void MissingEntries();
+
+    std::string_view text_;
+    std::size_t pos_, updates_end_;
+
+    // Unescaped strings. An update's description and location are
+    // handed to the visitor together, so they need one buffer each;
+    // the third holds keys and skipped strings.
+    std::string scratch_[3];
+  };
+
+}
+
+#endif
@@ -5,112 +5,620 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "PackageStatus.h"
+#include <algorithm> // std::clamp, std::lower_bound, std::max, std::min, std::upper_bound
+#include <cstdint> // std::uint32_t, std::uint64_t
 #include <exception>
-#include <list>
+#include <unordered_map> // std::unordered_map
+
+#include "Stats.h"
 
 namespace PackageTracking {
 
-  PackageStatus::PackageStatus() noexcept { }
+  namespace {
+
+    // Histories whose newest update starts with this are delivered.
+    constexpr std::string_view kDeliveredPrefix = "Delivered";
+
+    // Write text to a destination of a Describe function.
+    void Write(std::string_view text, std::string& buffer) {
+      buffer += text;
+    }
+
+    void Write(std::string_view text, std::ostream& out) {
+      out << text;
+    }
+
+    void Write(std::string_view text, const DescribeSink& sink) {
+      sink(text);
+    }
+
+    // Append value to bytes in LEB128 form: 7 bits per byte, low bits
+    // first, with the top bit set on every byte but the last.
+    void PutVarint(std::vector<unsigned char>& bytes, std::uint64_t value) {
+      while (value >= 0x80) {
+	bytes.push_back(static_cast<unsigned char>(value | 0x80));
+	value >>= 7;
+      }
+      bytes.push_back(static_cast<unsigned char>(value));
+    }
+
+    // Read a value written by PutVarint at bytes, and advance bytes.
+    std::uint64_t GetVarint(const unsigned char*& bytes) noexcept {
+      std::uint64_t value = 0;
+      for (unsigned shift = 0; ; shift += 7) {
+	unsigned char byte = *bytes++;
+	value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+	if (byte < 0x80) {
+	  return value;
+	}
+      }
+    }
+
+  }
+
+  struct PackageStatus::ColdHistory {
+    int count;
+
+    // ids of every description and location the package uses; codes
+    // in bytes are indices into it
+    std::vector<StringId> dictionary;
+
+    // For each update: the timestamp as a delta from the previous one
+    // (the first zigzag-encoded, since it may be negative), then the
+    // description code, then the location code, all as varints.
+    std::vector<unsigned char> bytes;
+  };
+
+  PackageStatus::PackageStatus() noexcept
+  : pool_(StringPool::Default()), reorder_window_(0) { }
 
   PackageStatus::PackageStatus(const std::string& tracking_number) noexcept
-  : tracking_number_(tracking_number){ }
+  : tracking_number_(tracking_number), pool_(StringPool::Default()), reorder_window_(0) { }
+
+  PackageStatus::PackageStatus(const std::string& tracking_number,
+			       std::shared_ptr<StringPool> pool) noexcept
+  : tracking_number_(tracking_number), pool_(std::move(pool)), reorder_window_(0) { }
 
   const std::string& PackageStatus::TrackingNumber() const noexcept {
     return tracking_number_;
   }
 
+  const std::shared_ptr<StringPool>& PackageStatus::Pool() const noexcept {
+    return pool_;
+  }
+
+  void PackageStatus::SetTrackingNumber(const std::string& tracking_number) {
+    tracking_number_ = tracking_number;
+  }
+
   int PackageStatus::Size() const noexcept {
-    return updates_.size();
+    return cold_ ? cold_->count : timestamps_.size();
   }
 
   bool PackageStatus::Empty() const noexcept {
-    return updates_.empty();
+    return Size() == 0;
+  }
+
+  bool PackageStatus::Frozen() const noexcept {
+    return cold_ != nullptr;
+  }
+
+  bool PackageStatus::Delivered() const {
+    if (Empty()) {
+      return false;
+    }
+    std::shared_ptr<const PackageStatus> decoded;
+    const PackageStatus& readable = Decoded(decoded);
+    return pool_->Get(readable.descriptions_.back()).compare(0, kDeliveredPrefix.size(),
+							      kDeliveredPrefix) == 0;
+  }
+
+  MemoryUsage PackageStatus::MemoryUsage() const noexcept {
+    PackageTracking::MemoryUsage usage;
+    usage.overhead = sizeof(PackageStatus);
+    usage.AddString(tracking_number_);
+    usage.AddVector(timestamps_);
+    usage.AddVector(descriptions_);
+    usage.AddVector(locations_);
+    if (cold_) {
+      // made with make_shared, so one block with the reference counts
+      std::size_t block = sizeof(ColdHistory) + 2 * sizeof(long) + sizeof(void*);
+      usage.AddAllocation(block, block, false);
+      usage.AddVector(cold_->dictionary);
+      usage.AddVector(cold_->bytes);
+    }
+    usage.AddString(rendered_, false);
+    usage.AddVector(rendered_offsets_, false);
+    return usage;
+  }
+
+  void PackageStatus::Freeze() {
+    if (cold_ || timestamps_.empty()) {
+      return;
+    }
+    auto cold = std::make_shared<ColdHistory>();
+    cold->count = timestamps_.size();
+    cold->bytes.reserve(4 * timestamps_.size());
+    std::unordered_map<StringId, std::uint32_t> codes;
+    auto code = [&](StringId id) {
+      auto inserted = codes.emplace(id, cold->dictionary.size());
+      if (inserted.second) {
+	cold->dictionary.push_back(id);
+      }
+      return inserted.first->second;
+    };
+    std::uint64_t first = timestamps_[0];
+    PutVarint(cold->bytes, (first << 1) ^ -(first >> 63));
+    for (std::size_t i = 0; i < timestamps_.size(); i++) {
+      if (i > 0) {
+	PutVarint(cold->bytes, timestamps_[i] - timestamps_[i - 1]);
+      }
+      PutVarint(cold->bytes, code(descriptions_[i]));
+      PutVarint(cold->bytes, code(locations_[i]));
+    }
+    cold->bytes.shrink_to_fit();
+
+    cold_ = std::move(cold);
+    std::vector<std::time_t>().swap(timestamps_);
+    std::vector<StringId>().swap(descriptions_);
+    std::vector<StringId>().swap(locations_);
+    std::string().swap(rendered_);
+    std::vector<std::size_t>().swap(rendered_offsets_);
+  }
+
+  void PackageStatus::Thaw() {
+    if (!cold_) {
+      return;
+    }
+    // decode into new columns, so that nothing changes if this throws
+    std::vector<std::time_t> timestamps(cold_->count);
+    std::vector<StringId> descriptions(cold_->count), locations(cold_->count);
+    const unsigned char* bytes = cold_->bytes.data();
+    std::uint64_t first = GetVarint(bytes);
+    std::time_t timestamp = static_cast<std::time_t>((first >> 1) ^ -(first & 1));
+    for (int i = 0; i < cold_->count; i++) {
+      if (i > 0) {
+	timestamp += GetVarint(bytes);
+      }
+      timestamps[i] = timestamp;
+      descriptions[i] = cold_->dictionary[GetVarint(bytes)];
+      locations[i] = cold_->dictionary[GetVarint(bytes)];
+    }
+    timestamps_.swap(timestamps);
+    descriptions_.swap(descriptions);
+    locations_.swap(locations);
+    cold_.reset();
+  }
+
+  std::time_t PackageStatus::ReorderWindow() const noexcept {
+    return reorder_window_;
+  }
+
+  void PackageStatus::SetReorderWindow(std::time_t seconds) {
+    if (seconds < 0) {
+      throw std::invalid_argument("Reorder window is negative.");
+    }
+    reorder_window_ = seconds;
   }
 
-  void PackageStatus::AddUpdate(const std::string& description,
-				const std::string& location,
+  void PackageStatus::AddUpdate(std::string_view description,
+				std::string_view location,
 				std::time_t timestamp) {
-    ShippingUpdate new_element(description, location, timestamp);
-    if (updates_.empty()) {
-      updates_.push_front(new_element);
-      cursor_ = updates_.begin();
+    TRACK_TIMER("PackageStatus::AddUpdate");
+    Thaw();
+    RequireInWindow(timestamp);
+    StringId description_id = pool_->Intern(description),
+      location_id = pool_->Intern(location);
+    Reserve(1);
+    Insert(timestamp, description_id, location_id);
+  }
+
+  void PackageStatus::AddUpdate(const ShippingUpdate& update) {
+    if (&update.Pool() == pool_.get()) {
+      TRACK_TIMER("PackageStatus::AddUpdate");
+      Thaw();
+      RequireInWindow(update.Timestamp());
+      Reserve(1);
+      Insert(update.Timestamp(), update.DescriptionId(), update.LocationId());
     } else {
-      std::list<ShippingUpdate>::iterator last_update = --updates_.end();
-      if (new_element.Timestamp() >= last_update->Timestamp()) {
-        updates_.push_back(new_element);
-      } else { throw std::invalid_argument("Given timestamp is invalid."); }
+      AddUpdate(update.Description(), update.Location(), update.Timestamp());
     }
   }
 
-  bool PackageStatus::MoveCursorBackward() noexcept {
-    if(updates_.empty()) {
-      return false;
+  void PackageStatus::AddUpdates(const ShippingUpdate* updates, std::size_t count) {
+    if (count == 0) {
+      return;
     }
-    if (cursor_ == updates_.begin()) {
-      return false;
+    TRACK_TIMER("PackageStatus::AddUpdates");
+    Thaw();
+
+    // Validate the whole batch first, against a running maximum. The
+    // loop has no early exit so that it can be vectorized.
+    std::time_t newest = timestamps_.empty() ? updates[0].Timestamp() : timestamps_.back();
+    bool in_order = true, in_window = true, same_pool = true;
+    for (std::size_t i = 0; i < count; i++) {
+      std::time_t timestamp = updates[i].Timestamp();
+      in_order &= (timestamp >= newest);
+      in_window &= (timestamp >= newest - reorder_window_);
+      same_pool &= (&updates[i].Pool() == pool_.get());
+      newest = std::max(newest, timestamp);
+    }
+    if (!in_window) {
+      TRACK_COUNT(ExceptionsThrown, 1);
+      throw std::invalid_argument("Given timestamp is invalid.");
+    }
+
+    Reserve(count);
+    if (same_pool && in_order) {
+      for (std::size_t i = 0; i < count; i++) {
+	Append(updates[i].Timestamp(), updates[i].DescriptionId(), updates[i].LocationId());
+      }
+    } else if (same_pool) {
+      for (std::size_t i = 0; i < count; i++) {
+	Insert(updates[i].Timestamp(), updates[i].DescriptionId(), updates[i].LocationId());
+      }
     } else {
-      cursor_--;
-      return true;
+      // re-intern every string before adding anything, since
+      // interning can throw
+      std::vector<StringId> ids(2 * count);
+      for (std::size_t i = 0; i < count; i++) {
+	ids[2 * i] = pool_->Intern(updates[i].Description());
+	ids[2 * i + 1] = pool_->Intern(updates[i].Location());
+      }
+      for (std::size_t i = 0; i < count; i++) {
+	Insert(updates[i].Timestamp(), ids[2 * i], ids[2 * i + 1]);
+      }
     }
   }
 
-  bool PackageStatus::MoveCursorForward() noexcept {
-    if (updates_.empty()) {
-      return false;
-    }
-    if (cursor_ == --updates_.end()) {
+  void PackageStatus::AddUpdates(const std::vector<ShippingUpdate>& updates) {
+    AddUpdates(updates.data(), updates.size());
+  }
+
+  int PackageStatus::FirstUpdateAtOrAfter(std::time_t t) const {
+    std::shared_ptr<const PackageStatus> decoded;
+    const std::vector<std::time_t>& timestamps = Decoded(decoded).timestamps_;
+    auto found = std::lower_bound(timestamps.begin(), timestamps.end(), t);
+    return (found == timestamps.end()) ? -1 : (found - timestamps.begin());
+  }
+
+  bool PackageStatus::SeekCursorToTime(std::time_t t) {
+    TRACK_TIMER("PackageStatus::SeekCursorToTime");
+    int index = FirstUpdateAtOrAfter(t);
+    if (index < 0) {
       return false;
-    } else{
-      cursor_++;
-      return true;
     }
+    cursor_ = index;
+    return true;
   }
 
-  const ShippingUpdate& PackageStatus::GetCursor() const {
-    if (updates_.empty()) {
-      throw std::logic_error("PackageStatus is empty.");
-    } else {
-      return *cursor_;
-    }
+  ShippingUpdate PackageStatus::GetCursor() const {
+    RequireNotEmpty();
+    std::shared_ptr<const PackageStatus> decoded;
+    return Decoded(decoded).UpdateAt(cursor_);
   }
 
   std::string PackageStatus::DescribeCursorUpdate() {
-    return cursor_->Describe();
+    std::string cursor_update;
+    DescribeCursorUpdate(cursor_update);
+    return cursor_update;
+  }
+
+  void PackageStatus::DescribeCursorUpdate(std::string& buffer) {
+    Describe(Updates(CursorRange()), buffer);
+  }
+
+  void PackageStatus::DescribeCursorUpdate(std::ostream& out) {
+    Describe(Updates(CursorRange()), out);
+  }
+
+  void PackageStatus::DescribeCursorUpdate(const DescribeSink& sink) {
+    Describe(Updates(CursorRange()), sink);
+  }
+
+  std::string_view PackageStatus::DescribeCursorUpdateView() {
+    Range range = CursorRange();
+    return RenderedSlice(range.first, range.last);
   }
 
   std::string PackageStatus::DescribePreviousUpdates() {
     std::string previous_updates;
-    if (updates_.empty()) {
-      throw std::logic_error("PackageStatus is empty.");
-    } else {
-      for (std::list<ShippingUpdate>::iterator prev_updates = updates_.begin();
-           prev_updates != cursor_; prev_updates++ ) {
-             previous_updates += prev_updates->Describe();
-           }
-    }
+    DescribePreviousUpdates(previous_updates);
     return previous_updates;
   }
 
+  void PackageStatus::DescribePreviousUpdates(std::string& buffer) {
+    Describe(Updates(PreviousRange()), buffer);
+  }
+
+  void PackageStatus::DescribePreviousUpdates(std::ostream& out) {
+    Describe(Updates(PreviousRange()), out);
+  }
+
+  void PackageStatus::DescribePreviousUpdates(const DescribeSink& sink) {
+    Describe(Updates(PreviousRange()), sink);
+  }
+
+  std::string_view PackageStatus::DescribePreviousUpdatesView() {
+    Range range = PreviousRange();
+    return RenderedSlice(range.first, range.last);
+  }
+
   std::string PackageStatus::DescribeFollowingUpdates() {
     std::string following_updates;
-    if (updates_.empty()) {
-      throw std::logic_error("PackageStatus is empty.");
-    } else {
-      for (std::list<ShippingUpdate>::iterator follow_updates = cursor_;
-           follow_updates != updates_.end(); follow_updates++ ) {
-             following_updates += follow_updates->Describe();
-           }
-    }
+    DescribeFollowingUpdates(following_updates);
     return following_updates;
   }
 
+  void PackageStatus::DescribeFollowingUpdates(std::string& buffer) {
+    Describe(Updates(FollowingRange()), buffer);
+  }
+
+  void PackageStatus::DescribeFollowingUpdates(std::ostream& out) {
+    Describe(Updates(FollowingRange()), out);
+  }
+
+  void PackageStatus::DescribeFollowingUpdates(const DescribeSink& sink) {
+    Describe(Updates(FollowingRange()), sink);
+  }
+
+  std::string_view PackageStatus::DescribeFollowingUpdatesView() {
+    Range range = FollowingRange();
+    return RenderedSlice(range.first, range.last);
+  }
+
   std::string PackageStatus::DescribeAllUpdates() {
     std::string all_updates;
-    for (std::list<ShippingUpdate>::iterator every_update = updates_.begin();
-         every_update != updates_.end(); every_update++ ) {
-           all_updates += every_update->Describe();
-         }
+    DescribeAllUpdates(all_updates);
     return all_updates;
   }
 
+  void PackageStatus::DescribeAllUpdates(std::string& buffer) {
+    Describe(Updates(AllRange()), buffer);
+  }
+
+  void PackageStatus::DescribeAllUpdates(std::ostream& out) {
+    Describe(Updates(AllRange()), out);
+  }
+
+  void PackageStatus::DescribeAllUpdates(const DescribeSink& sink) {
+    Describe(Updates(AllRange()), sink);
+  }
+
+  std::string_view PackageStatus::DescribeAllUpdatesView() {
+    Range range = AllRange();
+    return RenderedSlice(range.first, range.last);
+  }
+
+  std::string PackageStatus::DescribeUpdatesBetween(std::time_t t0, std::time_t t1) {
+    std::string between;
+    DescribeUpdatesBetween(t0, t1, between);
+    return between;
+  }
+
+  void PackageStatus::DescribeUpdatesBetween(std::time_t t0, std::time_t t1,
+					     std::string& buffer) {
+    Describe(UpdatesBetween(t0, t1), buffer);
+  }
+
+  void PackageStatus::DescribeUpdatesBetween(std::time_t t0, std::time_t t1,
+					     std::ostream& out) {
+    Describe(UpdatesBetween(t0, t1), out);
+  }
+
+  void PackageStatus::DescribeUpdatesBetween(std::time_t t0, std::time_t t1,
+					     const DescribeSink& sink) {
+    Describe(UpdatesBetween(t0, t1), sink);
+  }
+
+  std::string_view PackageStatus::DescribeUpdatesBetweenView(std::time_t t0, std::time_t t1) {
+    Thaw();
+    UpdateRange range = UpdatesBetween(t0, t1);
+    return RenderedSlice(range.First(), range.First() + range.Size());
+  }
+
+  PackageStatus::UpdateRange PackageStatus::Updates() const {
+    return Updates(AllRange());
+  }
+
+  PackageStatus::UpdateRange PackageStatus::Updates(int first, int count) const {
+    first = std::clamp(first, 0, Size());
+    count = std::clamp(count, 0, Size() - first);
+    return Updates(Range{first, first + count});
+  }
+
+  PackageStatus::UpdateRange PackageStatus::UpdatesBetween(std::time_t t0,
+							   std::time_t t1) const {
+    if (t1 < t0) {
+      return UpdateRange(this, 0, 0);
+    }
+    std::shared_ptr<const PackageStatus> decoded;
+    const PackageStatus& readable = Decoded(decoded);
+    auto begin = readable.timestamps_.begin(),
+      first = std::lower_bound(begin, readable.timestamps_.end(), t0),
+      last = std::upper_bound(first, readable.timestamps_.end(), t1);
+    return UpdateRange(&readable, first - begin, last - begin, std::move(decoded));
+  }
+
+  PackageStatus::UpdateRange PackageStatus::Updates(Range range) const {
+    std::shared_ptr<const PackageStatus> decoded;
+    const PackageStatus& readable = Decoded(decoded);
+    return UpdateRange(&readable, range.first, range.last, std::move(decoded));
+  }
+
+  const PackageStatus&
+  PackageStatus::Decoded(std::shared_ptr<const PackageStatus>& decoded) const {
+    if (!cold_) {
+      return *this;
+    }
+    TRACK_TIMER("PackageStatus::Decoded");
+    auto copy = std::make_shared<PackageStatus>(*this);
+    copy->Thaw();
+    decoded = copy;
+    return *copy;
+  }
+
+  template <typename Destination>
+  void PackageStatus::Describe(const UpdateRange& range, Destination& out) {
+    if (cold_) {
+      range.DescribeTo(out);
+    } else {
+      Write(RenderedSlice(range.First(), range.First() + range.Size()), out);
+    }
+  }
+
+  ShippingUpdate PackageStatus::UpdateAt(int index) const noexcept {
+    return ShippingUpdate(*pool_, descriptions_[index], locations_[index],
+			  timestamps_[index]);
+  }
+
+  template <typename Destination>
+  void PackageStatus::DescribeRange(int first, int last, Destination& out) const {
+    for (int i = first; i < last; i++) {
+      WriteDescription(timestamps_[i], pool_->Get(descriptions_[i]),
+		       pool_->Get(locations_[i]), out);
+    }
+  }
+
+  void PackageStatus::RequireNotEmpty() const {
+    if (Empty()) {
+      throw std::logic_error("PackageStatus is empty.");
+    }
+  }
+
+  void PackageStatus::Reserve(std::size_t count) {
+    std::size_t needed = timestamps_.size() + count,
+      capacity = std::min({timestamps_.capacity(), descriptions_.capacity(),
+			   locations_.capacity()});
+    if (needed > capacity) {
+      capacity = std::max(needed, 2 * capacity);
+      timestamps_.reserve(capacity);
+      descriptions_.reserve(capacity);
+      locations_.reserve(capacity);
+    }
+  }
+
+  void PackageStatus::Append(std::time_t timestamp, StringId description,
+			     StringId location) noexcept {
+    timestamps_.push_back(timestamp);
+    descriptions_.push_back(description);
+    locations_.push_back(location);
+  }
+
+  void PackageStatus::Insert(std::time_t timestamp, StringId description,
+			     StringId location) noexcept {
+    if (timestamps_.empty() || (timestamp >= timestamps_.back())) {
+      Append(timestamp, description, location);
+      return;
+    }
+    int position = std::upper_bound(timestamps_.begin(), timestamps_.end(), timestamp)
+      - timestamps_.begin();
+    timestamps_.insert(timestamps_.begin() + position, timestamp);
+    descriptions_.insert(descriptions_.begin() + position, description);
+    locations_.insert(locations_.begin() + position, location);
+    if (position <= cursor_) {
+      cursor_++;
+    }
+    // everything rendered from position on has moved
+    if (static_cast<int>(rendered_offsets_.size()) > position + 1) {
+      rendered_.resize(rendered_offsets_[position]);
+      rendered_offsets_.resize(position + 1);
+    }
+  }
+
+  void PackageStatus::RequireInWindow(std::time_t timestamp) const {
+    if (!timestamps_.empty() && (timestamp < timestamps_.back() - reorder_window_)) {
+      TRACK_COUNT(ExceptionsThrown, 1);
+      throw std::invalid_argument("Given timestamp is invalid.");
+    }
+  }
+
+  std::string_view PackageStatus::RenderedSlice(int first, int last) {
+    TRACK_TIMER("PackageStatus::RenderedSlice");
+    Thaw();
+    if (rendered_offsets_.empty()) {
+      rendered_offsets_.push_back(0);
+    }
+    int rendered_count = rendered_offsets_.size() - 1;
+    if (rendered_count < Size()) {
+      rendered_offsets_.reserve(Size() + 1);
+      for (int i = rendered_count; i < Size(); i++) {
+	WriteDescription(timestamps_[i], pool_->Get(descriptions_[i]),
+			 pool_->Get(locations_[i]), rendered_);
+	rendered_offsets_.push_back(rendered_.size());
+      }
+    }
+    TRACK_COUNT(OutputBytes, rendered_offsets_[last] - rendered_offsets_[first]);
+    return std::string_view(rendered_).substr(rendered_offsets_[first],
+					      rendered_offsets_[last] - rendered_offsets_[first]);
+  }
+
+  PackageStatus::UpdateRange::UpdateRange(const PackageStatus* status,
+					  int first, int last,
+					  std::shared_ptr<const PackageStatus> decoded) noexcept
+  : status_(status), first_(first), last_(last), decoded_(std::move(decoded)) { }
+
+  PackageStatus::UpdateRange::const_iterator
+  PackageStatus::UpdateRange::begin() const noexcept {
+    return const_iterator(status_, first_);
+  }
+
+  PackageStatus::UpdateRange::const_iterator
+  PackageStatus::UpdateRange::end() const noexcept {
+    return const_iterator(status_, last_);
+  }
+
+  int PackageStatus::UpdateRange::Size() const noexcept {
+    return last_ - first_;
+  }
+
+  bool PackageStatus::UpdateRange::Empty() const noexcept {
+    return first_ == last_;
+  }
+
+  int PackageStatus::UpdateRange::First() const noexcept {
+    return first_;
+  }
+
+  void PackageStatus::UpdateRange::DescribeTo(std::string& buffer) const {
+    status_->DescribeRange(first_, last_, buffer);
+  }
+
+  void PackageStatus::UpdateRange::DescribeTo(std::ostream& out) const {
+    status_->DescribeRange(first_, last_, out);
+  }
+
+  void PackageStatus::UpdateRange::DescribeTo(const DescribeSink& sink) const {
+    status_->DescribeRange(first_, last_, sink);
+  }
+
+  PackageStatus::UpdateRange::const_iterator::const_iterator(const PackageStatus* status,
+							     int index) noexcept
+  : status_(status), index_(index) { }
+
+  ShippingUpdate PackageStatus::UpdateRange::const_iterator::operator*() const noexcept {
+    return status_->UpdateAt(index_);
+  }
+
+  PackageStatus::UpdateRange::const_iterator&
+  PackageStatus::UpdateRange::const_iterator::operator++() noexcept {
+    index_++;
+    return *this;
+  }
+
+  PackageStatus::UpdateRange::const_iterator
+  PackageStatus::UpdateRange::const_iterator::operator++(int) noexcept {
+    const_iterator old = *this;
+    index_++;
+    return old;
+  }
+
+  bool PackageStatus::UpdateRange::const_iterator::operator==(const const_iterator& other) const noexcept {
+    return (status_ == other.status_) && (index_ == other.index_);
+  }
+
+  bool PackageStatus::UpdateRange::const_iterator::operator!=(const const_iterator& other) const noexcept {
+    return !(*this == other);
+  }
+
 }
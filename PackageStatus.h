@@ -7,11 +7,19 @@
 #ifndef PACKAGE_STATUS_H
 #define PACKAGE_STATUS_H
 
+#include <ctime> // std::time_t
+#include <iterator> // std::input_iterator_tag
+#include <memory> // std::shared_ptr
+#include <ostream> // std::ostream
 #include <stdexcept> // std::invalid_argument, std::logic_error
 #include <string> // std::string
-#include <list> //std::list
+#include <string_view> // std::string_view
+#include <vector> // std::vector
 
+#include "MemoryUsage.h"
 #include "ShippingUpdate.h"
+#include "StringPool.h"
+#include "UpdateCursor.h"
 
 namespace PackageTracking {
 
@@ -27,9 +35,72 @@ namespace PackageTracking {
   // is undefined. When the first update is added, the cursor points
   // to that first update. When there are multiple updates, the cursor
   // can move forward and backward through the update list.
-  class PackageStatus {
+  //
+  // Descriptions and locations are interned into a StringPool, which
+  // may be shared by many PackageStatus objects.
+  //
+  // A closed history can be frozen into a compressed form; see
+  // Freeze. PackageStore does this for delivered packages; see
+  // PackageStore::SetFreezeDelivered.
+  class PackageStatus : private UpdateCursor<PackageStatus> {
   public:
 
+    // A lazy, read-only view of a contiguous run of updates. Iterating
+    // it yields ShippingUpdate objects one at a time, so a caller can
+    // page through a long history without building its whole
+    // description.
+    //
+    // A range is invalidated by any change to the PackageStatus it
+    // came from. A range of a frozen PackageStatus holds a decoded
+    // copy of it, so its iterators are valid only while the range is.
+    class UpdateRange {
+    public:
+      class const_iterator {
+      public:
+	using iterator_category = std::input_iterator_tag;
+	using value_type = ShippingUpdate;
+	using difference_type = int;
+	using pointer = void;
+	using reference = ShippingUpdate;
+
+	const_iterator(const PackageStatus* status, int index) noexcept;
+
+	ShippingUpdate operator*() const noexcept;
+	const_iterator& operator++() noexcept;
+	const_iterator operator++(int) noexcept;
+	bool operator==(const const_iterator& other) const noexcept;
+	bool operator!=(const const_iterator& other) const noexcept;
+
+      private:
+	const PackageStatus* status_;
+	int index_;
+      };
+
+      UpdateRange(const PackageStatus* status, int first, int last,
+		  std::shared_ptr<const PackageStatus> decoded = nullptr) noexcept;
+
+      const_iterator begin() const noexcept;
+      const_iterator end() const noexcept;
+
+      // Number of updates in the range, and the index of its first
+      // update within the PackageStatus.
+      int Size() const noexcept;
+      bool Empty() const noexcept;
+      int First() const noexcept;
+
+      // Write the description of every update in the range, in the
+      // format of ShippingUpdate::Describe; see WriteDescription.
+      void DescribeTo(std::string& buffer) const;
+      void DescribeTo(std::ostream& out) const;
+      void DescribeTo(const DescribeSink& sink) const;
+
+    private:
+      const PackageStatus* status_;
+      int first_, last_;
+      // the decoded copy status_ points into, if any
+      std::shared_ptr<const PackageStatus> decoded_;
+    };
+
     // Default constructor: initialize with an empty-string tracking
     // number, and an empty list of updates.
     PackageStatus() noexcept;
@@ -38,13 +109,70 @@ namespace PackageTracking {
     // number, and an empty list of updates.
     PackageStatus(const std::string& tracking_number) noexcept;
 
+    // Initialization constructor: initialize with the given tracking
+    // number, an empty list of updates, and the StringPool to intern
+    // descriptions and locations into. pool must not be null.
+    PackageStatus(const std::string& tracking_number,
+		  std::shared_ptr<StringPool> pool) noexcept;
+
     // Accessors
     const std::string& TrackingNumber() const noexcept;
+    const std::shared_ptr<StringPool>& Pool() const noexcept;
 
-    // Size and emptiness. These refer to the number of updates.
+    // Mutator. Loaders use this when the tracking number only turns up
+    // after the updates.
+    void SetTrackingNumber(const std::string& tracking_number);
+
+    // Size and emptiness. These refer to the number of updates. They
+    // never decode a frozen PackageStatus.
     int Size() const noexcept;
     bool Empty() const noexcept;
 
+    // Whether the updates are currently held in compressed form.
+    bool Frozen() const noexcept;
+
+    // Whether the newest update's description starts with
+    // "Delivered", which closes the history.
+    bool Delivered() const;
+
+    // Memory held by this object; see MemoryUsage. Payload is the
+    // tracking number and the updates, in columns or compressed. The
+    // render cache is overhead. The text of descriptions and locations is counted
+    // by the pool, and a compressed form shared by copies is counted
+    // by each of them. Never decodes a frozen PackageStatus.
+    PackageTracking::MemoryUsage MemoryUsage() const noexcept;
+
+    // Compress the updates, and drop the render cache. Timestamps are
+    // stored as varint-encoded deltas, and descriptions and locations
+    // as varint codes into a dictionary of the ids this package uses,
+    // so a typical update takes a few bytes instead of dozens.
+    //
+    // Freezing is never done implicitly; PackageStore does it for
+    // delivered packages, and other owners decide for themselves.
+    //
+    // Reading a frozen PackageStatus, through a const function or a
+    // Describe function that writes to a destination, decodes the
+    // updates into a temporary copy, and leaves this one frozen, so
+    // concurrent const reads are safe. Changing the updates, such as
+    // with AddUpdate, and the ...View functions, which need the render
+    // cache, decode them in place, and they stay decoded until the
+    // next Freeze. Moving the cursor, Size and Empty do not decode.
+    // Copies of a frozen PackageStatus share its compressed form.
+    //
+    // Has no effect on an empty or already frozen PackageStatus.
+    void Freeze();
+
+    // Decode the updates in place now, if they are frozen.
+    void Thaw();
+
+    // The reorder window, in seconds; see AddUpdate. It is 0 by
+    // default, which accepts updates only in chronological order.
+    //
+    // SetReorderWindow throws std::invalid_argument if seconds is
+    // negative.
+    std::time_t ReorderWindow() const noexcept;
+    void SetReorderWindow(std::time_t seconds);
+
     // Add an update with the given description, location, and
     // timestamp.
     //
@@ -54,21 +182,50 @@ namespace PackageTracking {
     // timestamps are allowed because mail-handling equipment sometimes
     // generates two events in the same second.)
     //
+    // Carrier feeds often deliver events a little out of order, so a
+    // timestamp up to ReorderWindow() seconds older than the last
+    // update is also accepted. Such a late update is inserted after
+    // every update with an earlier or equal timestamp, which costs
+    // time proportional to the number of updates after it. The cursor
+    // keeps pointing at the same update, so it moves forward one index
+    // when the insertion is at or before it.
+    //
     // When the first update is added, the cursor is moved to point at
     // that new update.
     //
+    // The strings are interned into Pool(), so a string that is
+    // already in the pool is not copied at all.
+    //
     // Throws std::invalid_argument if the given timestamp is invalid.
-    void AddUpdate(const std::string& description,
-		   const std::string& location,
+    void AddUpdate(std::string_view description,
+		   std::string_view location,
 		   std::time_t timestamp);
 
+    // Add a copy of the given update, following the same rules as the
+    // AddUpdate above. If update refers to Pool(), only its ids are
+    // copied.
+    void AddUpdate(const ShippingUpdate& update);
+
+    // Add count updates, starting at updates, in order, following the
+    // same rules as AddUpdate: no update may be older than the newest
+    // update before it, whether in the batch or already in this
+    // PackageStatus, by more than ReorderWindow() seconds.
+    //
+    // The batch is validated in one pass before anything is added,
+    // and capacity is reserved once, so either every update is added
+    // or none are.
+    //
+    // Throws std::invalid_argument if any timestamp is invalid.
+    void AddUpdates(const ShippingUpdate* updates, std::size_t count);
+    void AddUpdates(const std::vector<ShippingUpdate>& updates);
+
     // Attempt to move the cursor backward one step.
     //
     // If the PackageStatus is empty, or the cursor is already
     // pointing to the first update, this has no effect and returns
     // false. Otherwise, this moves the cursor one step backwards and
     // returns true.
-    bool MoveCursorBackward() noexcept;
+    using UpdateCursor::MoveCursorBackward;
 
     // Attempt to move the cursor forward one step.
     //
@@ -76,13 +233,43 @@ namespace PackageTracking {
     // pointing to the last update, this has no effect and returns
     // false. Otherwise, this moves the cursor one step forward and
     // returns true.
-    bool MoveCursorForward() noexcept;
+    using UpdateCursor::MoveCursorForward;
 
-    // Return a reference to the ShippingUpdate object that the cursor
-    // is pointing at. The PackageStatus must not be empty.
+    // Attempt to move the cursor to the update at the given index
+    // (starting from 0), in constant time.
+    //
+    // If the PackageStatus is empty, or the index is out of range,
+    // this has no effect and returns false. Otherwise, this moves the
+    // cursor and returns true.
+    using UpdateCursor::SeekCursor;
+
+    // Attempt to move the cursor delta steps, forward when delta is
+    // positive and backward when it is negative, in constant time.
+    //
+    // If the PackageStatus is empty, or the destination is out of
+    // range, this has no effect and returns false. Otherwise, this
+    // moves the cursor and returns true.
+    using UpdateCursor::MoveCursor;
+
+    // Return the index of the first update whose timestamp is at or
+    // after t, or -1 if there is none, in logarithmic time.
+    int FirstUpdateAtOrAfter(std::time_t t) const;
+
+    // Attempt to move the cursor to the first update whose timestamp
+    // is at or after t, in logarithmic time.
+    //
+    // If there is no such update, this has no effect and returns
+    // false. Otherwise, this moves the cursor and returns true.
+    bool SeekCursorToTime(std::time_t t);
+
+    // Return the ShippingUpdate that the cursor is pointing at. The
+    // PackageStatus must not be empty.
+    //
+    // Updates are stored column-wise, so this returns a ShippingUpdate
+    // assembled from the columns rather than a reference into them.
     //
     // If the PackageStatus is empty, throws std::logic_error.
-    const ShippingUpdate& GetCursor() const;
+    ShippingUpdate GetCursor() const;
 
     // Return a description of the ShippingUpdate object that the
     // cursor is pointing at, following the same format as
@@ -90,6 +277,10 @@ namespace PackageTracking {
     //
     // If the PackageStatus is empty, throws std::logic_error.
     std::string DescribeCursorUpdate();
+    void DescribeCursorUpdate(std::string& buffer);
+    void DescribeCursorUpdate(std::ostream& out);
+    void DescribeCursorUpdate(const DescribeSink& sink);
+    std::string_view DescribeCursorUpdateView();
 
     // Return a description of all ShippingUpdates prior to the cursor
     // (so not including the cursor update). Each update's description
@@ -99,6 +290,10 @@ namespace PackageTracking {
     //
     // If the PackageStatus is empty, throws std::logic_error.
     std::string DescribePreviousUpdates();
+    void DescribePreviousUpdates(std::string& buffer);
+    void DescribePreviousUpdates(std::ostream& out);
+    void DescribePreviousUpdates(const DescribeSink& sink);
+    std::string_view DescribePreviousUpdatesView();
 
     // Return a description of all ShippingUpdates, starting at the
     // cursor, and including all later updates. Each update's
@@ -108,6 +303,10 @@ namespace PackageTracking {
     //
     // If the PackageStatus is empty, throws std::logic_error.
     std::string DescribeFollowingUpdates();
+    void DescribeFollowingUpdates(std::string& buffer);
+    void DescribeFollowingUpdates(std::ostream& out);
+    void DescribeFollowingUpdates(const DescribeSink& sink);
+    std::string_view DescribeFollowingUpdatesView();
 
     // Return a description of all ShippingUpdates. Each update's
     // description follows the format of ShippingUpdate::Describe. The
@@ -117,16 +316,130 @@ namespace PackageTracking {
     // The PackageStatus *may* be empty. If so, this function returns
     // an empty string.
     std::string DescribeAllUpdates();
+    void DescribeAllUpdates(std::string& buffer);
+    void DescribeAllUpdates(std::ostream& out);
+    void DescribeAllUpdates(const DescribeSink& sink);
+    std::string_view DescribeAllUpdatesView();
+
+    // Return a description of all ShippingUpdates whose timestamps are
+    // between t0 and t1, inclusive, found in logarithmic time. Each
+    // update's description follows the format of
+    // ShippingUpdate::Describe. The description strings are
+    // concatenated together in chronological order.
+    //
+    // If no updates are in the interval, or t1 is before t0, this
+    // function returns an empty string.
+    std::string DescribeUpdatesBetween(std::time_t t0, std::time_t t1);
+    void DescribeUpdatesBetween(std::time_t t0, std::time_t t1, std::string& buffer);
+    void DescribeUpdatesBetween(std::time_t t0, std::time_t t1, std::ostream& out);
+    void DescribeUpdatesBetween(std::time_t t0, std::time_t t1, const DescribeSink& sink);
+    std::string_view DescribeUpdatesBetweenView(std::time_t t0, std::time_t t1);
+
+    // The Describe functions above that take a std::string, a
+    // std::ostream, or a DescribeSink write the same text as the
+    // versions that return a std::string, but straight into the given
+    // destination. The std::string overloads append to buffer.
+    //
+    // The ...View functions return the same text as a view into a
+    // cache of rendered descriptions kept by this PackageStatus,
+    // decoding a frozen one in place first. The view is valid until
+    // the next call to a non-const member function.
+    //
+    // The first Describe call renders every update into the cache;
+    // later calls render only updates added since (and those moved by
+    // a late update; see AddUpdate), so each call costs O(1) plus the
+    // size of its output.
+
+    // Return a lazy view of all updates, or of up to count updates
+    // starting at index first. The second form clamps the range to the
+    // updates that exist, so it may return fewer than count.
+    UpdateRange Updates() const;
+    UpdateRange Updates(int first, int count) const;
+
+    // Return a lazy view of the updates whose timestamps are between
+    // t0 and t1, inclusive, found in logarithmic time. The view is
+    // empty if t1 is before t0.
+    UpdateRange UpdatesBetween(std::time_t t0, std::time_t t1) const;
 
   private:
+    friend class UpdateCursor<PackageStatus>;
+
+    // The compressed form of a frozen history; see Freeze.
+    struct ColdHistory;
+
+    // Return the update at the given index, which must be in range.
+    // The PackageStatus must not be frozen.
+    ShippingUpdate UpdateAt(int index) const noexcept;
+
+    // Return this PackageStatus, or if it is frozen, a decoded copy of
+    // it, which decoded is set to keep alive.
+    const PackageStatus& Decoded(std::shared_ptr<const PackageStatus>& decoded) const;
+
+    // Write the descriptions of the updates in range, which came from
+    // this PackageStatus, to out: from the render cache, or if frozen,
+    // from the range's decoded copy, so that this stays frozen.
+    template <typename Destination>
+    void Describe(const UpdateRange& range, Destination& out);
+
+    // Return a range of the updates in range.
+    UpdateRange Updates(Range range) const;
+
+    // Write the descriptions of the updates with indices in
+    // [first, last) to out, which is a std::string, a std::ostream, or
+    // a const DescribeSink. The PackageStatus must not be frozen.
+    template <typename Destination>
+    void DescribeRange(int first, int last, Destination& out) const;
+
+    // Throw std::logic_error if there are no updates.
+    void RequireNotEmpty() const;
+
+    // Make room in every column for count more updates, growing
+    // geometrically, so that the following push_backs cannot throw.
+    void Reserve(std::size_t count);
+
+    // Append one update whose strings are already interned into
+    // pool_. Room must have been made with Reserve.
+    void Append(std::time_t timestamp, StringId description,
+		StringId location) noexcept;
+
+    // Insert one update whose strings are already interned into pool_
+    // in chronological position, adjusting the cursor and the render
+    // cache. Room must have been made with Reserve.
+    void Insert(std::time_t timestamp, StringId description,
+		StringId location) noexcept;
+
+    // Throw std::invalid_argument if timestamp is outside the reorder
+    // window.
+    void RequireInWindow(std::time_t timestamp) const;
+
+
+    // Render any updates that are not yet in rendered_, then return
+    // the rendered text of the updates with indices in [first, last).
+    std::string_view RenderedSlice(int first, int last);
+
     //Tracking Number is a unique identifier
     std::string tracking_number_;
 
-    //Doubly-Linked List containing updates
-    std::list<ShippingUpdate> updates_;
+    //interns descriptions and locations
+    std::shared_ptr<StringPool> pool_;
+
+    // Updates are stored as parallel columns, one entry per update in
+    // chronological order. Descriptions and locations are ids into
+    // pool_. While frozen, the columns are empty and the updates are in
+    // cold_ instead.
+    std::vector<std::time_t> timestamps_;
+    std::vector<StringId> descriptions_, locations_;
+    std::shared_ptr<const ColdHistory> cold_;
+
+    // how many seconds late an update may be
+    std::time_t reorder_window_;
 
-    //keeps track of our position in our List
-    std::list<ShippingUpdate>::iterator cursor_;
+    // Cache of rendered descriptions. The description of update i is
+    // rendered_[rendered_offsets_[i], rendered_offsets_[i + 1]). Only
+    // the first rendered_offsets_.size() - 1 updates are rendered;
+    // rendered_offsets_ is empty until the first Describe call.
+    std::string rendered_;
+    std::vector<std::size_t> rendered_offsets_;
   };
 
 }
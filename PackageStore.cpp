@@ -0,0 +1,264 @@
+////////////////////////////////////////////////////////////////////////////////
+// PackageStore.cpp
+//
+// class PackageStore
+////////////////////////////////////////////////////////////////////////////////
+
+#include "PackageStore.h"
+
+#include <algorithm> // std::find
+#include <mutex> // std::unique_lock
+
+namespace PackageTracking {
+
+  // One shard: a dense vector of packages, and a linear-probing hash
+  // table of slots that point into it. Aligned to a cache line so
+  // that neighbouring shards' locks do not share one.
+  struct alignas(64) PackageStore::Shard {
+
+    // An empty slot has the empty key, which no tracking number packs
+    // to.
+    struct Slot {
+      TrackingKey key;
+      std::uint32_t index;
+    };
+
+    // Slots are grown once this fraction of them, in eighths, is full.
+    static constexpr std::size_t kMaxLoadEighths = 6;
+
+    // Delivered packages left decoded by AddUpdate are frozen this many
+    // at a time.
+    static constexpr std::size_t kFreezeBatch = 64;
+
+    Shard()
+    : slots(16, Slot{TrackingKey(), 0}) { }
+
+    // Return the index in packages of the package with the given key,
+    // whose hash is given, or -1. The caller must hold mutex.
+    long Find(const TrackingKey& key, std::size_t hash) const noexcept {
+      std::size_t mask = slots.size() - 1;
+      for (std::size_t i = hash & mask; !slots[i].key.Empty(); i = (i + 1) & mask) {
+	if (slots[i].key == key) {
+	  return slots[i].index;
+	}
+      }
+      return -1;
+    }
+
+    // Add package, whose key must not be present, and return its
+    // index. The caller must hold mutex exclusively.
+    std::uint32_t Insert(const TrackingKey& key, PackageStatus&& package) {
+      if ((packages.size() + 1) * 8 > slots.size() * kMaxLoadEighths) {
+	Grow();
+      }
+      std::uint32_t index = packages.size();
+      packages.push_back(std::move(package));
+      Place(Slot{key, index});
+      return index;
+    }
+
+    // Double the number of slots.
+    void Grow() {
+      std::vector<Slot> old(2 * slots.size(), Slot{TrackingKey(), 0});
+      old.swap(slots);
+      for (const Slot& slot : old) {
+	if (!slot.key.Empty()) {
+	  Place(slot);
+	}
+      }
+    }
+
+    // Put slot in the first free place along its probe sequence.
+    void Place(const Slot& slot) noexcept {
+      std::size_t mask = slots.size() - 1;
+      std::size_t i = slot.key.Hash() & mask;
+      while (!slots[i].key.Empty()) {
+	i = (i + 1) & mask;
+      }
+      slots[i] = slot;
+    }
+
+    mutable std::shared_mutex mutex;
+    std::vector<PackageStatus> packages;
+    std::vector<Slot> slots;
+    // indexes of delivered packages that AddUpdate left decoded
+    std::vector<std::uint32_t> thawed;
+  };
+
+  PackageStore::Listener::~Listener() { }
+
+  PackageStore::PackageStore(unsigned shard_count, std::shared_ptr<StringPool> pool)
+  : shard_count_(ShardCount(shard_count)), pool_(std::move(pool)), reorder_window_(0),
+    freeze_delivered_(true) {
+    shards_.reset(new Shard[shard_count_]);
+  }
+
+  PackageStore::~PackageStore() { }
+
+  std::size_t PackageStore::Size() const {
+    std::size_t size = 0;
+    for (unsigned i = 0; i < shard_count_; i++) {
+      std::shared_lock<std::shared_mutex> lock(shards_[i].mutex);
+      size += shards_[i].packages.size();
+    }
+    return size;
+  }
+
+  void PackageStore::SetReorderWindow(std::time_t seconds) {
+    if (seconds < 0) {
+      throw std::invalid_argument("Reorder window is negative.");
+    }
+    reorder_window_ = seconds;
+  }
+
+  void PackageStore::SetFreezeDelivered(bool freeze) noexcept {
+    freeze_delivered_ = freeze;
+  }
+
+  void PackageStore::AddListener(Listener& listener) {
+    listeners_.push_back(&listener);
+  }
+
+  bool PackageStore::Upsert(PackageStatus package) {
+    TrackingKey key(package.TrackingNumber());
+    std::size_t hash = key.Hash();
+    Shard& shard = ShardFor(hash);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    long index = shard.Find(key, hash);
+    bool inserted = (index < 0);
+    if (inserted) {
+      index = shard.Insert(key, std::move(package));
+    } else {
+      for (Listener* listener : listeners_) {
+	listener->PackageRemoved(shard.packages[index]);
+      }
+      shard.packages[index] = std::move(package);
+    }
+    for (Listener* listener : listeners_) {
+      listener->PackageAdded(shard.packages[index]);
+    }
+    FreezeIfDelivered(shard.packages[index]);
+    return inserted;
+  }
+
+  void PackageStore::AddUpdate(std::string_view tracking_number,
+			       std::string_view description,
+			       std::string_view location,
+			       std::time_t timestamp) {
+    TrackingKey key(tracking_number);
+    std::size_t hash = key.Hash();
+    Shard& shard = ShardFor(hash);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    long index = shard.Find(key, hash);
+    if (index < 0) {
+      PackageStatus package(std::string(tracking_number), pool_);
+      package.SetReorderWindow(reorder_window_);
+      index = shard.Insert(key, std::move(package));
+      for (Listener* listener : listeners_) {
+	listener->PackageAdded(shard.packages[index]);
+      }
+    }
+    PackageStatus& package = shard.packages[index];
+    package.AddUpdate(description, location, timestamp);
+    if (!listeners_.empty()) {
+      // the new update is the last one with its timestamp
+      PackageStatus::UpdateRange same = package.UpdatesBetween(timestamp, timestamp);
+      int position = same.First() + same.Size() - 1;
+      for (Listener* listener : listeners_) {
+	listener->UpdateAdded(package, position);
+      }
+    }
+
+    // Late scans of a delivered package are common, and each would
+    // decode and encode its whole history again, so leave it decoded
+    // and freeze a batch of such packages at once.
+    if (freeze_delivered_ && package.Delivered()
+	&& (std::find(shard.thawed.begin(), shard.thawed.end(), index) == shard.thawed.end())) {
+      shard.thawed.push_back(index);
+      if (shard.thawed.size() >= Shard::kFreezeBatch) {
+	FreezeThawed(shard);
+      }
+    }
+  }
+
+  bool PackageStore::Find(std::string_view tracking_number,
+			  const std::function<void(const PackageStatus&)>& visitor) const {
+    TrackingKey key;
+    if (!TrackingKey::TryFind(tracking_number, key)) {
+      return false;
+    }
+    std::size_t hash = key.Hash();
+    Shard& shard = ShardFor(hash);
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    long index = shard.Find(key, hash);
+    if (index < 0) {
+      return false;
+    }
+    visitor(shard.packages[index]);
+    return true;
+  }
+
+  bool PackageStore::Modify(std::string_view tracking_number,
+			    const std::function<void(PackageStatus&)>& visitor) {
+    TrackingKey key;
+    if (!TrackingKey::TryFind(tracking_number, key)) {
+      return false;
+    }
+    std::size_t hash = key.Hash();
+    Shard& shard = ShardFor(hash);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    long index = shard.Find(key, hash);
+    if (index < 0) {
+      return false;
+    }
+    visitor(shard.packages[index]);
+    return true;
+  }
+
+  void PackageStore::ForEach(const std::function<void(const PackageStatus&)>& visitor) const {
+    for (unsigned i = 0; i < shard_count_; i++) {
+      std::shared_lock<std::shared_mutex> lock(shards_[i].mutex);
+      for (const PackageStatus& package : shards_[i].packages) {
+	visitor(package);
+      }
+    }
+  }
+
+  unsigned PackageStore::ShardCount(unsigned requested) noexcept {
+    unsigned count = 1;
+    while (count < requested) {
+      count *= 2;
+    }
+    return count;
+  }
+
+  unsigned PackageStore::ShardIndex(std::size_t hash, unsigned shard_count) noexcept {
+    // the top bits, which the slot index within a shard does not use
+    return (hash >> 32) & (shard_count - 1);
+  }
+
+  void PackageStore::FreezeDelivered() {
+    for (unsigned i = 0; i < shard_count_; i++) {
+      std::unique_lock<std::shared_mutex> lock(shards_[i].mutex);
+      FreezeThawed(shards_[i]);
+    }
+  }
+
+  void PackageStore::FreezeIfDelivered(PackageStatus& package) const {
+    if (freeze_delivered_ && !package.Frozen() && package.Delivered()) {
+      package.Freeze();
+    }
+  }
+
+  void PackageStore::FreezeThawed(Shard& shard) const {
+    for (std::uint32_t index : shard.thawed) {
+      FreezeIfDelivered(shard.packages[index]);
+    }
+    shard.thawed.clear();
+  }
+
+  PackageStore::Shard& PackageStore::ShardFor(std::size_t hash) const noexcept {
+    return shards_[ShardIndex(hash, shard_count_)];
+  }
+
+}
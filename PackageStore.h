@@ -0,0 +1,185 @@
+////////////////////////////////////////////////////////////////////////////////
+// PackageStore.h
+//
+// class PackageStore
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PACKAGE_STORE_H
+#define PACKAGE_STORE_H
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint32_t, std::uint64_t
+#include <ctime> // std::time_t
+#include <functional> // std::function
+#include <memory> // std::shared_ptr, std::unique_ptr
+#include <shared_mutex> // std::shared_mutex
+#include <stdexcept> // std::invalid_argument
+#include <string> // std::string
+#include <string_view> // std::string_view
+#include <vector> // std::vector
+
+#include "PackageStatus.h"
+#include "StringPool.h"
+#include "TrackingKey.h"
+
+namespace PackageTracking {
+
+  // A PackageStore holds many PackageStatus objects, keyed by
+  // tracking number, and may be used from many threads at once.
+  //
+  // Packages are keyed by the TrackingKey packed from their tracking
+  // number, so tracking numbers must be 1 to 40 of the characters 0-9,
+  // A-Z and a-z. Packages are split across shards by the key's hash,
+  // and each shard has its own reader-writer lock, so threads
+  // working on packages in different shards never wait for each
+  // other. Within a shard, packages are kept in one dense vector, and
+  // found through an open-addressing hash table of small slots, which
+  // keeps the per-package overhead low enough for tens of millions of
+  // packages.
+  //
+  // Delivered packages are kept long but rarely read, so by default
+  // the store freezes a package (see PackageStatus::Freeze) once its
+  // newest update is a delivery; see SetFreezeDelivered.
+  //
+  // The visitor functions below are called with their shard locked,
+  // so they must not call back into the same store. Const reads of a
+  // frozen package decode its updates on demand, without thawing it,
+  // so visitors given one under a shared lock leave it frozen.
+  class PackageStore {
+  public:
+
+    // A Listener is told about every change made through Upsert and
+    // AddUpdate, so that secondary indexes can be kept up to date
+    // incrementally. Its functions are called with the package's
+    // shard locked, so calls about one package are serialized, but
+    // calls about packages in different shards may come from several
+    // threads at once. They must not call back into the store.
+    //
+    // Changes made through Modify are not reported.
+    class Listener {
+    public:
+      virtual ~Listener();
+
+      // package, with all of its updates, has been added to the store.
+      virtual void PackageAdded(const PackageStatus& package) = 0;
+
+      // package is about to be replaced by Upsert.
+      virtual void PackageRemoved(const PackageStatus& package) = 0;
+
+      // An update has been added to package at index position. If it
+      // was a late update (see PackageStatus::AddUpdate), the updates
+      // after it have each moved one index forward.
+      virtual void UpdateAdded(const PackageStatus& package, int position) = 0;
+    };
+
+    // Initialize an empty store with at least the given number of
+    // shards (rounded up to a power of two). Packages created by
+    // AddUpdate intern their strings into pool.
+    PackageStore(unsigned shard_count = 64,
+		 std::shared_ptr<StringPool> pool = StringPool::Default());
+
+    ~PackageStore();
+
+    PackageStore(const PackageStore&) = delete;
+    PackageStore& operator=(const PackageStore&) = delete;
+
+    // Total number of packages.
+    std::size_t Size() const;
+
+    // Packages created by AddUpdate get this reorder window; see
+    // PackageStatus::SetReorderWindow. It is 0 by default.
+    //
+    // Throws std::invalid_argument if seconds is negative.
+    void SetReorderWindow(std::time_t seconds);
+
+    // Whether the store freezes a package whose newest update is a
+    // delivery (see PackageStatus::Delivered). It is on by default.
+    // Like AddListener, this must be set before the store is shared
+    // between threads.
+    //
+    // Upsert freezes such a package at once. AddUpdate, which has to
+    // decode a frozen package to add to it, instead leaves a delivered
+    // package decoded until 64 of them have gathered in its shard, and
+    // then freezes them together, so that a run of late updates to one
+    // delivered package decodes and encodes its history once rather
+    // than once each.
+    void SetFreezeDelivered(bool freeze) noexcept;
+
+    // Freeze every delivered package AddUpdate has left decoded now,
+    // rather than with the rest of its shard's batch.
+    void FreezeDelivered();
+
+    // Register listener, which must outlive the store, to be told
+    // about every later change. Listeners must be added before the
+    // store is shared between threads.
+    void AddListener(Listener& listener);
+
+    // Insert package, replacing any package with the same tracking
+    // number. Returns true if the tracking number was new.
+    //
+    // Throws std::invalid_argument if the tracking number cannot be
+    // packed into a TrackingKey.
+    bool Upsert(PackageStatus package);
+
+    // Add an update to the package with the given tracking number,
+    // following the rules of PackageStatus::AddUpdate. If there is no
+    // such package, an empty one is created first.
+    //
+    // Throws std::invalid_argument if the tracking number cannot be
+    // packed into a TrackingKey, or the given timestamp is invalid.
+    void AddUpdate(std::string_view tracking_number,
+		   std::string_view description,
+		   std::string_view location,
+		   std::time_t timestamp);
+
+    // If there is a package with the given tracking number, call
+    // visitor with it under a shared lock and return true; otherwise
+    // return false.
+    bool Find(std::string_view tracking_number,
+	      const std::function<void(const PackageStatus&)>& visitor) const;
+
+    // If there is a package with the given tracking number, call
+    // visitor with it under an exclusive lock, so it may move the
+    // cursor or call Describe functions, and return true; otherwise
+    // return false.
+    bool Modify(std::string_view tracking_number,
+		const std::function<void(PackageStatus&)>& visitor);
+
+    // Call visitor with every package, one shard at a time, each under
+    // a shared lock. Packages added or replaced during the call may or
+    // may not be visited.
+    void ForEach(const std::function<void(const PackageStatus&)>& visitor) const;
+
+    // The number of shards a store asked for requested shards has, and
+    // the shard, of shard_count, that a key with the given hash belongs
+    // to. Listeners that shard their own state the same way, with the
+    // store's shard count, lock only what one shard of the store
+    // covers, so they add no contention between shards.
+    static unsigned ShardCount(unsigned requested) noexcept;
+    static unsigned ShardIndex(std::size_t hash, unsigned shard_count) noexcept;
+
+  private:
+    struct Shard;
+
+    // Return the shard a key's hash belongs to.
+    Shard& ShardFor(std::size_t hash) const noexcept;
+
+    // Freeze package if it is delivered and freeze_delivered_ is set.
+    // The caller must hold its shard exclusively.
+    void FreezeIfDelivered(PackageStatus& package) const;
+
+    // Freeze the packages in shard that AddUpdate left decoded. The
+    // caller must hold shard exclusively.
+    void FreezeThawed(Shard& shard) const;
+
+    std::unique_ptr<Shard[]> shards_;
+    unsigned shard_count_;
+    std::shared_ptr<StringPool> pool_;
+    std::time_t reorder_window_;
+    bool freeze_delivered_;
+    std::vector<Listener*> listeners_;
+  };
+
+}
+
+#endif
@@ -0,0 +1,191 @@
+////////////////////////////////////////////////////////////////////////////////
+// PackageView.cpp
+//
+// class PackageView
+////////////////////////////////////////////////////////////////////////////////
+
+#include "PackageView.h"
+
+#include <deque> // std::deque
+
+#include "MappedFile.h"
+#include "PackageScanner.h"
+
+namespace PackageTracking {
+
+  struct PackageView::Backing {
+    Backing(const std::string& path)
+    : file(path) { }
+
+    MappedFile file;
+    // a deque never moves its elements, so views into them stay valid
+    std::deque<std::string> unescaped;
+  };
+
+  namespace {
+
+    // Fills in the columns of a PackageView as its file is scanned.
+    class ViewBuilder : public PackageScanner::Visitor {
+    public:
+      ViewBuilder(const PackageScanner& scanner,
+		  std::deque<std::string>& unescaped,
+		  std::string_view& tracking_number,
+		  std::vector<std::time_t>& timestamps,
+		  std::vector<std::string_view>& descriptions,
+		  std::vector<std::string_view>& locations)
+      : scanner_(scanner), unescaped_(unescaped), tracking_number_(tracking_number),
+	timestamps_(timestamps), descriptions_(descriptions), locations_(locations) { }
+
+      void OnTrackingNumber(std::string_view tracking_number) override {
+	tracking_number_ = Keep(tracking_number);
+      }
+
+      void OnUpdate(std::string_view description,
+		    std::string_view location,
+		    std::time_t timestamp) override {
+	if (!timestamps_.empty() && (timestamp < timestamps_.back())) {
+	  throw std::invalid_argument("Given timestamp is invalid.");
+	}
+	timestamps_.push_back(timestamp);
+	descriptions_.push_back(Keep(description));
+	locations_.push_back(Keep(location));
+      }
+
+    private:
+      // Return a view of text that outlives the scanner.
+      std::string_view Keep(std::string_view text) {
+	if (scanner_.InText(text)) {
+	  return text;
+	}
+	unescaped_.emplace_back(text);
+	return unescaped_.back();
+      }
+
+      const PackageScanner& scanner_;
+      std::deque<std::string>& unescaped_;
+      std::string_view& tracking_number_;
+      std::vector<std::time_t>& timestamps_;
+      std::vector<std::string_view>& descriptions_;
+      std::vector<std::string_view>& locations_;
+    };
+
+  }
+
+  PackageView::PackageView() noexcept { }
+
+  std::string_view PackageView::TrackingNumber() const noexcept {
+    return tracking_number_;
+  }
+
+  int PackageView::Size() const noexcept {
+    return timestamps_.size();
+  }
+
+  bool PackageView::Empty() const noexcept {
+    return timestamps_.empty();
+  }
+
+  PackageView::Update PackageView::GetCursor() const {
+    Range range = CursorRange();
+    return Update{descriptions_[range.first], locations_[range.first], timestamps_[range.first]};
+  }
+
+  std::string PackageView::DescribeCursorUpdate() const {
+    std::string cursor_update;
+    DescribeCursorUpdate(cursor_update);
+    return cursor_update;
+  }
+
+  void PackageView::DescribeCursorUpdate(std::string& buffer) const {
+    DescribeRange(CursorRange(), buffer);
+  }
+
+  void PackageView::DescribeCursorUpdate(std::ostream& out) const {
+    DescribeRange(CursorRange(), out);
+  }
+
+  void PackageView::DescribeCursorUpdate(const DescribeSink& sink) const {
+    DescribeRange(CursorRange(), sink);
+  }
+
+  std::string PackageView::DescribePreviousUpdates() const {
+    std::string previous_updates;
+    DescribePreviousUpdates(previous_updates);
+    return previous_updates;
+  }
+
+  void PackageView::DescribePreviousUpdates(std::string& buffer) const {
+    DescribeRange(PreviousRange(), buffer);
+  }
+
+  void PackageView::DescribePreviousUpdates(std::ostream& out) const {
+    DescribeRange(PreviousRange(), out);
+  }
+
+  void PackageView::DescribePreviousUpdates(const DescribeSink& sink) const {
+    DescribeRange(PreviousRange(), sink);
+  }
+
+  std::string PackageView::DescribeFollowingUpdates() const {
+    std::string following_updates;
+    DescribeFollowingUpdates(following_updates);
+    return following_updates;
+  }
+
+  void PackageView::DescribeFollowingUpdates(std::string& buffer) const {
+    DescribeRange(FollowingRange(), buffer);
+  }
+
+  void PackageView::DescribeFollowingUpdates(std::ostream& out) const {
+    DescribeRange(FollowingRange(), out);
+  }
+
+  void PackageView::DescribeFollowingUpdates(const DescribeSink& sink) const {
+    DescribeRange(FollowingRange(), sink);
+  }
+
+  std::string PackageView::DescribeAllUpdates() const {
+    std::string all_updates;
+    DescribeAllUpdates(all_updates);
+    return all_updates;
+  }
+
+  void PackageView::DescribeAllUpdates(std::string& buffer) const {
+    DescribeRange(AllRange(), buffer);
+  }
+
+  void PackageView::DescribeAllUpdates(std::ostream& out) const {
+    DescribeRange(AllRange(), out);
+  }
+
+  void PackageView::DescribeAllUpdates(const DescribeSink& sink) const {
+    DescribeRange(AllRange(), sink);
+  }
+
+  template <typename Destination>
+  void PackageView::DescribeRange(Range range, Destination& out) const {
+    for (int i = range.first; i < range.last; i++) {
+      WriteDescription(timestamps_[i], descriptions_[i], locations_[i], out);
+    }
+  }
+
+  void PackageView::RequireNotEmpty() const {
+    if (timestamps_.empty()) {
+      throw std::logic_error("PackageView is empty.");
+    }
+  }
+
+  PackageView PackageViewFromJSON(const std::string& path) {
+    auto backing = std::make_shared<PackageView::Backing>(path);
+
+    PackageView result;
+    PackageScanner scanner(backing->file.Text());
+    ViewBuilder builder(scanner, backing->unescaped, result.tracking_number_,
+			result.timestamps_, result.descriptions_, result.locations_);
+    scanner.ScanPackage(builder);
+
+    result.backing_ = std::move(backing);
+    return result;
+  }
+
+}
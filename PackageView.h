@@ -0,0 +1,115 @@
+////////////////////////////////////////////////////////////////////////////////
+// PackageView.h
+//
+// class PackageView
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PACKAGE_VIEW_H
+#define PACKAGE_VIEW_H
+
+#include <ctime> // std::time_t
+#include <memory> // std::shared_ptr
+#include <ostream> // std::ostream
+#include <stdexcept> // std::invalid_argument, std::logic_error
+#include <string> // std::string
+#include <string_view> // std::string_view
+#include <vector> // std::vector
+
+#include "ShippingUpdate.h"
+#include "UpdateCursor.h"
+
+namespace PackageTracking {
+
+  // A PackageView is a read-only PackageStatus loaded straight from a
+  // memory-mapped JSON file. Descriptions, locations, and the tracking
+  // number are views into the mapping wherever no JSON unescaping was
+  // needed, so loading copies almost no text.
+  //
+  // The mapping is shared by all copies of a PackageView and unmapped
+  // when the last one is destroyed. The file must not be truncated
+  // while it is mapped; see MappedFile.
+  //
+  // A PackageView has the same cursor as PackageStatus, and its
+  // Describe functions produce the same text. None of them modify the
+  // view, so they are all const.
+  class PackageView : private UpdateCursor<PackageView> {
+  public:
+
+    // One update, as views into the mapping.
+    struct Update {
+      std::string_view description, location;
+      std::time_t timestamp;
+    };
+
+    // Default constructor: an empty tracking number and no updates.
+    PackageView() noexcept;
+
+    // Accessors
+    std::string_view TrackingNumber() const noexcept;
+    int Size() const noexcept;
+    bool Empty() const noexcept;
+
+    // Cursor motion, with the same meaning as in PackageStatus.
+    using UpdateCursor::MoveCursorBackward;
+    using UpdateCursor::MoveCursorForward;
+    using UpdateCursor::SeekCursor;
+    using UpdateCursor::MoveCursor;
+
+    // Return the update the cursor is pointing at.
+    //
+    // If the PackageView is empty, throws std::logic_error.
+    Update GetCursor() const;
+
+    // Describe updates, with the same meaning as in PackageStatus. The
+    // std::string overloads append to buffer, and the DescribeSink
+    // overloads pass each update's text to sink in pieces.
+    //
+    // Except for DescribeAllUpdates, if the PackageView is empty,
+    // throws std::logic_error.
+    std::string DescribeCursorUpdate() const;
+    void DescribeCursorUpdate(std::string& buffer) const;
+    void DescribeCursorUpdate(std::ostream& out) const;
+    void DescribeCursorUpdate(const DescribeSink& sink) const;
+    std::string DescribePreviousUpdates() const;
+    void DescribePreviousUpdates(std::string& buffer) const;
+    void DescribePreviousUpdates(std::ostream& out) const;
+    void DescribePreviousUpdates(const DescribeSink& sink) const;
+    std::string DescribeFollowingUpdates() const;
+    void DescribeFollowingUpdates(std::string& buffer) const;
+    void DescribeFollowingUpdates(std::ostream& out) const;
+    void DescribeFollowingUpdates(const DescribeSink& sink) const;
+    std::string DescribeAllUpdates() const;
+    void DescribeAllUpdates(std::string& buffer) const;
+    void DescribeAllUpdates(std::ostream& out) const;
+    void DescribeAllUpdates(const DescribeSink& sink) const;
+
+  private:
+    friend class UpdateCursor<PackageView>;
+    friend PackageView PackageViewFromJSON(const std::string& path);
+
+    // The mapping, and copies of any strings that had to be unescaped.
+    struct Backing;
+
+    // Write the descriptions of the updates in range to out, which is
+    // a std::string, a std::ostream, or a const DescribeSink.
+    template <typename Destination>
+    void DescribeRange(Range range, Destination& out) const;
+
+    // Throw std::logic_error if there are no updates.
+    void RequireNotEmpty() const;
+
+    std::shared_ptr<const Backing> backing_;
+    std::string_view tracking_number_;
+    std::vector<std::time_t> timestamps_;
+    std::vector<std::string_view> descriptions_, locations_;
+  };
+
+  // Map the JSON file at path, in the format read by
+  // PackageStatusFromJSON, and return a PackageView of it.
+  //
+  // throws std::invalid_argument if the file cannot be loaded
+  PackageView PackageViewFromJSON(const std::string& path);
+
+}
+
+#endif
@@ -0,0 +1,300 @@
+////////////////////////////////////////////////////////////////////////////////
+// PackageWatcher.cpp
+//
+// class PackageWatcher
+////////////////////////////////////////////////////////////////////////////////
+
+#include "PackageWatcher.h"
+
+#include <algorithm> // std::min
+#include <cerrno> // errno, EINTR
+#include <cstdint> // std::uint64_t
+#include <ctime> // std::time_t
+#include <string_view> // std::string_view
+#include <vector> // std::vector
+
+#include <fcntl.h> // open, O_RDONLY, O_CLOEXEC
+#include <poll.h> // poll
+#include <sys/inotify.h> // inotify_init1, inotify_add_watch, inotify_event
+#include <sys/stat.h> // fstat
+#include <unistd.h> // pread, read, close
+
+#include "PackageScanner.h"
+#include "Stats.h"
+
+namespace PackageTracking {
+
+  namespace {
+
+    // Bytes of text just before the resume point whose checksum is
+    // kept, to tell an append from a rewrite.
+    constexpr std::size_t kAnchorSize = 4096;
+
+    // The 64-bit FNV-1a checksum of text.
+    std::uint64_t Checksum(std::string_view text) {
+      std::uint64_t checksum = 14695981039346656037ull;
+      for (unsigned char c : text) {
+	checksum = (checksum ^ c) * 1099511628211ull;
+      }
+      return checksum;
+    }
+
+    // An open file, closed when destroyed.
+    class File {
+    public:
+      // Throws std::invalid_argument if path cannot be opened.
+      File(const std::string& path)
+      : fd_(open(path.c_str(), O_RDONLY | O_CLOEXEC)), path_(path) {
+	if (fd_ < 0) {
+	  Fail("could not open");
+	}
+      }
+
+      ~File() {
+	close(fd_);
+      }
+
+      File(const File&) = delete;
+      File& operator=(const File&) = delete;
+
+      struct stat Info() const {
+	struct stat info;
+	if (fstat(fd_, &info) != 0) {
+	  Fail("could not read");
+	}
+	return info;
+      }
+
+      // Replace the contents of buffer with up to size bytes starting
+      // at offset, fewer if the file ends first.
+      void Read(std::size_t offset, std::size_t size, std::string& buffer) const {
+	buffer.resize(size);
+	std::size_t done = 0;
+	while (done < size) {
+	  ssize_t count = pread(fd_, &buffer[done], size - done, offset + done);
+	  if (count < 0) {
+	    if (errno == EINTR) {
+	      continue;
+	    }
+	    Fail("could not read");
+	  }
+	  if (count == 0) {
+	    break;
+	  }
+	  done += count;
+	}
+	buffer.resize(done);
+      }
+
+    private:
+      [[noreturn]] void Fail(const char* what) const {
+	throw std::invalid_argument(std::string(what) + " \"" + path_ + "\"");
+      }
+
+      int fd_;
+      const std::string& path_;
+    };
+
+    // Collects what a scan finds, interning the strings into pool as
+    // it goes, since the scanner may reuse them.
+    class Collector : public PackageScanner::Visitor {
+    public:
+      Collector(StringPool& pool)
+      : pool_(pool) { }
+
+      void OnTrackingNumber(std::string_view tracking_number) override {
+	tracking_number_ = tracking_number;
+	seen_tracking_number_ = true;
+      }
+
+      void OnUpdate(std::string_view description,
+		    std::string_view location,
+		    std::time_t timestamp) override {
+	updates_.emplace_back(pool_, pool_.Intern(description), pool_.Intern(location), timestamp);
+      }
+
+      StringPool& pool_;
+      bool seen_tracking_number_ = false;
+      std::string tracking_number_;
+      std::vector<ShippingUpdate> updates_;
+    };
+
+    // Builds a PackageStatus as a scan goes.
+    class StatusBuilder : public PackageScanner::Visitor {
+    public:
+      StatusBuilder(PackageStatus& status)
+      : status_(status) { }
+
+      void OnTrackingNumber(std::string_view tracking_number) override {
+	status_.SetTrackingNumber(std::string(tracking_number));
+      }
+
+      void OnUpdate(std::string_view description,
+		    std::string_view location,
+		    std::time_t timestamp) override {
+	status_.AddUpdate(description, location, timestamp);
+      }
+
+    private:
+      PackageStatus& status_;
+    };
+
+  }
+
+  PackageWatcher::PackageWatcher(const std::string& path, std::shared_ptr<StringPool> pool)
+  : path_(path), pool_(std::move(pool)), status_(std::string(), pool_),
+    inotify_(-1), loads_(0), updates_end_(std::string_view::npos), anchor_checksum_(0),
+    device_(0), inode_(0), size_(0) {
+
+    std::size_t slash = path_.find_last_of('/');
+    std::string directory = (slash == std::string::npos) ? "." : path_.substr(0, slash + 1);
+    name_ = (slash == std::string::npos) ? path_ : path_.substr(slash + 1);
+
+    Load();
+
+    inotify_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if ((inotify_ < 0)
+	|| (inotify_add_watch(inotify_, directory.c_str(),
+			      IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO) < 0)) {
+      if (inotify_ >= 0) {
+	close(inotify_);
+      }
+      throw std::invalid_argument("could not watch \"" + path_ + "\"");
+    }
+  }
+
+  PackageWatcher::~PackageWatcher() {
+    close(inotify_);
+  }
+
+  const std::string& PackageWatcher::Path() const noexcept {
+    return path_;
+  }
+
+  PackageStatus& PackageWatcher::Status() noexcept {
+    return status_;
+  }
+
+  const PackageStatus& PackageWatcher::Status() const noexcept {
+    return status_;
+  }
+
+  std::size_t PackageWatcher::Loads() const noexcept {
+    return loads_;
+  }
+
+  PackageWatcher::Change PackageWatcher::Refresh() {
+    TRACK_SPAN("PackageWatcher::Refresh");
+    Change change;
+    if ((updates_end_ != std::string_view::npos) && Resume(change)) {
+      return change;
+    }
+    Load();
+    return Change::Reloaded;
+  }
+
+  PackageWatcher::Change PackageWatcher::Wait(int timeout_milliseconds) {
+    pollfd ready{inotify_, POLLIN, 0};
+    int count;
+    do {
+      count = poll(&ready, 1, timeout_milliseconds);
+    } while ((count < 0) && (errno == EINTR));
+    if (count <= 0) {
+      return Change::None;
+    }
+
+    // drain the events, looking for one about the file
+    alignas(inotify_event) char events[4096];
+    bool changed = false;
+    ssize_t size;
+    while ((size = read(inotify_, events, sizeof(events))) > 0) {
+      for (ssize_t i = 0; i < size; ) {
+	const inotify_event* event = reinterpret_cast<const inotify_event*>(events + i);
+	// if the queue overflowed, events about the file may be lost
+	if ((event->mask & IN_Q_OVERFLOW)
+	    || ((event->len > 0) && (name_ == event->name))) {
+	  changed = true;
+	}
+	i += sizeof(inotify_event) + event->len;
+      }
+    }
+    return changed ? Refresh() : Change::None;
+  }
+
+  void PackageWatcher::Load() {
+    File file(path_);
+    struct stat info = file.Info();
+    std::string text;
+    file.Read(0, info.st_size, text);
+
+    PackageStatus status(std::string(), pool_);
+    status.SetReorderWindow(status_.ReorderWindow());
+    StatusBuilder builder(status);
+    PackageScanner scanner(text);
+    scanner.ScanPackage(builder);
+
+    // keep the cursor at the same point in time
+    if (!status_.Empty() && !status.Empty()) {
+      status.SeekCursorToTime(status_.GetCursor().Timestamp());
+    }
+    status_ = std::move(status);
+    updates_end_ = scanner.UpdatesEnd();
+    loads_++;
+    if (updates_end_ != std::string_view::npos) {
+      SetAnchor(text, 0, info);
+    }
+  }
+
+  bool PackageWatcher::Resume(Change& change) {
+    File file(path_);
+    struct stat info = file.Info();
+    if ((info.st_dev != device_) || (info.st_ino != inode_)
+	|| (static_cast<std::size_t>(info.st_size) < size_)) {
+      return false;
+    }
+
+    // read only from just before the resume point, so the text there
+    // can be checked, and scan what follows it
+    std::size_t base = updates_end_ - std::min(kAnchorSize, updates_end_);
+    std::string text;
+    file.Read(base, info.st_size - base, text);
+    if ((text.size() < updates_end_ - base)
+	|| (Checksum(std::string_view(text).substr(0, updates_end_ - base)) != anchor_checksum_)) {
+      return false;
+    }
+
+    Collector collector(*pool_);
+    PackageScanner scanner(text);
+    try {
+      scanner.ResumePackage(updates_end_ - base, collector);
+    } catch (std::invalid_argument&) {
+      return false;
+    }
+    if (collector.seen_tracking_number_
+	&& (collector.tracking_number_ != status_.TrackingNumber())) {
+      return false;
+    }
+
+    // all or nothing, so a late update leaves the status as it was
+    try {
+      status_.AddUpdates(collector.updates_);
+    } catch (std::invalid_argument&) {
+      return false;
+    }
+
+    updates_end_ = base + scanner.UpdatesEnd();
+    SetAnchor(text, base, info);
+    change = collector.updates_.empty() ? Change::None : Change::Appended;
+    return true;
+  }
+
+  void PackageWatcher::SetAnchor(const std::string& text, std::size_t base,
+				 const struct stat& info) {
+    std::size_t size = std::min(kAnchorSize, updates_end_);
+    anchor_checksum_ = Checksum(std::string_view(text).substr(updates_end_ - size - base, size));
+    device_ = info.st_dev;
+    inode_ = info.st_ino;
+    size_ = info.st_size;
+  }
+
+}
@@ -0,0 +1,125 @@
+////////////////////////////////////////////////////////////////////////////////
+// PackageWatcher.h
+//
+// class PackageWatcher
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PACKAGE_WATCHER_H
+#define PACKAGE_WATCHER_H
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <memory> // std::shared_ptr
+#include <stdexcept> // std::invalid_argument
+#include <string> // std::string
+
+#include <sys/stat.h> // struct stat, dev_t, ino_t
+
+#include "PackageStatus.h"
+#include "StringPool.h"
+
+namespace PackageTracking {
+
+  // A PackageWatcher keeps a PackageStatus up to date with a live
+  // package file, in the format read by PackageStatusFromJSON, as
+  // updates are appended to it.
+  //
+  // When the file has only grown by updates at the end of its updates
+  // array, scanning resumes just past the last update already seen,
+  // and only the text from there on is read and the new updates added
+  // with PackageStatus::AddUpdates, so a refresh costs time
+  // proportional to what was appended rather than to the whole
+  // history. The cursor and the render cache are kept.
+  //
+  // The file counts as appended to if it is the same file (device and
+  // inode) as before, it is no shorter, and the few kilobytes just
+  // before the resume point have the same checksum as before. This is
+  // a cheap test, not a proof: an edit further back that keeps the
+  // file's size is not noticed. Otherwise, for instance if the file
+  // was replaced by rename, or if the new updates cannot be added,
+  // the file is loaded again from scratch, and the cursor is moved to
+  // the first update at or after its old timestamp.
+  //
+  // Changes are noticed with inotify(7), watching the file's
+  // directory so that a replacement is seen as well as a write.
+  class PackageWatcher {
+  public:
+
+    // What a refresh did.
+    enum class Change { None, Appended, Reloaded };
+
+    // Load the file at path, interning its strings into pool, and
+    // start watching it.
+    //
+    // Throws std::invalid_argument with the same messages as
+    // PackageStatusFromJSON if the file cannot be loaded, with the
+    // message "could not read "<PATH>"" if reading it fails, or if its
+    // directory cannot be watched.
+    PackageWatcher(const std::string& path,
+		   std::shared_ptr<StringPool> pool = StringPool::Default());
+
+    ~PackageWatcher();
+
+    PackageWatcher(const PackageWatcher&) = delete;
+    PackageWatcher& operator=(const PackageWatcher&) = delete;
+
+    // Accessors
+    const std::string& Path() const noexcept;
+    PackageStatus& Status() noexcept;
+    const PackageStatus& Status() const noexcept;
+
+    // Number of times the file has been loaded from scratch, including
+    // the first.
+    std::size_t Loads() const noexcept;
+
+    // Bring Status() up to date with the file, whether or not inotify
+    // has reported a change.
+    //
+    // Throws std::invalid_argument as the constructor does if the file
+    // cannot be loaded, for instance because it is half written;
+    // Status() is then left as it was, and a later refresh tries
+    // again.
+    Change Refresh();
+
+    // Wait up to timeout_milliseconds, or for ever if it is negative,
+    // for inotify to report a change to the file, then Refresh.
+    // Returns Change::None if the wait timed out, or only other files
+    // in the directory changed. If inotify's queue overflowed, the
+    // file is refreshed in case its event was lost.
+    //
+    // Throws std::invalid_argument as Refresh does.
+    Change Wait(int timeout_milliseconds = -1);
+
+  private:
+    // Load the file from scratch.
+    void Load();
+
+    // Add the updates appended since the last refresh. Returns false,
+    // changing nothing, if the file was changed in some other way.
+    bool Resume(Change& change);
+
+    // Remember the checksum of the text just before updates_end_, from
+    // text, which starts at offset base in the file, and what info
+    // says about the file.
+    void SetAnchor(const std::string& text, std::size_t base, const struct stat& info);
+
+    std::string path_, name_;
+    std::shared_ptr<StringPool> pool_;
+    PackageStatus status_;
+    int inotify_;
+    std::size_t loads_;
+
+    // Offset in the file just past the last update, as given by
+    // PackageScanner::UpdatesEnd, the checksum of the text just before
+    // that offset, and the file's identity and size when it was last
+    // read.
+    std::size_t updates_end_;
+    std::uint64_t anchor_checksum_;
+    dev_t device_;
+    ino_t inode_;
+    std::size_t size_;
+  };
+
+}
+
+#endif
@@ -0,0 +1,135 @@
+////////////////////////////////////////////////////////////////////////////////
+// Query.cpp
+//
+// Queries that select updates of one package file, as typed on the
+// track command line or sent to a query server.
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Query.h"
+
+#include <exception> // std::exception
+
+#include "Stats.h"
+
+namespace PackageTracking {
+
+  namespace {
+
+    // Remove and return the last whitespace-separated word of text.
+    std::string_view PopWord(std::string_view& text) {
+      std::size_t end = text.find_last_not_of(" \t\r");
+      if (end == std::string_view::npos) {
+	text = std::string_view();
+	return text;
+      }
+      std::size_t start = text.find_last_of(" \t", end);
+      start = (start == std::string_view::npos) ? 0 : start + 1;
+      std::string_view word = text.substr(start, end + 1 - start);
+      text = text.substr(0, start);
+      return word;
+    }
+
+    template <typename Destination>
+    bool Describe(PackageStatus& status, How how, int index, Destination& out) {
+      TRACK_SPAN("DescribeSelection");
+      if ((index < 0) || (index >= status.Size())) {
+	return false;
+      }
+      status.SeekCursor(index);
+      switch (how) {
+      case How::Previous:
+	status.DescribePreviousUpdates(out);
+	break;
+      case How::Following:
+	status.DescribeFollowingUpdates(out);
+	break;
+      case How::All:
+	status.DescribeAllUpdates(out);
+	break;
+      }
+      return true;
+    }
+
+  }
+
+  bool ParseHow(std::string_view text, How& how) {
+    if (text == "previous") {
+      how = How::Previous;
+    } else if (text == "following") {
+      how = How::Following;
+    } else if (text == "all") {
+      how = How::All;
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  bool ParseIndex(std::string_view text, int& index) {
+    try {
+      index = std::stoi(std::string(text));
+    } catch (std::exception& e) {
+      return false;
+    }
+    return true;
+  }
+
+  bool ParseTime(std::string_view text, std::time_t& t) {
+    try {
+      std::size_t used;
+      t = std::stoll(std::string(text), &used);
+      return used == text.size();
+    } catch (std::exception& e) {
+      return false;
+    }
+  }
+
+  bool ParseQuery(std::string_view line, Query& query, std::string& error) {
+    std::string_view second = PopWord(line),
+      first = PopWord(line);
+
+    // "<FILENAME> between <T0> <T1>" has one more word than a selection
+    std::string_view rest = line;
+    if ((PopWord(rest) == "between") && ParseTime(first, query.t0) && ParseTime(second, query.t1)) {
+      query.kind = Query::Kind::Between;
+      line = rest;
+    } else {
+      query.kind = Query::Kind::Select;
+      if (!first.empty() && !ParseHow(first, query.how)) {
+	error = "invalid <HOW> \"" + std::string(first) + "\"";
+	return false;
+      }
+      if (!second.empty() && !ParseIndex(second, query.index)) {
+	error = "invalid index";
+	return false;
+      }
+    }
+
+    // the filename is what is left, trimmed
+    std::size_t path_start = line.find_first_not_of(" \t"),
+      path_end = line.find_last_not_of(" \t");
+    if (first.empty() || (path_start == std::string_view::npos)) {
+      error = "expected <FILENAME> <HOW> <INDEX> or <FILENAME> between <T0> <T1>";
+      return false;
+    }
+    query.path = std::string(line.substr(path_start, path_end + 1 - path_start));
+    return true;
+  }
+
+  bool DescribeSelection(PackageStatus& status, How how, int index, std::string& buffer) {
+    return Describe(status, how, index, buffer);
+  }
+
+  bool DescribeSelection(PackageStatus& status, How how, int index, std::ostream& out) {
+    return Describe(status, how, index, out);
+  }
+
+  bool DescribeQuery(PackageStatus& status, const Query& query, std::string& buffer) {
+    if (query.kind == Query::Kind::Between) {
+      status.DescribeUpdatesBetween(query.t0, query.t1, buffer);
+      return true;
+    }
+    return DescribeSelection(status, query.how, query.index, buffer);
+  }
+
+}
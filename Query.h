@@ -0,0 +1,71 @@
+////////////////////////////////////////////////////////////////////////////////
+// Query.h
+//
+// Queries that select updates of one package file, as typed on the
+// track command line or sent to a query server.
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <ctime> // std::time_t
+#include <ostream> // std::ostream
+#include <string> // std::string
+#include <string_view> // std::string_view
+
+#include "PackageStatus.h"
+
+namespace PackageTracking {
+
+  // Methods of selecting updates relative to an index.
+  enum class How { Previous, Following, All };
+
+  // One query: either the updates selected by how and index, or the
+  // updates with timestamps between t0 and t1, inclusive, of the
+  // package in the file at path.
+  struct Query {
+    enum class Kind { Select, Between };
+
+    std::string path;
+    Kind kind = Kind::Select;
+    How how = How::All;
+    int index = 0;
+    std::time_t t0 = 0, t1 = 0;
+  };
+
+  // Decode a <HOW> argument: "previous", "following" or "all".
+  // Returns false if it is invalid.
+  bool ParseHow(std::string_view text, How& how);
+
+  // Decode an <INDEX> argument, as std::stoi does. Returns false if it
+  // is not a number.
+  bool ParseIndex(std::string_view text, int& index);
+
+  // Decode a <T0> or <T1> argument. Returns false if it is not a
+  // number.
+  bool ParseTime(std::string_view text, std::time_t& t);
+
+  // Decode a query written on one line as
+  //
+  //   <FILENAME> <HOW> <INDEX>
+  //   <FILENAME> between <T0> <T1>
+  //
+  // with arguments separated by whitespace. The filename is
+  // everything before the last two arguments, so it may contain
+  // spaces. Returns false, and sets error to a message, if the line
+  // is malformed.
+  bool ParseQuery(std::string_view line, Query& query, std::string& error);
+
+  // Write the updates of status selected by how and index, in the
+  // format of PackageStatus::DescribeAllUpdates, moving the cursor to
+  // index. Returns false, writing nothing, if index is out of range.
+  bool DescribeSelection(PackageStatus& status, How how, int index, std::string& buffer);
+  bool DescribeSelection(PackageStatus& status, How how, int index, std::ostream& out);
+
+  // Write the answer to query about status. Returns false, writing
+  // nothing, if a selection's index is out of range.
+  bool DescribeQuery(PackageStatus& status, const Query& query, std::string& buffer);
+
+}
+
+#endif
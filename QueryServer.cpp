@@ -0,0 +1,363 @@
+////////////////////////////////////////////////////////////////////////////////
+// QueryServer.cpp
+//
+// class QueryServer
+////////////////////////////////////////////////////////////////////////////////
+
+#include "QueryServer.h"
+
+#include <cerrno> // errno, EINTR, EAGAIN, EWOULDBLOCK, ENOENT
+#include <cstring> // std::memcpy
+#include <deque> // std::deque
+#include <memory> // std::shared_ptr, std::make_shared
+#include <string_view> // std::string_view
+#include <vector> // std::vector
+
+#include <fcntl.h> // O_NONBLOCK, O_CLOEXEC
+#include <poll.h> // poll
+#include <sys/socket.h> // socket, bind, listen, accept4, send, recv, shutdown
+#include <sys/stat.h> // lstat, S_ISSOCK
+#include <sys/un.h> // sockaddr_un
+#include <unistd.h> // close, unlink, pipe2, read, write
+
+namespace PackageTracking {
+
+  namespace {
+
+    // Connections that may wait to be accepted.
+    constexpr int kBacklog = 128;
+
+    // Longest query line accepted; a connection that sends a longer
+    // one gets an error and is closed.
+    constexpr std::size_t kMaxLineSize = 1 << 14;
+
+    // Queries a connection may have waiting for replies, and bytes of
+    // replies it may have unsent, before the server stops reading from
+    // it.
+    constexpr std::size_t kMaxPending = 64;
+    constexpr std::size_t kMaxOutbox = 1 << 20;
+
+    // The reply to the query on line.
+    std::string Reply(PackageCache& cache, std::string_view line) {
+      std::string reply, answer;
+      try {
+	Query query;
+	std::string error;
+	if (!ParseQuery(line, query, error)) {
+	  throw std::invalid_argument(error);
+	}
+	cache.Answer(query, answer);
+	reply = "OK " + std::to_string(answer.size()) + "\n";
+	reply += answer;
+      } catch (std::exception& e) {
+	reply = "ERROR ";
+	reply += e.what();
+	reply += '\n';
+      }
+      return reply;
+    }
+
+  }
+
+  // One client connection. input belongs to the thread in Run, which
+  // alone writes reading, under mutex; the replies awaited, in the
+  // order their queries arrived, and the bytes of replies the socket
+  // has not yet taken, are guarded by mutex. The socket is closed when
+  // the last task holding the connection lets go of it.
+  struct QueryServer::Connection {
+    Connection(QueryServer& server, int fd)
+    : server(server), fd(fd) { }
+
+    ~Connection() {
+      server.Forget(fd);
+      close(fd);
+    }
+
+    QueryServer& server;
+    const int fd;
+    std::string input;
+    bool reading = true;
+
+    std::mutex mutex;
+    // a deque, so adding and removing replies at the ends leaves the
+    // others where the tasks filling them expect
+    std::deque<Pending> pending;
+    std::string outbox;
+    bool failed = false;
+
+    // Whether Run should stop reading queries until replies are sent.
+    // The caller must hold mutex.
+    bool Throttled() const {
+      return (pending.size() >= kMaxPending) || (outbox.size() >= kMaxOutbox);
+    }
+
+    // Whether nothing more will be read or sent. The caller must hold
+    // mutex.
+    bool Done() const {
+      return !reading && pending.empty() && outbox.empty();
+    }
+
+    // Send as much of outbox as the socket takes without blocking. The
+    // caller must hold mutex.
+    void Flush() {
+      std::size_t done = 0;
+      while (done < outbox.size()) {
+	ssize_t count = send(fd, outbox.data() + done, outbox.size() - done, MSG_NOSIGNAL);
+	if (count < 0) {
+	  if (errno == EINTR) {
+	    continue;
+	  }
+	  if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+	    break;
+	  }
+	  // the peer has gone, so make Run see the connection close
+	  failed = true;
+	  shutdown(fd, SHUT_RDWR);
+	  done = outbox.size();
+	  break;
+	}
+	done += count;
+      }
+      outbox.erase(0, done);
+    }
+  };
+
+  QueryServer::QueryServer(const std::string& path, unsigned threads)
+  : path_(path), listener_(-1), wake_{-1, -1}, stopping_(false), pool_(threads) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+      throw std::invalid_argument("socket path is too long");
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    // only a stale socket may be replaced
+    struct stat info;
+    if (lstat(path.c_str(), &info) == 0) {
+      if (!S_ISSOCK(info.st_mode)) {
+	throw std::invalid_argument("\"" + path + "\" exists and is not a socket");
+      }
+      unlink(path.c_str());
+    } else if (errno != ENOENT) {
+      throw std::invalid_argument("could not listen on \"" + path + "\"");
+    }
+
+    if (pipe2(wake_, O_NONBLOCK | O_CLOEXEC) != 0) {
+      throw std::invalid_argument("could not create socket");
+    }
+    listener_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener_ < 0) {
+      close(wake_[0]);
+      close(wake_[1]);
+      throw std::invalid_argument("could not create socket");
+    }
+    if ((bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+	|| (listen(listener_, kBacklog) != 0)) {
+      close(listener_);
+      close(wake_[0]);
+      close(wake_[1]);
+      throw std::invalid_argument("could not listen on \"" + path + "\"");
+    }
+  }
+
+  QueryServer::~QueryServer() {
+    Stop();
+    ShutdownClients();
+    pool_.Wait();
+    close(listener_);
+    close(wake_[0]);
+    close(wake_[1]);
+    unlink(path_.c_str());
+  }
+
+  void QueryServer::Run() {
+    ConnectionMap connections;
+    std::vector<pollfd> ready;
+    while (!stopping_) {
+      // wait on the wake pipe, the listener, every connection that may
+      // send more queries, and every one with replies to flush; let go
+      // of the connections that are done
+      ready.assign({pollfd{wake_[0], POLLIN, 0}, pollfd{listener_, POLLIN, 0}});
+      for (auto it = connections.begin(); it != connections.end(); ) {
+	Connection& connection = *it->second;
+	std::unique_lock<std::mutex> lock(connection.mutex);
+	if (connection.Done()) {
+	  lock.unlock();
+	  it = connections.erase(it);
+	  continue;
+	}
+	short events = 0;
+	if (connection.reading && !connection.Throttled()) {
+	  events |= POLLIN;
+	}
+	if (!connection.outbox.empty()) {
+	  events |= POLLOUT;
+	}
+	if (events != 0) {
+	  ready.push_back(pollfd{it->first, events, 0});
+	}
+	++it;
+      }
+      if (poll(ready.data(), ready.size(), -1) < 0) {
+	if (errno == EINTR) {
+	  continue;
+	}
+	break;
+      }
+
+      if (ready[0].revents != 0) {
+	char drain[64];
+	while (read(wake_[0], drain, sizeof(drain)) > 0) { }
+      }
+      if (ready[1].revents != 0) {
+	Accept(connections);
+      }
+      for (std::size_t i = 2; i < ready.size(); i++) {
+	if (ready[i].revents == 0) {
+	  continue;
+	}
+	const std::shared_ptr<Connection>& connection = connections.find(ready[i].fd)->second;
+	if (ready[i].events & POLLOUT) {
+	  std::lock_guard<std::mutex> lock(connection->mutex);
+	  connection->Flush();
+	}
+	if (ready[i].events & POLLIN) {
+	  Receive(connection);
+	}
+      }
+    }
+    // replies still being sent fail at once
+    ShutdownClients();
+  }
+
+  void QueryServer::Stop() {
+    stopping_ = true;
+    // wakes the thread in Run
+    char wake = 0;
+    ssize_t written = write(wake_[1], &wake, 1);
+    (void)written;
+  }
+
+  PackageCache& QueryServer::Cache() noexcept {
+    return cache_;
+  }
+
+  void QueryServer::Accept(ConnectionMap& connections) {
+    for (;;) {
+      // non-blocking, so a client that does not read its replies never
+      // holds up a worker
+      int fd = accept4(listener_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) {
+	if ((errno == EINTR) || (errno == ECONNABORTED)) {
+	  continue;
+	}
+	// EAGAIN once the backlog is empty; on EMFILE and the like, the
+	// rest wait until a connection closes
+	return;
+      }
+      {
+	std::lock_guard<std::mutex> lock(mutex_);
+	clients_.insert(fd);
+      }
+      connections.emplace(fd, std::make_shared<Connection>(*this, fd));
+    }
+  }
+
+  void QueryServer::Receive(const std::shared_ptr<Connection>& connection) {
+    char chunk[4096];
+    ssize_t count;
+    do {
+      count = recv(connection->fd, chunk, sizeof(chunk), 0);
+    } while ((count < 0) && (errno == EINTR));
+    if ((count < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+      return;
+    }
+    std::string& input = connection->input;
+    bool reading = (count > 0);
+    if (!reading) {
+      // answer a last query with no newline
+      if ((count == 0) && (input.find_first_not_of(" \t\r") != std::string::npos)) {
+	input += '\n';
+      }
+    } else {
+      input.append(chunk, count);
+    }
+
+    // submit every complete line
+    std::size_t start = 0, end;
+    while ((end = input.find('\n', start)) != std::string::npos) {
+      std::string line = input.substr(start, end - start);
+      start = end + 1;
+      if (line.find_first_not_of(" \t\r") == std::string::npos) {
+	continue;
+      }
+      Submit(connection, [this, line] { return Reply(cache_, line); });
+    }
+    input.erase(0, start);
+
+    if (input.size() > kMaxLineSize) {
+      reading = false;
+      Submit(connection, [] { return std::string("ERROR query is too long\n"); });
+    }
+    if (!reading) {
+      std::string().swap(input);
+      std::lock_guard<std::mutex> lock(connection->mutex);
+      connection->reading = false;
+    }
+  }
+
+  void QueryServer::Submit(const std::shared_ptr<Connection>& connection,
+			   std::function<std::string()> answer) {
+    Pending* pending;
+    {
+      std::lock_guard<std::mutex> lock(connection->mutex);
+      connection->pending.emplace_back();
+      pending = &connection->pending.back();
+    }
+    pool_.Submit([this, connection, pending, answer = std::move(answer)] {
+      std::string reply = answer();
+      Complete(*connection, *pending, std::move(reply));
+    });
+  }
+
+  void QueryServer::Complete(Connection& connection, Pending& pending,
+			     std::string reply) {
+    std::lock_guard<std::mutex> lock(connection.mutex);
+    bool throttled = connection.Throttled(), flushing = !connection.outbox.empty();
+    pending.reply = std::move(reply);
+    pending.ready = true;
+
+    // queue the replies that are ready, in order, and send what the
+    // socket takes now
+    while (!connection.pending.empty() && connection.pending.front().ready) {
+      if (!connection.failed) {
+	connection.outbox += connection.pending.front().reply;
+      }
+      connection.pending.pop_front();
+    }
+    connection.Flush();
+
+    // wake Run if it may read from the connection again, must flush
+    // the rest of the replies, or may close the connection
+    if ((throttled && !connection.Throttled())
+	|| (!flushing && !connection.outbox.empty())
+	|| connection.Done()) {
+      char wake = 0;
+      ssize_t written = write(wake_[1], &wake, 1);
+      (void)written;
+    }
+  }
+
+  void QueryServer::Forget(int fd) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    clients_.erase(fd);
+  }
+
+  void QueryServer::ShutdownClients() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int fd : clients_) {
+      shutdown(fd, SHUT_RDWR);
+    }
+  }
+
+}
@@ -0,0 +1,131 @@
+////////////////////////////////////////////////////////////////////////////////
+// QueryServer.h
+//
+// class QueryServer
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef QUERY_SERVER_H
+#define QUERY_SERVER_H
+
+#include <atomic> // std::atomic
+#include <functional> // std::function
+#include <memory> // std::shared_ptr
+#include <mutex> // std::mutex
+#include <stdexcept> // std::invalid_argument
+#include <string> // std::string
+#include <unordered_map> // std::unordered_map
+#include <unordered_set> // std::unordered_set
+
+#include "PackageCache.h"
+#include "ThreadPool.h"
+
+namespace PackageTracking {
+
+  // A QueryServer answers queries about package files over a Unix
+  // domain socket, so that clients skip process start-up and, through
+  // a PackageCache, the parse of files they have asked about before.
+  //
+  // The protocol is line-based. A client sends one query per line, in
+  // the form read by ParseQuery:
+  //
+  //   <FILENAME> <HOW> <INDEX>
+  //   <FILENAME> between <T0> <T1>
+  //
+  // and for each one, in order, the server replies either
+  //
+  //   OK <LENGTH>\n<LENGTH bytes of updates>
+  //
+  // or
+  //
+  //   ERROR <MESSAGE>\n
+  //
+  // A connection may carry any number of queries, and may send them
+  // without waiting for the replies. The thread in Run waits on every
+  // connection at once with poll(2); each query is answered as its
+  // own task on a ThreadPool, so the queries of one connection, and of
+  // different connections, are answered in parallel, and no worker
+  // waits on a client between queries. Client sockets are
+  // non-blocking: replies a client has not yet read are queued on its
+  // connection and flushed by Run as the socket drains, so no worker
+  // waits on a client to read either. A connection with 64 queries
+  // awaiting replies, or 1 MiB of replies unsent, is not read from
+  // until some are sent, and one that sends a line longer than 16 KiB
+  // gets an error and is closed.
+  class QueryServer {
+  public:
+
+    // Bind a socket at path, replacing any stale socket file there,
+    // and start listening. Queries are answered on threads threads (0
+    // means one per core).
+    //
+    // Throws std::invalid_argument if the socket cannot be set up, or
+    // if something other than a socket exists at path.
+    QueryServer(const std::string& path, unsigned threads = 0);
+
+    // Stop, shut down open connections, wait for the queries already
+    // read to finish, and remove the socket file.
+    ~QueryServer();
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    // Accept and serve connections until Stop is called.
+    void Run();
+
+    // Make Run return, shutting down every open connection. Safe to
+    // call from any thread, and from a signal handler.
+    void Stop();
+
+    PackageCache& Cache() noexcept;
+
+  private:
+    // A reply to one query of a connection, once it is ready.
+    struct Pending {
+      std::string reply;
+      bool ready = false;
+    };
+
+    struct Connection;
+    using ConnectionMap = std::unordered_map<int, std::shared_ptr<Connection>>;
+
+    // Accept every waiting connection into connections.
+    void Accept(ConnectionMap& connections);
+
+    // Read what connection has sent, and submit a task for each
+    // complete query. Clears connection->reading once it has closed,
+    // failed, or sent too long a line.
+    void Receive(const std::shared_ptr<Connection>& connection);
+
+    // Reserve connection's next reply, and fill it with answer() on the
+    // pool.
+    void Submit(const std::shared_ptr<Connection>& connection,
+		std::function<std::string()> answer);
+
+    // Fill a reserved reply, then queue every reply ready in order on
+    // the connection and send what its socket takes without blocking.
+    void Complete(Connection& connection, Pending& pending, std::string reply);
+
+    // Stop tracking the client socket fd, just before it is closed.
+    void Forget(int fd);
+
+    // shutdown(2) every client socket.
+    void ShutdownClients();
+
+    std::string path_;
+    int listener_;
+    // a pipe whose read end Run polls, written to wake it
+    int wake_[2];
+    std::atomic<bool> stopping_;
+    PackageCache cache_;
+
+    // the open client sockets
+    std::mutex mutex_;
+    std::unordered_set<int> clients_;
+
+    // last, so it finishes its tasks before the rest is destroyed
+    ThreadPool pool_;
+  };
+
+}
+
+#endif
@@ -4,50 +4,301 @@
 // Reading a PackageStatus object from a JSON file.
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm> // std::max
 #include <fstream> // std::ifstream
+#include <vector> // std::vector
 
 #include <nlohmann/json.hpp>
 
 #include "Serialize.h"
+#include "Stats.h"
 
 namespace PackageTracking {
 
-  PackageStatus PackageStatusFromJSON(const std::string& path) {
+  namespace {
 
     using json = nlohmann::json;
-    
-    std::ifstream f(path);
-    if (!f) {
-      throw std::invalid_argument("could not open \"" + path + "\"");
-    }
 
-    json root;
-    try {
-      f >> root;
-    } catch (json::parse_error e) {
-      throw std::invalid_argument("JSON parse error");
-    }
+    // SAX handler that builds a PackageStatus while the document is
+    // being parsed. Members of the root object other than
+    // "tracking_number" and "updates", and elements of an update past
+    // the third, are skipped.
+    class PackageStatusSax : public nlohmann::json_sax<json> {
+    public:
+
+      // Updates are handed to PackageStatus::AddUpdates this many at
+      // a time.
+      static constexpr std::size_t kBatchSize = 1024;
+
+      PackageStatusSax(std::shared_ptr<StringPool> pool)
+      : result_(std::string(), std::move(pool)) {
+	batch_.reserve(kBatchSize);
+      }
+
+      // Return the finished PackageStatus. Throws std::invalid_argument
+      // if the document was malformed or missing entries.
+      PackageStatus Finish() {
+	if (error_) {
+	  TRACK_COUNT(ExceptionsThrown, 1);
+	  throw std::invalid_argument(error_);
+	}
+	if (!seen_tracking_number_ || !seen_updates_) {
+	  TRACK_COUNT(ExceptionsThrown, 1);
+	  throw std::invalid_argument(kMissingEntries);
+	}
+	TRACK_COUNT(UpdatesParsed, result_.Size());
+	return std::move(result_);
+      }
+
+      bool null() override {
+	if ((depth_ == 1) && (field_ == Field::Updates)) {
+	  // an updates value of null holds no updates
+	  seen_updates_ = true;
+	  field_ = Field::None;
+	  return true;
+	}
+	return Scalar();
+      }
+
+      bool boolean(bool) override {
+	return Scalar();
+      }
+
+      bool number_integer(number_integer_t value) override {
+	return Number(value);
+      }
+
+      bool number_unsigned(number_unsigned_t value) override {
+	return Number(value);
+      }
+
+      bool number_float(number_float_t value, const string_t&) override {
+	return Number(value);
+      }
+
+      bool string(string_t& value) override {
+	if (skip_depth_ > 0) {
+	  return true;
+	}
+	if ((depth_ == 1) && (field_ == Field::TrackingNumber)) {
+	  result_.SetTrackingNumber(value);
+	  seen_tracking_number_ = true;
+	  field_ = Field::None;
+	  return true;
+	}
+	if ((depth_ == 3) && (element_ == 0)) {
+	  description_ = result_.Pool()->Intern(value);
+	  element_++;
+	  return true;
+	}
+	if ((depth_ == 3) && (element_ == 1)) {
+	  location_ = result_.Pool()->Intern(value);
+	  element_++;
+	  return true;
+	}
+	return Scalar();
+      }
+
+      bool binary(binary_t&) override {
+	return Scalar();
+      }
+
+      bool start_object(std::size_t) override {
+	if (skip_depth_ > 0) {
+	  skip_depth_++;
+	  return true;
+	}
+	if (depth_ == 0) {
+	  depth_ = 1;
+	  return true;
+	}
+	if ((depth_ == 1) && (field_ == Field::Other)) {
+	  skip_depth_ = 1;
+	  field_ = Field::None;
+	  return true;
+	}
+	if ((depth_ == 3) && (element_ >= 3)) {
+	  skip_depth_ = 1;
+	  return true;
+	}
+	return Fail(kMissingEntries);
+      }
+
+      bool key(string_t& value) override {
+	if (skip_depth_ > 0) {
+	  return true;
+	}
+	if (value == "tracking_number") {
+	  if (seen_tracking_number_) {
+	    return Fail(kParseError);
+	  }
+	  field_ = Field::TrackingNumber;
+	} else if (value == "updates") {
+	  if (seen_updates_) {
+	    return Fail(kParseError);
+	  }
+	  field_ = Field::Updates;
+	} else {
+	  field_ = Field::Other;
+	}
+	return true;
+      }
+
+      bool end_object() override {
+	if (skip_depth_ > 0) {
+	  skip_depth_--;
+	  return true;
+	}
+	depth_ = 0;
+	return true;
+      }
+
+      bool start_array(std::size_t) override {
+	if (skip_depth_ > 0) {
+	  skip_depth_++;
+	  return true;
+	}
+	if ((depth_ == 1) && (field_ == Field::Updates)) {
+	  depth_ = 2;
+	  seen_updates_ = true;
+	  field_ = Field::None;
+	  return true;
+	}
+	if ((depth_ == 1) && (field_ == Field::Other)) {
+	  skip_depth_ = 1;
+	  field_ = Field::None;
+	  return true;
+	}
+	if (depth_ == 2) {
+	  depth_ = 3;
+	  element_ = 0;
+	  return true;
+	}
+	if ((depth_ == 3) && (element_ >= 3)) {
+	  skip_depth_ = 1;
+	  return true;
+	}
+	return Fail(kMissingEntries);
+      }
+
+      bool end_array() override {
+	if (skip_depth_ > 0) {
+	  skip_depth_--;
+	  return true;
+	}
+	if (depth_ == 3) {
+	  if (element_ < 3) {
+	    return Fail(kMissingEntries);
+	  }
+	  batch_.emplace_back(*result_.Pool(), description_, location_, timestamp_);
+	  if (batch_.size() == kBatchSize) {
+	    Flush();
+	  }
+	  depth_ = 2;
+	  return true;
+	}
+	// end of the updates array
+	Flush();
+	depth_ = 1;
+	return true;
+      }
 
-    try {
+      bool parse_error(std::size_t, const std::string&,
+		       const nlohmann::detail::exception&) override {
+	return Fail(kParseError);
+      }
+
+    private:
 
-      std::string tracking_number = root.at("tracking_number");
-      json updates = root.at("updates");
+      // Which member of the root object the next value belongs to.
+      enum class Field { None, TrackingNumber, Updates, Other };
 
-      PackageStatus result(tracking_number);
+      static constexpr const char* kParseError = "JSON parse error";
+      static constexpr const char* kMissingEntries = "JSON is missing entries";
+
+      // Handle a timestamp, or any other number.
+      template <typename Value>
+      bool Number(Value value) {
+	if ((skip_depth_ == 0) && (depth_ == 3) && (element_ == 2)) {
+	  timestamp_ = static_cast<std::time_t>(value);
+	  element_++;
+	  return true;
+	}
+	return Scalar();
+      }
 
-      for (auto& update : updates) {
-	std::string description = update[0],
-	  location = update[1];
-	time_t timestamp = update[2];
+      // Handle a scalar other than a timestamp or one of the strings
+      // we keep. It is only allowed where values are skipped.
+      bool Scalar() {
+	if (skip_depth_ > 0) {
+	  return true;
+	}
+	if ((depth_ == 1) && (field_ == Field::Other)) {
+	  field_ = Field::None;
+	  return true;
+	}
+	if ((depth_ == 3) && (element_ >= 3)) {
+	  return true;
+	}
+	return Fail(kMissingEntries);
+      }
+
+      // Record the first error and stop parsing.
+      bool Fail(const char* error) {
+	if (!error_) {
+	  error_ = error;
+	}
+	return false;
+      }
 
-	result.AddUpdate(description, location, timestamp);
+      // Add the batched updates to the result.
+      void Flush() {
+	result_.AddUpdates(batch_);
+	batch_.clear();
       }
 
-      return result;
+      PackageStatus result_;
+      std::vector<ShippingUpdate> batch_;
 
-    } catch (json::exception e) {
-      throw std::invalid_argument("JSON is missing entries");
+      // Nesting depth: 1 inside the root object, 2 inside the updates
+      // array, 3 inside one update. skip_depth_ counts containers
+      // entered below a value that is being skipped.
+      int depth_ = 0, skip_depth_ = 0;
+      Field field_ = Field::None;
+      bool seen_tracking_number_ = false, seen_updates_ = false;
+
+      // The update being parsed, and how many of its elements have
+      // been seen.
+      int element_ = 0;
+      StringId description_ = 0, location_ = 0;
+      std::time_t timestamp_ = 0;
+
+      const char* error_ = nullptr;
+    };
+
+  }
+
+  PackageStatus PackageStatusFromJSON(const std::string& path, std::shared_ptr<StringPool> pool) {
+    TRACK_SPAN("PackageStatusFromJSON");
+
+    std::ifstream f(path);
+    if (!f) {
+      TRACK_COUNT(ExceptionsThrown, 1);
+      throw std::invalid_argument("could not open \"" + path + "\"");
     }
+
+    PackageStatus status = PackageStatusFromJSON(f, std::move(pool));
+    TRACK_COUNT(BytesRead, std::max<std::streamoff>(0, f.tellg()));
+    return status;
+  }
+
+  PackageStatus PackageStatusFromJSON(std::istream& in, std::shared_ptr<StringPool> pool) {
+    TRACK_TIMER("PackageStatusFromJSON(istream)");
+
+    PackageStatusSax handler(std::move(pool));
+    // not strict, so trailing text after the document is ignored
+    json::sax_parse(in, &handler, json::input_format_t::json, false);
+    return handler.Finish();
   }
   
 }
@@ -7,6 +7,8 @@
 #ifndef SERIALIZE_H
 #define SERIALIZE_H
 
+#include <istream> // std::istream
+#include <memory> // std::shared_ptr
 #include <stdexcept> // std::invalid_argument
 #include <string> // std::string
 
@@ -16,8 +18,22 @@
 
 namespace PackageTracking {
 
+  // Read a PackageStatus from a JSON document of the form
+  //
+  //   { "tracking_number" : "...",
+  //     "updates" : [ [description, location, timestamp], ... ] }
+  //
+  // The document is parsed as a stream of SAX events, and updates are
+  // fed into the PackageStatus in small batches as they are parsed,
+  // so memory use is bounded by the size of the result rather than
+  // the size of the document. Descriptions and locations are interned
+  // into pool.
+  //
   // throws std::invalid_argument if the file cannot be loaded
-  PackageStatus PackageStatusFromJSON(const std::string& path);
+  PackageStatus PackageStatusFromJSON(const std::string& path,
+				      std::shared_ptr<StringPool> pool = StringPool::Default());
+  PackageStatus PackageStatusFromJSON(std::istream& in,
+				      std::shared_ptr<StringPool> pool = StringPool::Default());
   
 }
 
@@ -5,34 +5,141 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "ShippingUpdate.h"
+#include <charconv> // std::to_chars
 #include <string>
 
 namespace PackageTracking {
 
-  ShippingUpdate::ShippingUpdate() noexcept
-  : timestamp_(0) { }
+  namespace {
+
+    // Longest decimal std::time_t, with sign, plus the trailing space.
+    constexpr std::size_t kTimestampTextSize = 22;
+
+    // Format "<timestamp> " into digits and return a view of it.
+    std::string_view FormatTimestamp(std::time_t timestamp,
+				     char (&digits)[kTimestampTextSize]) noexcept {
+      auto result = std::to_chars(digits, digits + kTimestampTextSize - 1, timestamp);
+      *result.ptr = ' ';
+      return std::string_view(digits, result.ptr - digits + 1);
+    }
+
+  }
+
+  void WriteDescription(std::time_t timestamp,
+			std::string_view description,
+			std::string_view location,
+			std::string& buffer) {
+    char digits[kTimestampTextSize];
+    buffer += FormatTimestamp(timestamp, digits);
+    buffer += description;
+    buffer += ' ';
+    buffer += location;
+    buffer += '\n';
+  }
+
+  void WriteDescription(std::time_t timestamp,
+			std::string_view description,
+			std::string_view location,
+			std::ostream& out) {
+    char digits[kTimestampTextSize];
+    out << FormatTimestamp(timestamp, digits) << description << ' '
+	<< location << '\n';
+  }
+
+  void WriteDescription(std::time_t timestamp,
+			std::string_view description,
+			std::string_view location,
+			const DescribeSink& sink) {
+    char digits[kTimestampTextSize];
+    sink(FormatTimestamp(timestamp, digits));
+    sink(description);
+    sink(" ");
+    sink(location);
+    sink("\n");
+  }
+
+  ShippingUpdate::ShippingUpdate()
+  : pool_(StringPool::Default().get()), description_(0), location_(0),
+    timestamp_(0) { }
 
   ShippingUpdate::ShippingUpdate(const std::string& description,
 				 const std::string& location,
+				 std::time_t timestamp)
+         : pool_(StringPool::Default().get()),
+           description_(StringPool::Default()->Intern(description)),
+           location_(StringPool::Default()->Intern(location)),
+           timestamp_(timestamp)
+          { }
+
+  ShippingUpdate::ShippingUpdate(const StringPool& pool,
+				 StringId description,
+				 StringId location,
 				 std::time_t timestamp) noexcept
-         : description_(description), location_(location), timestamp_(timestamp)
+         : pool_(&pool), description_(description), location_(location),
+           timestamp_(timestamp)
           { }
 
-  const std::string& ShippingUpdate::Description() const noexcept {
-    return description_;
+  const std::string& ShippingUpdate::Description() const {
+    return pool_->Get(description_);
   }
 
-  const std::string& ShippingUpdate::Location() const noexcept {
-    return location_;
+  const std::string& ShippingUpdate::Location() const {
+    return pool_->Get(location_);
   }
 
   time_t ShippingUpdate::Timestamp() const noexcept {
     return timestamp_;
   }
-  std::string ShippingUpdate::Describe() const noexcept {
-    std::string describe = std::to_string(timestamp_) + " " + description_ + " " + location_ + "\n";
+
+  StringId ShippingUpdate::DescriptionId() const noexcept {
+    return description_;
+  }
+
+  StringId ShippingUpdate::LocationId() const noexcept {
+    return location_;
+  }
+
+  const StringPool& ShippingUpdate::Pool() const noexcept {
+    return *pool_;
+  }
+
+  std::string ShippingUpdate::Describe() const {
+    std::string describe;
+    DescribeTo(describe);
     return describe;
+  }
+
+  void ShippingUpdate::DescribeTo(std::string& buffer) const {
+    WriteDescription(timestamp_, Description(), Location(), buffer);
+  }
+
+  void ShippingUpdate::DescribeTo(std::ostream& out) const {
+    WriteDescription(timestamp_, Description(), Location(), out);
+  }
+
+  void ShippingUpdate::DescribeTo(const DescribeSink& sink) const {
+    WriteDescription(timestamp_, Description(), Location(), sink);
+  }
+
+  bool ShippingUpdate::operator==(const ShippingUpdate& other) const {
+    if (timestamp_ != other.timestamp_) {
+      return false;
+    }
+    if (pool_ == other.pool_) {
+      return (description_ == other.description_) && (location_ == other.location_);
+    }
+    return (Description() == other.Description()) && (Location() == other.Location());
+  }
+
+  bool ShippingUpdate::operator!=(const ShippingUpdate& other) const {
+    return !(*this == other);
+  }
 
+  MemoryUsage ShippingUpdate::MemoryUsage() const noexcept {
+    PackageTracking::MemoryUsage usage;
+    usage.payload = sizeof(description_) + sizeof(location_) + sizeof(timestamp_);
+    usage.overhead = sizeof(ShippingUpdate) - usage.payload;
+    return usage;
   }
 
 }
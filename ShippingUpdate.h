@@ -8,30 +8,76 @@
 #define SHIPPING_UPDATE_H
 
 #include <ctime>  // std::time_t
+#include <functional> // std::function
+#include <ostream> // std::ostream
 #include <string> // std::string
+#include <string_view> // std::string_view
+
+#include "MemoryUsage.h"
+#include "StringPool.h"
 
 namespace PackageTracking {
 
+  // A callback that receives the text of a description in pieces, in
+  // order. Concatenating the pieces gives the full text.
+  using DescribeSink = std::function<void(std::string_view)>;
+
+  // Write the description of an update with the given fields, in the
+  // format of ShippingUpdate::Describe, without building a temporary
+  // string. The timestamp is formatted with std::to_chars; no heap
+  // allocation is done beyond any growth of the destination.
+  //
+  // The std::string overload appends to buffer.
+  void WriteDescription(std::time_t timestamp,
+			std::string_view description,
+			std::string_view location,
+			std::string& buffer);
+  void WriteDescription(std::time_t timestamp,
+			std::string_view description,
+			std::string_view location,
+			std::ostream& out);
+  void WriteDescription(std::time_t timestamp,
+			std::string_view description,
+			std::string_view location,
+			const DescribeSink& sink);
+
   // A shipping update represents one event in the delivery
   // process. It has a description such as "Out for delivery"; a
   // location such as "Fullerton, CA US"; and a timestamp, which is a
   // Unix timestamp.
+  //
+  // The description and location are held as ids into a StringPool,
+  // so a ShippingUpdate is small and cheap to copy. The pool must
+  // outlive every ShippingUpdate that refers to it.
   class ShippingUpdate {
   public:
 
     // Default constructor initializes description and location to
     // empty strings, and timestamp to 0.
-    ShippingUpdate() noexcept;
+    ShippingUpdate();
 
-    // Initialization constructor
+    // Initialization constructor. The description and location are
+    // interned into StringPool::Default(), which may throw
+    // std::bad_alloc.
     ShippingUpdate(const std::string& description,
 		   const std::string& location,
+		   std::time_t timestamp);
+
+    // Initialization constructor from ids that were already interned
+    // into pool.
+    ShippingUpdate(const StringPool& pool,
+		   StringId description,
+		   StringId location,
 		   std::time_t timestamp) noexcept;
 
-    // Accessors
-    const std::string& Description() const noexcept;
-    const std::string& Location() const noexcept;
+    // Accessors. Description and Location throw std::out_of_range if
+    // the ids were not handed out by Pool().
+    const std::string& Description() const;
+    const std::string& Location() const;
     time_t Timestamp() const noexcept;
+    StringId DescriptionId() const noexcept;
+    StringId LocationId() const noexcept;
+    const StringPool& Pool() const noexcept;
 
     // Return a human-readable description of this update.
     // This is:
@@ -41,10 +87,27 @@ namespace PackageTracking {
     //  4. one space
     //  5. location
     //  6. one newline (\n)
-    std::string Describe() const noexcept;
-    
+    std::string Describe() const;
+
+    // Write the same text as Describe straight to a destination; see
+    // WriteDescription. The std::string overload appends to buffer.
+    void DescribeTo(std::string& buffer) const;
+    void DescribeTo(std::ostream& out) const;
+    void DescribeTo(const DescribeSink& sink) const;
+
+    // Two updates are equal when their descriptions, locations, and
+    // timestamps are equal. When both share a pool this compares ids
+    // rather than text.
+    bool operator==(const ShippingUpdate& other) const;
+    bool operator!=(const ShippingUpdate& other) const;
+
+    // Memory held by this object; see MemoryUsage. The description and
+    // location are ids, so their text is counted by the pool instead.
+    PackageTracking::MemoryUsage MemoryUsage() const noexcept;
+
   private:
-    std::string description_, location_;
+    const StringPool* pool_;
+    StringId description_, location_;
     std::time_t timestamp_;
   };
   
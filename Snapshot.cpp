@@ -0,0 +1,355 @@
+////////////////////////////////////////////////////////////////////////////////
+// Snapshot.cpp
+//
+// Binary snapshots of a PackageStatus, and class PackageSnapshot
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Snapshot.h"
+
+#include <cstdio> // std::rename, std::remove
+#include <cstring> // std::memcpy
+#include <fstream> // std::ofstream
+#include <unordered_map> // std::unordered_map
+#include <vector> // std::vector
+
+#include "MappedFile.h"
+
+namespace PackageTracking {
+
+  namespace {
+
+    constexpr char kMagic[8] = {'P', 'K', 'G', 'S', 'N', 'A', 'P', '\0'};
+    constexpr std::uint32_t kByteOrderMark = 0x01020304;
+
+    // The fixed-size header at the start of every snapshot. Offsets
+    // are from the start of the file.
+    struct Header {
+      char magic[8];
+      std::uint32_t version;
+      std::uint32_t byte_order_mark;
+      std::uint64_t update_count;
+      std::uint64_t string_count;
+      std::uint64_t tracking_number_offset, tracking_number_size;
+      std::uint64_t timestamps_offset;
+      std::uint64_t descriptions_offset;
+      std::uint64_t locations_offset;
+      std::uint64_t string_offsets_offset;
+      std::uint64_t string_data_offset, string_data_size;
+      // Checksum of every byte after the header.
+      std::uint64_t checksum;
+    };
+
+    // Round offset up to a multiple of 8.
+    std::uint64_t Align(std::uint64_t offset) noexcept {
+      return (offset + 7) & ~std::uint64_t(7);
+    }
+
+    // Read a T from possibly unaligned memory.
+    template <typename T>
+    T Load(const char* data) noexcept {
+      T value;
+      std::memcpy(&value, data, sizeof(T));
+      return value;
+    }
+
+    // FNV-1a over 64-bit words, with the final partial word zero
+    // padded. Working a word at a time keeps checking a large file
+    // close to the cost of reading it.
+    std::uint64_t Checksum(std::string_view bytes) noexcept {
+      std::uint64_t hash = 0xcbf29ce484222325;
+      std::size_t i = 0;
+      for (; i + 8 <= bytes.size(); i += 8) {
+	hash = (hash ^ Load<std::uint64_t>(bytes.data() + i)) * 0x100000001b3;
+      }
+      if (i < bytes.size()) {
+	std::uint64_t tail = 0;
+	std::memcpy(&tail, bytes.data() + i, bytes.size() - i);
+	hash = (hash ^ tail) * 0x100000001b3;
+      }
+      return hash;
+    }
+
+    [[noreturn]] void Corrupt(const std::string& path, const std::string& problem) {
+      throw std::invalid_argument("bad snapshot \"" + path + "\": " + problem);
+    }
+
+  }
+
+  void WritePackageSnapshot(const PackageStatus& status, const std::string& path) {
+
+    // build a string table holding only the strings this package uses
+    std::unordered_map<StringId, std::uint32_t> table_index;
+    std::vector<std::uint64_t> string_offsets{0};
+    std::string string_data;
+    auto index_of = [&](StringId id, const StringPool& pool) {
+      auto found = table_index.find(id);
+      if (found != table_index.end()) {
+	return found->second;
+      }
+      std::uint32_t index = string_offsets.size() - 1;
+      table_index.emplace(id, index);
+      string_data += pool.Get(id);
+      string_offsets.push_back(string_data.size());
+      return index;
+    };
+
+    std::vector<std::int64_t> timestamps;
+    std::vector<std::uint32_t> descriptions, locations;
+    timestamps.reserve(status.Size());
+    descriptions.reserve(status.Size());
+    locations.reserve(status.Size());
+    for (ShippingUpdate update : status.Updates()) {
+      timestamps.push_back(update.Timestamp());
+      descriptions.push_back(index_of(update.DescriptionId(), update.Pool()));
+      locations.push_back(index_of(update.LocationId(), update.Pool()));
+    }
+
+    Header header = {};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kSnapshotVersion;
+    header.byte_order_mark = kByteOrderMark;
+    header.update_count = timestamps.size();
+    header.string_count = string_offsets.size() - 1;
+    header.tracking_number_offset = Align(sizeof(Header));
+    header.tracking_number_size = status.TrackingNumber().size();
+    header.timestamps_offset = Align(header.tracking_number_offset + header.tracking_number_size);
+    header.descriptions_offset = Align(header.timestamps_offset + 8 * timestamps.size());
+    header.locations_offset = Align(header.descriptions_offset + 4 * descriptions.size());
+    header.string_offsets_offset = Align(header.locations_offset + 4 * locations.size());
+    header.string_data_offset = Align(header.string_offsets_offset + 8 * string_offsets.size());
+    header.string_data_size = string_data.size();
+
+    // lay out the sections after the header in memory, so the
+    // checksum can be taken before anything is written
+    std::string body(header.string_data_offset + string_data.size() - sizeof(Header), '\0');
+    auto place = [&](std::uint64_t offset, const void* data, std::size_t size) {
+      if (size > 0) {
+	std::memcpy(&body[offset - sizeof(Header)], data, size);
+      }
+    };
+    place(header.tracking_number_offset, status.TrackingNumber().data(), header.tracking_number_size);
+    place(header.timestamps_offset, timestamps.data(), 8 * timestamps.size());
+    place(header.descriptions_offset, descriptions.data(), 4 * descriptions.size());
+    place(header.locations_offset, locations.data(), 4 * locations.size());
+    place(header.string_offsets_offset, string_offsets.data(), 8 * string_offsets.size());
+    place(header.string_data_offset, string_data.data(), string_data.size());
+    header.checksum = Checksum(body);
+
+    // write to a temporary file, then rename it over path, so readers
+    // never see a partial snapshot
+    std::string temporary = path + ".tmp";
+    {
+      std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      out.write(body.data(), body.size());
+      if (!out) {
+	std::remove(temporary.c_str());
+	throw std::invalid_argument("could not write \"" + path + "\"");
+      }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+      std::remove(temporary.c_str());
+      throw std::invalid_argument("could not write \"" + path + "\"");
+    }
+  }
+
+  PackageSnapshot::PackageSnapshot() noexcept
+  : timestamps_(nullptr), descriptions_(nullptr), locations_(nullptr),
+    string_offsets_(nullptr), string_data_(nullptr), size_(0), cursor_(0) { }
+
+  std::string_view PackageSnapshot::TrackingNumber() const noexcept {
+    return tracking_number_;
+  }
+
+  int PackageSnapshot::Size() const noexcept {
+    return size_;
+  }
+
+  bool PackageSnapshot::Empty() const noexcept {
+    return size_ == 0;
+  }
+
+  bool PackageSnapshot::MoveCursorBackward() noexcept {
+    return MoveCursor(-1);
+  }
+
+  bool PackageSnapshot::MoveCursorForward() noexcept {
+    return MoveCursor(1);
+  }
+
+  bool PackageSnapshot::SeekCursor(int index) noexcept {
+    if ((index < 0) || (index >= size_)) {
+      return false;
+    }
+    cursor_ = index;
+    return true;
+  }
+
+  bool PackageSnapshot::MoveCursor(int delta) noexcept {
+    if (size_ == 0) {
+      return false;
+    }
+    if ((delta > 0) ? (delta > size_ - 1 - cursor_) : (delta < -cursor_)) {
+      return false;
+    }
+    cursor_ += delta;
+    return true;
+  }
+
+  PackageSnapshot::Update PackageSnapshot::GetCursor() const {
+    RequireNotEmpty();
+    return UpdateAt(cursor_);
+  }
+
+  std::string PackageSnapshot::DescribeCursorUpdate() const {
+    std::string cursor_update;
+    DescribeCursorUpdate(cursor_update);
+    return cursor_update;
+  }
+
+  void PackageSnapshot::DescribeCursorUpdate(std::string& buffer) const {
+    RequireNotEmpty();
+    DescribeRange(cursor_, cursor_ + 1, buffer);
+  }
+
+  void PackageSnapshot::DescribeCursorUpdate(std::ostream& out) const {
+    RequireNotEmpty();
+    DescribeRange(cursor_, cursor_ + 1, out);
+  }
+
+  std::string PackageSnapshot::DescribePreviousUpdates() const {
+    std::string previous_updates;
+    DescribePreviousUpdates(previous_updates);
+    return previous_updates;
+  }
+
+  void PackageSnapshot::DescribePreviousUpdates(std::string& buffer) const {
+    RequireNotEmpty();
+    DescribeRange(0, cursor_, buffer);
+  }
+
+  void PackageSnapshot::DescribePreviousUpdates(std::ostream& out) const {
+    RequireNotEmpty();
+    DescribeRange(0, cursor_, out);
+  }
+
+  std::string PackageSnapshot::DescribeFollowingUpdates() const {
+    std::string following_updates;
+    DescribeFollowingUpdates(following_updates);
+    return following_updates;
+  }
+
+  void PackageSnapshot::DescribeFollowingUpdates(std::string& buffer) const {
+    RequireNotEmpty();
+    DescribeRange(cursor_, size_, buffer);
+  }
+
+  void PackageSnapshot::DescribeFollowingUpdates(std::ostream& out) const {
+    RequireNotEmpty();
+    DescribeRange(cursor_, size_, out);
+  }
+
+  std::string PackageSnapshot::DescribeAllUpdates() const {
+    std::string all_updates;
+    DescribeAllUpdates(all_updates);
+    return all_updates;
+  }
+
+  void PackageSnapshot::DescribeAllUpdates(std::string& buffer) const {
+    DescribeRange(0, size_, buffer);
+  }
+
+  void PackageSnapshot::DescribeAllUpdates(std::ostream& out) const {
+    DescribeRange(0, size_, out);
+  }
+
+  PackageSnapshot::Update PackageSnapshot::UpdateAt(int index) const noexcept {
+    return Update{String(Load<std::uint32_t>(descriptions_ + 4 * index)),
+		  String(Load<std::uint32_t>(locations_ + 4 * index)),
+		  static_cast<std::time_t>(Load<std::int64_t>(timestamps_ + 8 * index))};
+  }
+
+  std::string_view PackageSnapshot::String(std::uint32_t index) const noexcept {
+    std::uint64_t begin = Load<std::uint64_t>(string_offsets_ + 8 * index),
+      end = Load<std::uint64_t>(string_offsets_ + 8 * (index + 1));
+    return std::string_view(string_data_ + begin, end - begin);
+  }
+
+  template <typename Destination>
+  void PackageSnapshot::DescribeRange(int first, int last, Destination& out) const {
+    for (int i = first; i < last; i++) {
+      Update update = UpdateAt(i);
+      WriteDescription(update.timestamp, update.description, update.location, out);
+    }
+  }
+
+  void PackageSnapshot::RequireNotEmpty() const {
+    if (size_ == 0) {
+      throw std::logic_error("PackageSnapshot is empty.");
+    }
+  }
+
+  PackageSnapshot PackageSnapshotFromFile(const std::string& path) {
+    auto file = std::make_shared<const MappedFile>(path);
+    std::string_view bytes = file->Text();
+
+    if ((bytes.size() < sizeof(Header)) || (bytes.compare(0, sizeof(kMagic),
+							   std::string_view(kMagic, sizeof(kMagic))) != 0)) {
+      Corrupt(path, "not a snapshot");
+    }
+    Header header = Load<Header>(bytes.data());
+    if (header.byte_order_mark != kByteOrderMark) {
+      Corrupt(path, "written with a different byte order");
+    }
+    if (header.version != kSnapshotVersion) {
+      Corrupt(path, "unsupported version " + std::to_string(header.version));
+    }
+    if (header.checksum != Checksum(bytes.substr(sizeof(Header)))) {
+      Corrupt(path, "checksum mismatch");
+    }
+
+    // every section must lie inside the file
+    auto section_fits = [&](std::uint64_t offset, std::uint64_t count, std::uint64_t width) {
+      return (offset <= bytes.size()) && (count <= (bytes.size() - offset) / width);
+    };
+    if ((header.update_count > static_cast<std::uint64_t>(INT32_MAX))
+	|| (header.string_count >= UINT32_MAX)
+	|| !section_fits(header.tracking_number_offset, header.tracking_number_size, 1)
+	|| !section_fits(header.timestamps_offset, header.update_count, 8)
+	|| !section_fits(header.descriptions_offset, header.update_count, 4)
+	|| !section_fits(header.locations_offset, header.update_count, 4)
+	|| !section_fits(header.string_offsets_offset, header.string_count + 1, 8)
+	|| !section_fits(header.string_data_offset, header.string_data_size, 1)) {
+      Corrupt(path, "section out of range");
+    }
+
+    PackageSnapshot result;
+    result.tracking_number_ = bytes.substr(header.tracking_number_offset, header.tracking_number_size);
+    result.timestamps_ = bytes.data() + header.timestamps_offset;
+    result.descriptions_ = bytes.data() + header.descriptions_offset;
+    result.locations_ = bytes.data() + header.locations_offset;
+    result.string_offsets_ = bytes.data() + header.string_offsets_offset;
+    result.string_data_ = bytes.data() + header.string_data_offset;
+    result.size_ = header.update_count;
+
+    // every index must be in range, so queries need no checks
+    std::uint64_t previous = 0;
+    for (std::uint64_t i = 0; i <= header.string_count; i++) {
+      std::uint64_t offset = Load<std::uint64_t>(result.string_offsets_ + 8 * i);
+      if ((offset < previous) || (offset > header.string_data_size)) {
+	Corrupt(path, "string index out of range");
+      }
+      previous = offset;
+    }
+    for (int i = 0; i < result.size_; i++) {
+      if ((Load<std::uint32_t>(result.descriptions_ + 4 * i) >= header.string_count)
+	  || (Load<std::uint32_t>(result.locations_ + 4 * i) >= header.string_count)) {
+	Corrupt(path, "string reference out of range");
+      }
+    }
+
+    result.file_ = std::move(file);
+    return result;
+  }
+
+}
@@ -0,0 +1,137 @@
+////////////////////////////////////////////////////////////////////////////////
+// Snapshot.h
+//
+// Binary snapshots of a PackageStatus, and class PackageSnapshot
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint> // std::uint32_t, std::uint64_t
+#include <ctime> // std::time_t
+#include <memory> // std::shared_ptr
+#include <ostream> // std::ostream
+#include <stdexcept> // std::invalid_argument, std::logic_error
+#include <string> // std::string
+#include <string_view> // std::string_view
+
+#include "PackageStatus.h"
+
+namespace PackageTracking {
+
+  class MappedFile;
+
+  // A snapshot file holds one package in a binary form that can be
+  // queried in place, without parsing:
+  //
+  //   header        magic, format version, byte-order mark, counts,
+  //                 section offsets, and a checksum of the sections
+  //   tracking      the tracking number
+  //   timestamps    one int64 per update
+  //   descriptions  one uint32 string-table index per update
+  //   locations     one uint32 string-table index per update
+  //   string index  string_count + 1 uint64 offsets into string data
+  //   string data   every distinct description and location, once
+  //
+  // Numbers are in the byte order of the machine that wrote the file,
+  // and each section starts on an 8-byte boundary.
+
+  // Current snapshot format version.
+  constexpr std::uint32_t kSnapshotVersion = 1;
+
+  // Write status to a snapshot file at path, replacing it atomically.
+  //
+  // Throws std::invalid_argument if the file cannot be written.
+  void WritePackageSnapshot(const PackageStatus& status, const std::string& path);
+
+  // A PackageSnapshot serves the read-only queries of a PackageStatus
+  // straight out of a memory-mapped snapshot file. Opening one checks
+  // the header, the checksum, and every index, and does not copy any
+  // text.
+  //
+  // The mapping is shared by all copies of a PackageSnapshot and
+  // unmapped when the last one is destroyed.
+  class PackageSnapshot {
+  public:
+
+    // One update, as views into the mapping.
+    struct Update {
+      std::string_view description, location;
+      std::time_t timestamp;
+    };
+
+    // Default constructor: an empty tracking number and no updates.
+    PackageSnapshot() noexcept;
+
+    // Accessors
+    std::string_view TrackingNumber() const noexcept;
+    int Size() const noexcept;
+    bool Empty() const noexcept;
+
+    // Cursor motion, with the same meaning as in PackageStatus.
+    bool MoveCursorBackward() noexcept;
+    bool MoveCursorForward() noexcept;
+    bool SeekCursor(int index) noexcept;
+    bool MoveCursor(int delta) noexcept;
+
+    // Return the update the cursor is pointing at.
+    //
+    // If the PackageSnapshot is empty, throws std::logic_error.
+    Update GetCursor() const;
+
+    // Describe updates, with the same meaning as in PackageStatus. The
+    // std::string overloads append to buffer.
+    //
+    // Except for DescribeAllUpdates, if the PackageSnapshot is empty,
+    // throws std::logic_error.
+    std::string DescribeCursorUpdate() const;
+    void DescribeCursorUpdate(std::string& buffer) const;
+    void DescribeCursorUpdate(std::ostream& out) const;
+    std::string DescribePreviousUpdates() const;
+    void DescribePreviousUpdates(std::string& buffer) const;
+    void DescribePreviousUpdates(std::ostream& out) const;
+    std::string DescribeFollowingUpdates() const;
+    void DescribeFollowingUpdates(std::string& buffer) const;
+    void DescribeFollowingUpdates(std::ostream& out) const;
+    std::string DescribeAllUpdates() const;
+    void DescribeAllUpdates(std::string& buffer) const;
+    void DescribeAllUpdates(std::ostream& out) const;
+
+  private:
+    friend PackageSnapshot PackageSnapshotFromFile(const std::string& path);
+
+    // Return the update at the given index, which must be in range.
+    Update UpdateAt(int index) const noexcept;
+
+    // Return the string with the given string-table index, which must
+    // be in range.
+    std::string_view String(std::uint32_t index) const noexcept;
+
+    // Write the descriptions of the updates with indices in
+    // [first, last) to out.
+    template <typename Destination>
+    void DescribeRange(int first, int last, Destination& out) const;
+
+    // Throw std::logic_error if there are no updates.
+    void RequireNotEmpty() const;
+
+    std::shared_ptr<const MappedFile> file_;
+    std::string_view tracking_number_;
+    // the sections, as raw bytes in the mapping
+    const char* timestamps_;
+    const char* descriptions_;
+    const char* locations_;
+    const char* string_offsets_;
+    const char* string_data_;
+    int size_, cursor_;
+  };
+
+  // Map the snapshot file at path and return a PackageSnapshot of it.
+  //
+  // Throws std::invalid_argument if the file cannot be opened, is not
+  // a snapshot, has an unsupported version, or fails its checks.
+  PackageSnapshot PackageSnapshotFromFile(const std::string& path);
+
+}
+
+#endif
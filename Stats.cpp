@@ -0,0 +1,183 @@
+////////////////////////////////////////////////////////////////////////////////
+// Stats.cpp
+//
+// Timing and counter instrumentation, compiled in only when
+// PACKAGE_TRACKING_STATS is defined.
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Stats.h"
+
+#include <algorithm> // std::sort
+#include <iomanip> // std::setw, std::fixed, std::setprecision
+#include <mutex> // std::mutex, std::lock_guard
+#include <vector> // std::vector
+
+namespace PackageTracking {
+
+  namespace Stats {
+
+    namespace {
+
+      const char* const kCounterNames[kCounterCount] = {
+	"bytes read", "updates parsed", "exceptions thrown", "output bytes",
+      };
+
+      // One run of a traced site.
+      struct TraceEvent {
+	const char* name;
+	int thread;
+	std::uint64_t start_microseconds, duration_microseconds;
+      };
+
+      // Everything recorded. Sites form a list, newest first, pushed
+      // under mutex; trace events are also appended under it, which
+      // only traced sites do.
+      struct Registry {
+	std::atomic<std::uint64_t> counters[kCounterCount] = {};
+	std::mutex mutex;
+	Site* sites = nullptr;
+	std::atomic<bool> tracing{false};
+	std::vector<TraceEvent> events;
+	const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	std::atomic<int> next_thread{1};
+      };
+
+      Registry& TheRegistry() {
+	// never destroyed, so that sites in other translation units may
+	// be used during static destruction
+	static Registry* registry = new Registry;
+	return *registry;
+      }
+
+      // A small number naming the calling thread in trace events.
+      int ThreadNumber() {
+	thread_local int number = TheRegistry().next_thread.fetch_add(1);
+	return number;
+      }
+
+      std::uint64_t Microseconds(std::chrono::steady_clock::duration duration) {
+	return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+      }
+
+      // Write text as the contents of a JSON string.
+      void WriteEscaped(std::ostream& out, const char* text) {
+	for (; *text != '\0'; text++) {
+	  if ((*text == '"') || (*text == '\\')) {
+	    out << '\\';
+	  }
+	  out << *text;
+	}
+      }
+
+    }
+
+    Site::Site(const char* name, bool traced)
+    : name(name), traced(traced) {
+      Registry& registry = TheRegistry();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      next = registry.sites;
+      registry.sites = this;
+    }
+
+    ScopedTimer::~ScopedTimer() {
+      auto end = std::chrono::steady_clock::now();
+      site_.count.fetch_add(1, std::memory_order_relaxed);
+      site_.nanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start_).count(),
+				  std::memory_order_relaxed);
+      if (site_.traced) {
+	Registry& registry = TheRegistry();
+	if (registry.tracing.load(std::memory_order_relaxed)) {
+	  TraceEvent event{site_.name, ThreadNumber(),
+			   Microseconds(start_ - registry.epoch), Microseconds(end - start_)};
+	  std::lock_guard<std::mutex> lock(registry.mutex);
+	  registry.events.push_back(event);
+	}
+      }
+    }
+
+    void Add(Counter counter, std::uint64_t amount) noexcept {
+      TheRegistry().counters[static_cast<int>(counter)].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    std::uint64_t Get(Counter counter) noexcept {
+      return TheRegistry().counters[static_cast<int>(counter)].load(std::memory_order_relaxed);
+    }
+
+    void SetTracing(bool on) noexcept {
+      TheRegistry().tracing.store(on);
+    }
+
+    void Reset() {
+      Registry& registry = TheRegistry();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      for (auto& counter : registry.counters) {
+	counter = 0;
+      }
+      for (Site* site = registry.sites; site != nullptr; site = site->next) {
+	site->count = 0;
+	site->nanoseconds = 0;
+      }
+      registry.events.clear();
+    }
+
+    void WriteReport(std::ostream& out) {
+      if (!kEnabled) {
+	out << "stats: not recorded; build with -DPACKAGE_TRACKING_STATS" << std::endl;
+	return;
+      }
+      Registry& registry = TheRegistry();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+
+      out << "stats:" << std::endl;
+      for (int i = 0; i < kCounterCount; i++) {
+	out << "  " << std::left << std::setw(32) << kCounterNames[i] << std::right
+	    << std::setw(14) << registry.counters[i].load() << std::endl;
+      }
+
+      std::vector<const Site*> sites;
+      for (const Site* site = registry.sites; site != nullptr; site = site->next) {
+	if (site->count.load() > 0) {
+	  sites.push_back(site);
+	}
+      }
+      std::sort(sites.begin(), sites.end(), [](const Site* a, const Site* b) {
+	return a->nanoseconds.load() > b->nanoseconds.load();
+      });
+      out << "  " << std::left << std::setw(32) << "timer" << std::right
+	  << std::setw(14) << "count" << std::setw(14) << "total ms"
+	  << std::setw(14) << "mean us" << std::endl;
+      for (const Site* site : sites) {
+	double total = site->nanoseconds.load(), count = site->count.load();
+	out << "  " << std::left << std::setw(32) << site->name << std::right
+	    << std::setw(14) << site->count.load()
+	    << std::fixed << std::setprecision(3)
+	    << std::setw(14) << total / 1e6
+	    << std::setw(14) << total / count / 1e3 << std::endl;
+      }
+      out.unsetf(std::ios::floatfield);
+    }
+
+    void WriteChromeTrace(std::ostream& out) {
+      Registry& registry = TheRegistry();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+
+      out << "{\"traceEvents\":[";
+      const char* separator = "\n";
+      for (const TraceEvent& event : registry.events) {
+	out << separator << "{\"name\":\"";
+	WriteEscaped(out, event.name);
+	out << "\",\"cat\":\"track\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+	    << ",\"ts\":" << event.start_microseconds
+	    << ",\"dur\":" << event.duration_microseconds << "}";
+	separator = ",\n";
+      }
+      out << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{";
+      for (int i = 0; i < kCounterCount; i++) {
+	out << (i > 0 ? "," : "") << "\"" << kCounterNames[i] << "\":" << registry.counters[i].load();
+      }
+      out << "}}" << std::endl;
+    }
+
+  }
+
+}
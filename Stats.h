@@ -0,0 +1,131 @@
+////////////////////////////////////////////////////////////////////////////////
+// Stats.h
+//
+// Timing and counter instrumentation, compiled in only when
+// PACKAGE_TRACKING_STATS is defined.
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic> // std::atomic
+#include <chrono> // std::chrono::steady_clock
+#include <cstdint> // std::uint64_t
+#include <ostream> // std::ostream
+
+namespace PackageTracking {
+
+  namespace Stats {
+
+    // Whether the macros below were compiled in.
+#ifdef PACKAGE_TRACKING_STATS
+    constexpr bool kEnabled = true;
+#else
+    constexpr bool kEnabled = false;
+#endif
+
+    // Quantities counted with TRACK_COUNT.
+    enum class Counter {
+      // Bytes of package files and corpora read or mapped.
+      BytesRead,
+      // Updates scanned out of JSON.
+      UpdatesParsed,
+      // Exceptions thrown by the loaders and by update validation.
+      ExceptionsThrown,
+      // Bytes of update descriptions handed out by Describe functions.
+      OutputBytes,
+    };
+    constexpr int kCounterCount = 4;
+
+    // A place in the code that is timed: its name, and how many times
+    // it ran and for how long in total. Sites register themselves when
+    // constructed, and are never destroyed; the macros below declare
+    // them as function-local statics.
+    class Site {
+    public:
+      // name must be a string literal. If traced, each run is also
+      // recorded as a trace event while tracing is on.
+      Site(const char* name, bool traced);
+
+      Site(const Site&) = delete;
+      Site& operator=(const Site&) = delete;
+
+      const char* const name;
+      const bool traced;
+      std::atomic<std::uint64_t> count{0}, nanoseconds{0};
+      Site* next;
+    };
+
+    // Times its own lifetime, and adds it to a Site.
+    class ScopedTimer {
+    public:
+      explicit ScopedTimer(Site& site) noexcept
+      : site_(site), start_(std::chrono::steady_clock::now()) { }
+
+      ~ScopedTimer();
+
+      ScopedTimer(const ScopedTimer&) = delete;
+      ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+      Site& site_;
+      std::chrono::steady_clock::time_point start_;
+    };
+
+    // Add amount to counter. Lock-free.
+    void Add(Counter counter, std::uint64_t amount) noexcept;
+
+    // Current value of counter.
+    std::uint64_t Get(Counter counter) noexcept;
+
+    // Start or stop recording trace events for traced sites. Off to
+    // begin with; events are kept in memory until written.
+    void SetTracing(bool on) noexcept;
+
+    // Zero every counter and site, and discard trace events.
+    void Reset();
+
+    // Write a human-readable summary: each counter, then each site
+    // that ran, by total time, with its count and mean. Without
+    // PACKAGE_TRACKING_STATS, says only that nothing was recorded.
+    void WriteReport(std::ostream& out);
+
+    // Write the recorded trace events in Chrome's trace event format,
+    // as complete ("X") events with microsecond timestamps, which
+    // chrome://tracing and Perfetto load. Counters are added as
+    // metadata.
+    void WriteChromeTrace(std::ostream& out);
+
+  }
+
+}
+
+// TRACK_TIMER(name) times the rest of the enclosing block under name,
+// in aggregate only; it suits code that runs very many times.
+// TRACK_SPAN(name) does the same, and also records a trace event for
+// each run while tracing is on; it suits coarse phases such as
+// loading a file. TRACK_COUNT(counter, amount) adds to a
+// Stats::Counter, named without its enum prefix. All three compile to
+// nothing, including their arguments, unless PACKAGE_TRACKING_STATS is
+// defined.
+#ifdef PACKAGE_TRACKING_STATS
+
+#define TRACK_CONCAT_(a, b) a##b
+#define TRACK_CONCAT(a, b) TRACK_CONCAT_(a, b)
+#define TRACK_SCOPE_(name, traced)					\
+  static ::PackageTracking::Stats::Site TRACK_CONCAT(track_site_, __LINE__)(name, traced); \
+  ::PackageTracking::Stats::ScopedTimer TRACK_CONCAT(track_timer_, __LINE__)(TRACK_CONCAT(track_site_, __LINE__))
+#define TRACK_TIMER(name) TRACK_SCOPE_(name, false)
+#define TRACK_SPAN(name) TRACK_SCOPE_(name, true)
+#define TRACK_COUNT(counter, amount)					\
+  ::PackageTracking::Stats::Add(::PackageTracking::Stats::Counter::counter, (amount))
+
+#else
+
+#define TRACK_TIMER(name) ((void)0)
+#define TRACK_SPAN(name) ((void)0)
+#define TRACK_COUNT(counter, amount) ((void)0)
+
+#endif
+
+#endif
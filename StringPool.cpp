@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////
+// StringPool.cpp
+//
+// class StringPool
+////////////////////////////////////////////////////////////////////////////////
+
+#include "StringPool.h"
+#include <algorithm> // std::min
+#include <mutex> // std::unique_lock
+
+namespace PackageTracking {
+
+  StringPool::StringPool() {
+    strings_.PushBack(std::string());
+    ids_.emplace(strings_[0], 0);
+  }
+
+  StringId StringPool::Intern(std::string_view text) {
+    {
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+      auto found = ids_.find(text);
+      if (found != ids_.end()) {
+	return found->second;
+      }
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    // another thread may have added it while we were unlocked
+    auto found = ids_.find(text);
+    if (found != ids_.end()) {
+      return found->second;
+    }
+    StringId id = strings_.Size();
+    strings_.PushBack(std::string(text));
+    ids_.emplace(strings_[id], id);
+    return id;
+  }
+
+  bool StringPool::Find(std::string_view text, StringId& id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto found = ids_.find(text);
+    if (found == ids_.end()) {
+      return false;
+    }
+    id = found->second;
+    return true;
+  }
+
+  const std::string& StringPool::Get(StringId id) const {
+    if (id >= strings_.Size()) {
+      throw std::out_of_range("StringId is not in this pool.");
+    }
+    return strings_[id];
+  }
+
+  std::size_t StringPool::Size() const {
+    return strings_.Size();
+  }
+
+  MemoryUsage StringPool::MemoryUsage() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    PackageTracking::MemoryUsage usage;
+    usage.overhead = sizeof(StringPool);
+
+    // the string objects, in the chunks of 64, 128, ... elements that
+    // AppendOnlyVector allocates with new[], which adds a count in
+    // front of each
+    std::size_t size = strings_.Size(), capacity = strings_.Capacity();
+    for (std::size_t first = 0, chunk = 64; first < capacity; first += chunk, chunk *= 2) {
+      std::size_t used = (size > first) ? std::min(size - first, chunk) : 0;
+      usage.AddAllocation(used * sizeof(std::string) + sizeof(std::size_t),
+			  chunk * sizeof(std::string) + sizeof(std::size_t), false);
+    }
+    for (std::size_t i = 0; i < size; i++) {
+      usage.AddString(strings_[i]);
+    }
+
+    // the index: one node per string, holding the next pointer, the
+    // entry and its hash, and the bucket array
+    std::size_t node = sizeof(void*) + sizeof(decltype(ids_)::value_type) + sizeof(std::size_t);
+    for (std::size_t i = 0; i < ids_.size(); i++) {
+      usage.AddAllocation(node, node, false);
+    }
+    std::size_t buckets = ids_.bucket_count() * sizeof(void*);
+    usage.AddAllocation(buckets, buckets, false);
+    return usage;
+  }
+
+  const std::shared_ptr<StringPool>& StringPool::Default() {
+    static const std::shared_ptr<StringPool> pool = std::make_shared<StringPool>();
+    return pool;
+  }
+
+}
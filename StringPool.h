@@ -0,0 +1,88 @@
+////////////////////////////////////////////////////////////////////////////////
+// StringPool.h
+//
+// class StringPool
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <cstdint> // std::uint32_t
+#include <memory> // std::shared_ptr
+#include <shared_mutex> // std::shared_mutex
+#include <stdexcept> // std::out_of_range
+#include <string> // std::string
+#include <string_view> // std::string_view
+#include <unordered_map> // std::unordered_map
+
+#include "AppendOnlyVector.h"
+#include "MemoryUsage.h"
+
+namespace PackageTracking {
+
+  // Compact identifier of one string in a StringPool.
+  using StringId = std::uint32_t;
+
+  // A StringPool interns strings: it stores each distinct string
+  // once, and hands out a StringId for it. Two strings interned into
+  // the same pool are equal exactly when their ids are equal.
+  //
+  // Descriptions such as "Shipment arrived at Amazon facility" repeat
+  // across nearly every package, so ShippingUpdate and PackageStatus
+  // keep ids into a pool instead of their own copies. A pool may be
+  // shared by any number of PackageStatus objects, and is safe to use
+  // from several threads at once. Get and Size never take a lock, so
+  // readers are not held up by threads interning new strings.
+  //
+  // Strings are never removed, so ids and the references returned by
+  // Get stay valid for the lifetime of the pool.
+  class StringPool {
+  public:
+
+    // Default constructor: initialize with only the empty string,
+    // which always has id 0.
+    StringPool();
+
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    // Return the id of the given string, adding it to the pool if it
+    // is not already present.
+    StringId Intern(std::string_view text);
+
+    // If text is in the pool, set id to its id and return true;
+    // otherwise return false. Unlike Intern, this never adds to the
+    // pool, so it suits lookups of strings that may never be stored.
+    bool Find(std::string_view text, StringId& id) const;
+
+    // Return the string with the given id.
+    //
+    // Throws std::out_of_range if id was not handed out by this pool.
+    const std::string& Get(StringId id) const;
+
+    // Number of distinct strings in the pool, including the empty
+    // string.
+    std::size_t Size() const;
+
+    // Memory held by the pool; see MemoryUsage. The text of the
+    // strings is payload; the string objects, and the index used by
+    // Intern and Find, are overhead.
+    PackageTracking::MemoryUsage MemoryUsage() const;
+
+    // The pool used by ShippingUpdate and PackageStatus objects that
+    // are not given one explicitly. It lives until the program exits.
+    static const std::shared_ptr<StringPool>& Default();
+
+  private:
+    mutable std::shared_mutex mutex_;
+
+    // strings_[id] is the string with that id. Its elements never
+    // move, so ids_ can key on views of them. mutex_ guards ids_ and
+    // serializes writers to strings_.
+    AppendOnlyVector<std::string> strings_;
+    std::unordered_map<std::string_view, StringId> ids_;
+  };
+
+}
+
+#endif
@@ -0,0 +1,158 @@
+////////////////////////////////////////////////////////////////////////////////
+// ThreadPool.cpp
+//
+// class ThreadPool
+////////////////////////////////////////////////////////////////////////////////
+
+#include "ThreadPool.h"
+
+#include <algorithm> // std::max
+#include <exception> // std::exception_ptr
+
+namespace PackageTracking {
+
+  namespace {
+
+    // The pool and index of the worker running on this thread, if any.
+    thread_local const ThreadPool* current_pool = nullptr;
+    thread_local unsigned current_worker = 0;
+
+  }
+
+  ThreadPool::ThreadPool(unsigned threads)
+  : queued_(0), pending_(0), stopping_(false), next_worker_(0) {
+    if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < threads; i++) {
+      workers_.push_back(std::make_unique<Worker>());
+    }
+    for (unsigned i = 0; i < threads; i++) {
+      threads_.emplace_back(&ThreadPool::Run, this, i);
+    }
+  }
+
+  ThreadPool::~ThreadPool() {
+    Wait();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  unsigned ThreadPool::Size() const noexcept {
+    return workers_.size();
+  }
+
+  void ThreadPool::Submit(std::function<void()> task) {
+    unsigned index;
+    if (current_pool == this) {
+      index = current_worker;
+    } else {
+      std::lock_guard<std::mutex> lock(mutex_);
+      index = next_worker_++ % workers_.size();
+    }
+    Push(index, std::move(task));
+  }
+
+  void ThreadPool::Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return pending_ == 0; });
+  }
+
+  void ThreadPool::ParallelFor(std::size_t count,
+			       const std::function<void(std::size_t)>& body) {
+    std::mutex done_mutex;
+    std::condition_variable done;
+    std::size_t remaining = count;
+    std::exception_ptr error;
+
+    for (std::size_t i = 0; i < count; i++) {
+      // contiguous blocks, so each worker walks its share in order
+      unsigned index = i * workers_.size() / count;
+      Push(index, [&, i] {
+	std::exception_ptr caught;
+	try {
+	  body(i);
+	} catch (...) {
+	  caught = std::current_exception();
+	}
+	std::lock_guard<std::mutex> lock(done_mutex);
+	if (caught && !error) {
+	  error = caught;
+	}
+	if (--remaining == 0) {
+	  done.notify_all();
+	}
+      });
+    }
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done.wait(lock, [&] { return remaining == 0; });
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  void ThreadPool::Run(unsigned index) {
+    current_pool = this;
+    current_worker = index;
+    std::function<void()> task;
+    while (true) {
+      if (TryTake(index, task)) {
+	task();
+	task = nullptr;
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (--pending_ == 0) {
+	  idle_.notify_all();
+	}
+	continue;
+      }
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this] { return stopping_ || (queued_ > 0); });
+      if (stopping_ && (queued_ == 0)) {
+	return;
+      }
+    }
+  }
+
+  bool ThreadPool::TryTake(unsigned index, std::function<void()>& task) {
+    for (unsigned i = 0; i < workers_.size(); i++) {
+      Worker& worker = *workers_[(index + i) % workers_.size()];
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      if (worker.tasks.empty()) {
+	continue;
+      }
+      if (i == 0) {
+	task = std::move(worker.tasks.front());
+	worker.tasks.pop_front();
+      } else {
+	task = std::move(worker.tasks.back());
+	worker.tasks.pop_back();
+      }
+      std::lock_guard<std::mutex> count_lock(mutex_);
+      queued_--;
+      return true;
+    }
+    return false;
+  }
+
+  void ThreadPool::Push(unsigned index, std::function<void()> task) {
+    // count the task first, so it can never finish before it is counted
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queued_++;
+      pending_++;
+    }
+    {
+      std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+      workers_[index]->tasks.push_back(std::move(task));
+    }
+    wake_.notify_one();
+  }
+
+}
@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////////////
+// ThreadPool.h
+//
+// class ThreadPool
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable> // std::condition_variable
+#include <cstddef> // std::size_t
+#include <deque> // std::deque
+#include <functional> // std::function
+#include <memory> // std::unique_ptr
+#include <mutex> // std::mutex
+#include <thread> // std::thread
+#include <vector> // std::vector
+
+namespace PackageTracking {
+
+  // A fixed set of worker threads that run tasks with work stealing.
+  //
+  // Each worker has its own deque of tasks. A worker takes tasks from
+  // the front of its own deque, and when that is empty it steals from
+  // the back of another worker's deque, so a worker that finishes its
+  // share early takes over work queued behind a slow one.
+  class ThreadPool {
+  public:
+
+    // Start the given number of workers; 0 means one per core.
+    ThreadPool(unsigned threads = 0);
+
+    // Wait for every submitted task to finish, then stop the workers.
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of worker threads.
+    unsigned Size() const noexcept;
+
+    // Queue a task. A task submitted from one of this pool's workers
+    // goes on that worker's deque; other tasks are spread round-robin.
+    // Tasks must not throw.
+    void Submit(std::function<void()> task);
+
+    // Block until every submitted task has finished.
+    void Wait();
+
+    // Call body(i) for every i in [0, count), spread over the workers,
+    // and block until all calls have finished. Each worker starts with
+    // a contiguous block of indices, in order, and steals from the end
+    // of other blocks once its own is done.
+    //
+    // If any call throws, the first exception is rethrown here after
+    // all calls have finished. Must not be called from a task running
+    // on this pool.
+    void ParallelFor(std::size_t count, const std::function<void(std::size_t)>& body);
+
+  private:
+    struct Worker {
+      std::mutex mutex;
+      std::deque<std::function<void()>> tasks;
+    };
+
+    // Main loop of the worker with the given index.
+    void Run(unsigned index);
+
+    // Take a task for the worker with the given index, from its own
+    // deque or by stealing. Returns false if there is none.
+    bool TryTake(unsigned index, std::function<void()>& task);
+
+    // Put a task on the given worker's deque and wake a worker.
+    void Push(unsigned index, std::function<void()> task);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+
+    // queued_ counts tasks in deques, and pending_ counts tasks that
+    // are queued or running; both are guarded by mutex_.
+    std::mutex mutex_;
+    std::condition_variable wake_, idle_;
+    std::size_t queued_, pending_;
+    bool stopping_;
+    unsigned next_worker_;
+  };
+
+}
+
+#endif
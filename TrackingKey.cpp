@@ -0,0 +1,262 @@
+////////////////////////////////////////////////////////////////////////////////
+// TrackingKey.cpp
+//
+// class TrackingKey, and validation of tracking numbers
+////////////////////////////////////////////////////////////////////////////////
+
+#include "TrackingKey.h"
+
+#include <cstring> // std::memcpy, std::memset
+
+#include "Stats.h"
+#include "StringPool.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace PackageTracking {
+
+  namespace {
+
+    // Characters by 6-bit code; code 0 marks an unused character.
+    constexpr char kAlphabet[] =
+      "_0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+    // Return the code of c, or 0 if it cannot be packed.
+    unsigned CharCode(char c) noexcept {
+      if ((c >= '0') && (c <= '9')) {
+	return c - '0' + 1;
+      } else if ((c >= 'A') && (c <= 'Z')) {
+	return c - 'A' + 11;
+      } else if ((c >= 'a') && (c <= 'z')) {
+	return c - 'a' + 37;
+      }
+      return 0;
+    }
+
+    // Bit position of character i packed in place.
+    constexpr unsigned Shift(std::size_t i) noexcept {
+      return 122 - 6 * i;
+    }
+
+    // The code in the top 6 bits of an interned key.
+    constexpr std::uint64_t kInternedMarker = std::uint64_t(63) << 58;
+
+    // The pool of numbers too long to pack in place. Like
+    // StringPool::Default, it lives until the program exits.
+    StringPool& LongNumbers() {
+      static StringPool* pool = new StringPool();
+      return *pool;
+    }
+
+#ifdef __SSE2__
+    // Return a mask with bit i set if byte i of c is 0-9, A-Z or a-z.
+    // Bytes at 0x80 and above are negative, so fail every range.
+    unsigned PackableMask(__m128i c) noexcept {
+      __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+				    _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+      __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)),
+				    _mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+      __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('a' - 1)),
+				    _mm_cmplt_epi8(c, _mm_set1_epi8('z' + 1)));
+      return _mm_movemask_epi8(_mm_or_si128(digit, _mm_or_si128(upper, lower)));
+    }
+#endif
+
+    // Return whether text has 1 to TrackingKey::kMaxLength characters,
+    // all of which can be packed.
+    bool CharactersValid(std::string_view text) noexcept {
+      if (text.empty() || (text.size() > TrackingKey::kMaxLength)) {
+	return false;
+      }
+#ifdef __SSE2__
+      if (text.size() < 16) {
+	// too short to load in place; pad with a packable character
+	char padded[16];
+	std::memset(padded, '0', sizeof(padded));
+	std::memcpy(padded, text.data(), text.size());
+	return PackableMask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(padded))) == 0xffff;
+      }
+      // whole blocks, then one block ending at the last character,
+      // which may overlap the one before
+      const char* data = text.data();
+      for (std::size_t i = 0; i + 16 <= text.size(); i += 16) {
+	if (PackableMask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))) != 0xffff) {
+	  return false;
+	}
+      }
+      const char* tail = data + text.size() - 16;
+      return PackableMask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(tail))) == 0xffff;
+#else
+      for (char c : text) {
+	if (CharCode(c) == 0) {
+	  return false;
+	}
+      }
+      return true;
+#endif
+    }
+
+    // Return whether text, which starts with "1Z", is a UPS number: 18
+    // characters 0-9 and A-Z, the last being a check digit over the 15
+    // before it. Each character's value is its digit, or for a letter
+    // (its code - 63) mod 10, and every second value counts double.
+    bool UpsValid(std::string_view text) noexcept {
+      if (text.size() != 18) {
+	return false;
+      }
+      unsigned sum = 0;
+      for (std::size_t i = 2; i < 17; i++) {
+	char c = text[i];
+	unsigned value;
+	if ((c >= '0') && (c <= '9')) {
+	  value = c - '0';
+	} else if ((c >= 'A') && (c <= 'Z')) {
+	  value = (c - 63) % 10;
+	} else {
+	  return false;
+	}
+	sum += (i % 2 == 0) ? value : 2 * value;
+      }
+      return text[17] == static_cast<char>('0' + (10 - sum % 10) % 10);
+    }
+
+  }
+
+  TrackingKey::TrackingKey() noexcept
+  : words_{0, 0} { }
+
+  TrackingKey::TrackingKey(std::string_view tracking_number) {
+    if (!TryPack(tracking_number, *this)) {
+      TRACK_COUNT(ExceptionsThrown, 1);
+      throw std::invalid_argument("malformed tracking number");
+    }
+  }
+
+  bool TrackingKey::TryPack(std::string_view tracking_number, TrackingKey& key) {
+    return Pack(tracking_number, key, true);
+  }
+
+  bool TrackingKey::TryFind(std::string_view tracking_number, TrackingKey& key) {
+    return Pack(tracking_number, key, false);
+  }
+
+  bool TrackingKey::Pack(std::string_view tracking_number, TrackingKey& key, bool intern) {
+    if (tracking_number.size() > kInlineLength) {
+      if (!CharactersValid(tracking_number)) {
+	return false;
+      }
+      StringId id;
+      if (intern) {
+	id = LongNumbers().Intern(tracking_number);
+      } else if (!LongNumbers().Find(tracking_number, id)) {
+	return false;
+      }
+      key.words_[0] = kInternedMarker | id;
+      key.words_[1] = 0;
+      return true;
+    }
+    if (tracking_number.empty()) {
+      return false;
+    }
+    unsigned __int128 bits = 0;
+    for (std::size_t i = 0; i < tracking_number.size(); i++) {
+      unsigned code = CharCode(tracking_number[i]);
+      if (code == 0) {
+	return false;
+      }
+      bits |= static_cast<unsigned __int128>(code) << Shift(i);
+    }
+    key.words_[0] = static_cast<std::uint64_t>(bits >> 64);
+    key.words_[1] = static_cast<std::uint64_t>(bits);
+    return true;
+  }
+
+  bool TrackingKey::Empty() const noexcept {
+    // the first character is never 0 in a packed key
+    return words_[0] == 0;
+  }
+
+  std::size_t TrackingKey::Length() const {
+    if (Interned()) {
+      return LongNumbers().Get(static_cast<StringId>(words_[0])).size();
+    }
+    unsigned __int128 bits = (static_cast<unsigned __int128>(words_[0]) << 64) | words_[1];
+    std::size_t length = 0;
+    while ((length < kInlineLength) && (((bits >> Shift(length)) & 63) != 0)) {
+      length++;
+    }
+    return length;
+  }
+
+  bool TrackingKey::Interned() const noexcept {
+    return (words_[0] & kInternedMarker) == kInternedMarker;
+  }
+
+  std::string TrackingKey::ToString() const {
+    if (Interned()) {
+      return LongNumbers().Get(static_cast<StringId>(words_[0]));
+    }
+    unsigned __int128 bits = (static_cast<unsigned __int128>(words_[0]) << 64) | words_[1];
+    std::string text;
+    for (std::size_t i = 0; i < kInlineLength; i++) {
+      unsigned code = (bits >> Shift(i)) & 63;
+      if (code == 0) {
+	break;
+      }
+      text += kAlphabet[code];
+    }
+    return text;
+  }
+
+  std::size_t TrackingKey::Hash() const noexcept {
+    std::uint64_t hash = (words_[0] * 0x9e3779b97f4a7c15) ^ words_[1];
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111eb;
+    return hash ^ (hash >> 31);
+  }
+
+  bool TrackingKey::operator==(const TrackingKey& other) const noexcept {
+    // a long number is interned once, so equal keys have equal words
+#ifdef __SSE2__
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words_)),
+      b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(other.words_));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) == 0xffff;
+#else
+    return (words_[0] == other.words_[0]) && (words_[1] == other.words_[1]);
+#endif
+  }
+
+  bool TrackingKey::operator!=(const TrackingKey& other) const noexcept {
+    return !(*this == other);
+  }
+
+  bool TrackingKey::operator<(const TrackingKey& other) const {
+    if (Interned() || other.Interned()) {
+      return ToString() < other.ToString();
+    }
+    return (words_[0] != other.words_[0]) ? (words_[0] < other.words_[0])
+      : (words_[1] < other.words_[1]);
+  }
+
+  bool ValidTrackingNumber(std::string_view tracking_number) noexcept {
+    bool valid;
+    ValidateTrackingNumbers(&tracking_number, 1, &valid);
+    return valid;
+  }
+
+  std::size_t ValidateTrackingNumbers(const std::string_view* tracking_numbers,
+				      std::size_t count,
+				      bool* valid) noexcept {
+    std::size_t valid_count = 0;
+    for (std::size_t i = 0; i < count; i++) {
+      std::string_view text = tracking_numbers[i];
+      valid[i] = CharactersValid(text)
+	&& ((text.compare(0, 2, "1Z") != 0) || UpsValid(text));
+      valid_count += valid[i];
+    }
+    return valid_count;
+  }
+
+}
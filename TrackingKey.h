@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////////
+// TrackingKey.h
+//
+// class TrackingKey, and validation of tracking numbers
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TRACKING_KEY_H
+#define TRACKING_KEY_H
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <stdexcept> // std::invalid_argument
+#include <string> // std::string
+#include <string_view> // std::string_view
+
+namespace PackageTracking {
+
+  // A TrackingKey is a tracking number packed into 16 bytes, for use
+  // as a hash key. A key holds up to 40 of the characters 0-9, A-Z and
+  // a-z.
+  //
+  // Numbers of up to 21 characters, which covers UPS-style numbers
+  // like "1Z4310X3YW25357495", are packed in place at 6 bits a
+  // character. Longer ones, such as 22- and 26-digit USPS numbers,
+  // are interned into a pool of long numbers that lives until the
+  // program exits, and the key holds a marker and the number's id in
+  // the pool, so that the rare long number does not make every key
+  // bigger. Either way, keys compare with one 16-byte vector
+  // comparison and hash with a few multiplies, and they sort in the
+  // same order as their strings, though sorting a long number looks
+  // it up.
+  class TrackingKey {
+  public:
+
+    // Longest tracking number a key can hold, and longest one packed in
+    // place.
+    static constexpr std::size_t kMaxLength = 40;
+    static constexpr std::size_t kInlineLength = 21;
+
+    // Default constructor: the empty key, which no tracking number
+    // packs to.
+    TrackingKey() noexcept;
+
+    // Pack tracking_number.
+    //
+    // Throws std::invalid_argument if it is empty, longer than
+    // kMaxLength, or has a character other than 0-9, A-Z and a-z.
+    explicit TrackingKey(std::string_view tracking_number);
+
+    // If tracking_number can be packed, set key to it and return
+    // true; otherwise return false. A number longer than kInlineLength
+    // is interned if it is new.
+    static bool TryPack(std::string_view tracking_number, TrackingKey& key);
+
+    // As TryPack, but never interns: for a number longer than
+    // kInlineLength that has never been packed, return false. This
+    // suits lookups, since no stored key can have such a number.
+    static bool TryFind(std::string_view tracking_number, TrackingKey& key);
+
+    bool Empty() const noexcept;
+    std::size_t Length() const;
+
+    // Whether the number is held in the pool of long numbers rather
+    // than in the key.
+    bool Interned() const noexcept;
+
+    // Return the tracking number.
+    std::string ToString() const;
+
+    std::size_t Hash() const noexcept;
+
+    bool operator==(const TrackingKey& other) const noexcept;
+    bool operator!=(const TrackingKey& other) const noexcept;
+    bool operator<(const TrackingKey& other) const;
+
+  private:
+    // Pack or find tracking_number into key, interning a long number
+    // only if intern is set.
+    static bool Pack(std::string_view tracking_number, TrackingKey& key, bool intern);
+
+    // In place, the 6-bit code of character i is at bits
+    // [122 - 6i, 128 - 6i) of the 128-bit number words_[0]:words_[1],
+    // and unused characters are 0. An interned key has the code 63,
+    // which no character has, in the top 6 bits of words_[0], the id
+    // in its low 32 bits, and words_[1] = 0.
+    std::uint64_t words_[2];
+  };
+
+  // Hash function object, for std::unordered_map and friends.
+  struct TrackingKeyHash {
+    std::size_t operator()(const TrackingKey& key) const noexcept {
+      return key.Hash();
+    }
+  };
+
+  // Return whether tracking_number is well formed: 1 to 40 of the
+  // characters 0-9, A-Z and a-z, so that it packs into a TrackingKey,
+  // and, if it starts with "1Z", a UPS number of 18 characters whose
+  // last is the correct check digit.
+  bool ValidTrackingNumber(std::string_view tracking_number) noexcept;
+
+  // Check count tracking numbers, starting at tracking_numbers, as
+  // ValidTrackingNumber does, setting valid[i] for each, and return
+  // how many are valid. Numbers are checked one at a time; where SSE2
+  // is available, the characters of each are classified 16 at a time.
+  std::size_t ValidateTrackingNumbers(const std::string_view* tracking_numbers,
+				      std::size_t count,
+				      bool* valid) noexcept;
+
+}
+
+#endif
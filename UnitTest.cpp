@@ -2,16 +2,63 @@
 // UnitTest.cpp
 //
 // Unit tests for the functionality declared in:
+//   StringPool.h
 //   ShippingUpdate.h
 //   PackageStatus.h
 //   Serialize.h
+//   PackageView.h
+//   ThreadPool.h
+//   Ingest.h
+//   Snapshot.h
+//   PackageStore.h
+//   ConcurrentPackage.h
+//   LocationIndex.h
+//   LatestStatusTable.h
+//   TrackingKey.h
+//   Query.h
+//   PackageCache.h
+//   QueryServer.h
+//   Batch.h
+//   PackageWatcher.h
+//   Stats.h
+//   MemoryUsage.h
+//   MemoryReport.h
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <atomic> // std::atomic
+#include <cstdio> // std::rename
+#include <fstream> // std::ofstream
+#include <sstream> // std::istringstream, std::ostringstream
+#include <thread> // std::thread
+
+#include <sys/socket.h> // socket, connect, send, recv
+#include <sys/stat.h> // mkdir
+#include <sys/un.h> // sockaddr_un
+#include <unistd.h> // close
+
 #include "gtest/gtest.h"
 
+#include "StringPool.h"
 #include "ShippingUpdate.h"
 #include "PackageStatus.h"
 #include "Serialize.h"
+#include "PackageView.h"
+#include "ThreadPool.h"
+#include "Ingest.h"
+#include "Snapshot.h"
+#include "PackageStore.h"
+#include "ConcurrentPackage.h"
+#include "LocationIndex.h"
+#include "LatestStatusTable.h"
+#include "TrackingKey.h"
+#include "Query.h"
+#include "PackageCache.h"
+#include "QueryServer.h"
+#include "Batch.h"
+#include "PackageWatcher.h"
+#include "Stats.h"
+#include "MemoryUsage.h"
+#include "MemoryReport.h"
 
 using namespace PackageTracking;
 
@@ -46,6 +93,58 @@ TEST(ShippingUpdate, Describe) {
   EXPECT_EQ("1000 cats dogs\n", b.Describe());
 }
 
+TEST(StringPool, Intern) {
+
+  StringPool pool;
+  EXPECT_EQ(1, pool.Size());
+  EXPECT_EQ(0, pool.Intern(""));
+
+  // each distinct string is stored once
+  StringId hebron = pool.Intern("Hebron, KENTUCKY US");
+  StringId chino = pool.Intern("Chino, US");
+  EXPECT_NE(hebron, chino);
+  EXPECT_EQ(hebron, pool.Intern(std::string("Hebron, KENTUCKY US")));
+  EXPECT_EQ(3, pool.Size());
+  EXPECT_EQ("Hebron, KENTUCKY US", pool.Get(hebron));
+  EXPECT_EQ("Chino, US", pool.Get(chino));
+  EXPECT_THROW(pool.Get(3), std::out_of_range);
+
+  // updates sharing a pool compare by id
+  ShippingUpdate a(pool, chino, hebron, 5), b(pool, chino, hebron, 5),
+    c(pool, hebron, chino, 5);
+  EXPECT_EQ("Chino, US", a.Description());
+  EXPECT_TRUE(a == b);
+  EXPECT_TRUE(a != c);
+  // updates in different pools compare by text
+  EXPECT_TRUE(a == ShippingUpdate("Chino, US", "Hebron, KENTUCKY US", 5));
+
+  // packages can share one pool
+  auto shared = std::make_shared<StringPool>();
+  PackageStatus p("Z1", shared), q("Z2", shared);
+  p.AddUpdate("Out for delivery", "Chino, US", 1);
+  q.AddUpdate("Out for delivery", "Diamond Bar, US", 2);
+  EXPECT_EQ(p.GetCursor().DescriptionId(), q.GetCursor().DescriptionId());
+  EXPECT_EQ(4, shared->Size());
+}
+
+TEST(ShippingUpdate, DescribeTo) {
+
+  ShippingUpdate a("cats", "dogs", -1000);
+  std::string buffer = "> ";
+  a.DescribeTo(buffer);
+  EXPECT_EQ("> -1000 cats dogs\n", buffer);
+
+  std::ostringstream out;
+  a.DescribeTo(out);
+  EXPECT_EQ("-1000 cats dogs\n", out.str());
+
+  std::string pieces;
+  int calls = 0;
+  a.DescribeTo([&](std::string_view piece) { pieces += piece; calls++; });
+  EXPECT_EQ("-1000 cats dogs\n", pieces);
+  EXPECT_LT(1, calls);
+}
+
 TEST(PackageStatusConstructorsAccessors, PackageStatusConstructorsAccessors) {
 
   // Default constructor
@@ -93,6 +192,40 @@ TEST(AddUpdate, AddUpdate) {
   EXPECT_THROW(ps.AddUpdate("d4", "l4", 299), std::invalid_argument);
 }
 
+TEST(AddUpdate, AddUpdates) {
+
+  PackageStatus ps("Z123");
+  ps.AddUpdate(ShippingUpdate("d1", "l1", 100));
+  EXPECT_EQ(1, ps.Size());
+
+  // a batch is added in order, and the cursor stays put
+  std::vector<ShippingUpdate> batch{ShippingUpdate("d2", "l2", 200),
+				    ShippingUpdate("d3", "l3", 200),
+				    ShippingUpdate("d4", "l4", 300)};
+  EXPECT_NO_THROW(ps.AddUpdates(batch));
+  EXPECT_EQ(4, ps.Size());
+  EXPECT_EQ("d1", ps.GetCursor().Description());
+  EXPECT_EQ("100 d1 l1\n200 d2 l2\n200 d3 l3\n300 d4 l4\n", ps.DescribeAllUpdates());
+
+  // a batch out of order within itself, or older than the last
+  // update, is rejected as a whole
+  std::vector<ShippingUpdate> unordered{ShippingUpdate("d5", "l5", 400),
+					ShippingUpdate("d6", "l6", 350)};
+  EXPECT_THROW(ps.AddUpdates(unordered), std::invalid_argument);
+  std::vector<ShippingUpdate> stale{ShippingUpdate("d7", "l7", 299),
+				    ShippingUpdate("d8", "l8", 500)};
+  EXPECT_THROW(ps.AddUpdates(stale), std::invalid_argument);
+  EXPECT_EQ(4, ps.Size());
+
+  // updates from another pool are re-interned
+  auto other = std::make_shared<StringPool>();
+  PackageStatus copy("Z124", other);
+  EXPECT_NO_THROW(copy.AddUpdates(batch));
+  EXPECT_EQ("d2", copy.GetCursor().Description());
+  EXPECT_EQ(other.get(), &copy.GetCursor().Pool());
+  EXPECT_NO_THROW(copy.AddUpdates(nullptr, 0));
+}
+
 TEST(ReadingJSON, PackageStatusFromJSON) {
 
   static const std::string tracking{"1Z4310X3YW25357495"};
@@ -115,6 +248,233 @@ TEST(ReadingJSON, PackageStatusFromJSON) {
   EXPECT_EQ(8, p8.Size());
 }
 
+TEST(ReadingJSON, Streaming) {
+
+  // the tracking number may follow the updates, and unknown members
+  // and extra update elements are skipped
+  std::istringstream reordered(R"({
+    "carrier" : {"name" : "UPS", "codes" : [1, 2, [3]]},
+    "updates" : [["d1", "l1", 100, {"extra" : true}], ["d2", "l2", 200]],
+    "tracking_number" : "Z123"
+  })");
+  PackageStatus p;
+  ASSERT_NO_THROW(p = PackageStatusFromJSON(reordered));
+  EXPECT_EQ("Z123", p.TrackingNumber());
+  EXPECT_EQ("100 d1 l1\n200 d2 l2\n", p.DescribeAllUpdates());
+
+  std::istringstream missing_updates(R"({"tracking_number" : "Z123"})"),
+    short_update(R"({"tracking_number" : "Z", "updates" : [["d1", "l1"]]})"),
+    wrong_type(R"({"tracking_number" : 5, "updates" : []})"),
+    truncated(R"({"tracking_number" : "Z", "updates" : [["d1")"),
+    out_of_order(R"({"tracking_number" : "Z", "updates" : [["d", "l", 2], ["d", "l", 1]]})");
+  EXPECT_THROW(PackageStatusFromJSON(missing_updates), std::invalid_argument);
+  EXPECT_THROW(PackageStatusFromJSON(short_update), std::invalid_argument);
+  EXPECT_THROW(PackageStatusFromJSON(wrong_type), std::invalid_argument);
+  EXPECT_THROW(PackageStatusFromJSON(truncated), std::invalid_argument);
+  EXPECT_THROW(PackageStatusFromJSON(out_of_order), std::invalid_argument);
+  EXPECT_THROW(PackageStatusFromJSON("no_such_file.json"), std::invalid_argument);
+}
+
+TEST(ReadingJSON, PackageViewFromJSON) {
+
+  // views give the same answers as PackageStatus
+  for (auto path : {"package_0.json", "package_1.json", "package_3.json", "package_8.json"}) {
+    PackageStatus status = PackageStatusFromJSON(path);
+    PackageView view;
+    ASSERT_NO_THROW(view = PackageViewFromJSON(path));
+    EXPECT_EQ(status.TrackingNumber(), view.TrackingNumber());
+    EXPECT_EQ(status.Size(), view.Size());
+    EXPECT_EQ(status.DescribeAllUpdates(), view.DescribeAllUpdates());
+    for (int i = 0; i < status.Size(); i++) {
+      ASSERT_TRUE(status.SeekCursor(i));
+      ASSERT_TRUE(view.SeekCursor(i));
+      EXPECT_EQ(status.DescribePreviousUpdates(), view.DescribePreviousUpdates());
+      EXPECT_EQ(status.DescribeFollowingUpdates(), view.DescribeFollowingUpdates());
+      EXPECT_EQ(status.GetCursor().Timestamp(), view.GetCursor().timestamp);
+      std::string pieces;
+      view.DescribeFollowingUpdates([&](std::string_view piece) { pieces += piece; });
+      EXPECT_EQ(status.DescribeFollowingUpdates(), pieces);
+    }
+  }
+
+  PackageView empty = PackageViewFromJSON("package_0.json");
+  EXPECT_THROW(empty.GetCursor(), std::logic_error);
+  EXPECT_THROW(empty.DescribePreviousUpdates(), std::logic_error);
+  EXPECT_EQ("", empty.DescribeAllUpdates());
+  EXPECT_THROW(PackageViewFromJSON("no_such_file.json"), std::invalid_argument);
+
+  // escaped strings are unescaped, and the view outlives the copy it
+  // was made from
+  PackageView copy;
+  {
+    std::string path = testing::TempDir() + "escaped.json";
+    std::ofstream(path) << R"({"tracking_number" : "Z\u0031", "extra" : [{"a" : null}],
+                               "updates" : [["say \"hi\"", "A\u00e9\ud83d\ude00", 1.5e2, false]]})";
+    PackageView view = PackageViewFromJSON(path);
+    copy = view;
+  }
+  EXPECT_EQ("Z1", copy.TrackingNumber());
+  EXPECT_EQ("150 say \"hi\" A\u00e9\U0001F600\n", copy.DescribeAllUpdates());
+}
+
+TEST(ReadingJSON, PackagesFromNDJSON) {
+
+  std::string path = testing::TempDir() + "corpus.ndjson";
+  {
+    std::ofstream corpus(path);
+    corpus << R"({"tracking_number" : "A", "updates" : [["d1", "l1", 100]]})" << "\n"
+	   << "\n"
+	   << R"({"tracking_number" : "B", "updates" : [["d", "l", 2], ["d", "l", 1]]})" << "\n"
+	   << R"({"tracking_number" : "C", "updates" : []} trailing)" << "\n";
+    // enough lines that several threads get a chunk
+    for (int i = 0; i < 5000; i++) {
+      corpus << R"({"tracking_number" : "N)" << i
+	     << R"(", "updates" : [["Out for delivery", "Chino, US", )" << i << "]]}\n";
+    }
+    corpus << R"({"tracking_number" : "Z", "updates" : [)";
+  }
+
+  for (unsigned threads : {1u, 4u}) {
+    CorpusResult result = PackagesFromNDJSON(path, StringPool::Default(), threads);
+    ASSERT_EQ(5001, result.packages.size());
+    EXPECT_EQ("A", result.packages[0].TrackingNumber());
+    EXPECT_EQ("100 d1 l1\n", result.packages[0].DescribeAllUpdates());
+    EXPECT_EQ("N0", result.packages[1].TrackingNumber());
+    EXPECT_EQ("N4999", result.packages[5000].TrackingNumber());
+    EXPECT_EQ(4999, result.packages[5000].GetCursor().Timestamp());
+    ASSERT_EQ(3, result.errors.size());
+    EXPECT_EQ(3, result.errors[0].line);
+    EXPECT_EQ("Given timestamp is invalid.", result.errors[0].message);
+    EXPECT_EQ(4, result.errors[1].line);
+    EXPECT_EQ("JSON parse error", result.errors[1].message);
+    EXPECT_EQ(5005, result.errors[2].line);
+  }
+
+  std::atomic<int> count{0};
+  std::vector<LoadError> errors =
+    ForEachPackageInNDJSON(path, [&](std::size_t, PackageStatus&&) { count++; });
+  EXPECT_EQ(5001, count);
+  EXPECT_EQ(3, errors.size());
+
+  EXPECT_THROW(PackagesFromNDJSON("no_such_file.ndjson"), std::invalid_argument);
+}
+
+TEST(ThreadPool, ParallelFor) {
+
+  ThreadPool pool(4);
+  EXPECT_EQ(4, pool.Size());
+
+  // every index runs exactly once
+  std::vector<std::atomic<int>> hits(1000);
+  pool.ParallelFor(hits.size(), [&](std::size_t i) { hits[i]++; });
+  for (auto& hit : hits) {
+    EXPECT_EQ(1, hit);
+  }
+  pool.ParallelFor(0, [](std::size_t) { FAIL(); });
+
+  // the first exception is rethrown once all calls have finished
+  std::atomic<int> calls{0};
+  EXPECT_THROW(pool.ParallelFor(100, [&](std::size_t i) {
+		 calls++;
+		 if (i == 50) {
+		   throw std::runtime_error("fail");
+		 }
+	       }), std::runtime_error);
+  EXPECT_EQ(100, calls);
+
+  // tasks may submit more tasks
+  std::atomic<int> nested{0};
+  for (int i = 0; i < 10; i++) {
+    pool.Submit([&] {
+      nested++;
+      pool.Submit([&] { nested++; });
+    });
+  }
+  pool.Wait();
+  EXPECT_EQ(20, nested);
+}
+
+TEST(ReadingJSON, PackagesFromDirectory) {
+
+  // the checked-in packages, in sorted order
+  FilesResult result = PackagesFromDirectory(".", "package_*.json", StringPool::Default(), 3);
+  ASSERT_EQ(4, result.packages.size());
+  EXPECT_EQ((std::vector<std::string>{"./package_0.json", "./package_1.json",
+				      "./package_3.json", "./package_8.json"}),
+	    result.paths);
+  EXPECT_EQ(8, result.packages[3].Size());
+  EXPECT_EQ(PackageStatusFromJSON("package_8.json").DescribeAllUpdates(),
+	    result.packages[3].DescribeAllUpdates());
+  EXPECT_TRUE(result.errors.empty());
+
+  // failures are collected in input order
+  result = PackagesFromFiles({"package_1.json", "missing_a.json", "package_3.json", "missing_b.json"});
+  EXPECT_EQ((std::vector<std::string>{"package_1.json", "package_3.json"}), result.paths);
+  ASSERT_EQ(2, result.errors.size());
+  EXPECT_EQ("missing_a.json", result.errors[0].path);
+  EXPECT_EQ("could not open \"missing_a.json\"", result.errors[0].message);
+  EXPECT_EQ("missing_b.json", result.errors[1].path);
+
+  EXPECT_TRUE(PackagesFromGlob("no_such_dir/*.json").packages.empty());
+  EXPECT_THROW(PackagesFromDirectory("no_such_dir"), std::invalid_argument);
+
+  // the directory's name is not a pattern
+  std::string directory = testing::TempDir() + "odd [dir]*?";
+  mkdir(directory.c_str(), 0755);
+  std::ofstream(directory + "/package_a.json")
+    << R"({"tracking_number" : "Z1", "updates" : [["d1", "l1", 100]]})";
+  result = PackagesFromDirectory(directory, "package_*.json");
+  EXPECT_EQ((std::vector<std::string>{directory + "/package_a.json"}), result.paths);
+}
+
+TEST(Snapshot, RoundTrip) {
+
+  std::string path = testing::TempDir() + "package.snapshot";
+
+  // snapshots give the same answers as the package they came from
+  for (auto json_path : {"package_0.json", "package_1.json", "package_3.json", "package_8.json"}) {
+    PackageStatus status = PackageStatusFromJSON(json_path);
+    ASSERT_NO_THROW(WritePackageSnapshot(status, path));
+    PackageSnapshot snapshot;
+    ASSERT_NO_THROW(snapshot = PackageSnapshotFromFile(path));
+    EXPECT_EQ(status.TrackingNumber(), snapshot.TrackingNumber());
+    EXPECT_EQ(status.Size(), snapshot.Size());
+    EXPECT_EQ(status.DescribeAllUpdates(), snapshot.DescribeAllUpdates());
+    for (int i = 0; i < status.Size(); i++) {
+      ASSERT_TRUE(status.SeekCursor(i));
+      ASSERT_TRUE(snapshot.SeekCursor(i));
+      EXPECT_EQ(status.DescribePreviousUpdates(), snapshot.DescribePreviousUpdates());
+      EXPECT_EQ(status.DescribeFollowingUpdates(), snapshot.DescribeFollowingUpdates());
+      EXPECT_EQ(status.GetCursor().Location(), snapshot.GetCursor().location);
+    }
+  }
+
+  PackageSnapshot empty;
+  EXPECT_THROW(empty.GetCursor(), std::logic_error);
+  EXPECT_EQ("", empty.DescribeAllUpdates());
+
+  // damaged files are rejected
+  std::string bytes;
+  {
+    std::ifstream in(path, std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  auto write_damaged = [&](std::size_t position, char value) {
+    std::string damaged = bytes;
+    damaged[position] = value;
+    std::ofstream(path, std::ios::binary) << damaged;
+  };
+  write_damaged(0, 'X');
+  EXPECT_THROW(PackageSnapshotFromFile(path), std::invalid_argument);
+  write_damaged(8, 99);
+  EXPECT_THROW(PackageSnapshotFromFile(path), std::invalid_argument);
+  write_damaged(bytes.size() - 1, bytes.back() ^ 1);
+  EXPECT_THROW(PackageSnapshotFromFile(path), std::invalid_argument);
+  std::ofstream(path, std::ios::binary) << bytes.substr(0, 10);
+  EXPECT_THROW(PackageSnapshotFromFile(path), std::invalid_argument);
+  EXPECT_THROW(PackageSnapshotFromFile("no_such_file.snapshot"), std::invalid_argument);
+}
+
 TEST(CursorMotion, CursorMotion) {
 
   // moving in an empty list has no effect
@@ -216,6 +576,37 @@ TEST(CursorMotion, CursorMotion) {
   EXPECT_EQ(1515978000, p8.GetCursor().Timestamp());
 }
 
+TEST(CursorSeek, CursorSeek) {
+
+  // seeking in an empty list has no effect
+  PackageStatus p0;
+  EXPECT_FALSE(p0.SeekCursor(0));
+  EXPECT_FALSE(p0.MoveCursor(0));
+  EXPECT_FALSE(p0.MoveCursor(1));
+
+  PackageStatus p8;
+  ASSERT_NO_THROW(p8 = PackageStatusFromJSON("package_8.json"));
+  // absolute seeks
+  EXPECT_TRUE(p8.SeekCursor(7));
+  EXPECT_EQ(1516468200, p8.GetCursor().Timestamp());
+  EXPECT_TRUE(p8.SeekCursor(3));
+  EXPECT_EQ(1516366740, p8.GetCursor().Timestamp());
+  // out of range, cursor stays on the fourth update
+  EXPECT_FALSE(p8.SeekCursor(8));
+  EXPECT_FALSE(p8.SeekCursor(-1));
+  EXPECT_EQ(1516366740, p8.GetCursor().Timestamp());
+  // relative moves
+  EXPECT_TRUE(p8.MoveCursor(2));
+  EXPECT_EQ(1516410060, p8.GetCursor().Timestamp());
+  EXPECT_TRUE(p8.MoveCursor(-5));
+  EXPECT_EQ(1515978000, p8.GetCursor().Timestamp());
+  EXPECT_TRUE(p8.MoveCursor(0));
+  // past either end, cursor stays on the first update
+  EXPECT_FALSE(p8.MoveCursor(-1));
+  EXPECT_FALSE(p8.MoveCursor(8));
+  EXPECT_EQ(1515978000, p8.GetCursor().Timestamp());
+}
+
 TEST(PackageStatusDescribe, PackageStatusDescribe) {
 
   // empty
@@ -251,3 +642,1004 @@ TEST(PackageStatusDescribe, PackageStatusDescribe) {
   EXPECT_EQ(descr3, p3.DescribeFollowingUpdates());
   EXPECT_EQ(descr1 + descr2 + descr3, p3.DescribeAllUpdates());
 }
+
+TEST(PackageStatusDescribe, StreamingAndRanges) {
+
+  static const std::string descr1{"1515978000 Package has left seller facility and is in transit to carrier N/A\n"},
+    descr2{"1516111440 Shipment arrived at Amazon facility Hebron, KENTUCKY US\n"},
+    descr3{"1516188120 Shipment departed from Amazon facility Hebron, KENTUCKY US\n"};
+
+  PackageStatus empty;
+  std::ostringstream empty_out;
+  EXPECT_THROW(empty.DescribePreviousUpdates(empty_out), std::logic_error);
+  EXPECT_THROW(empty.DescribeCursorUpdate(empty_out), std::logic_error);
+  EXPECT_NO_THROW(empty.DescribeAllUpdates(empty_out));
+  EXPECT_EQ("", empty_out.str());
+  EXPECT_TRUE(empty.Updates().Empty());
+
+  PackageStatus p3;
+  ASSERT_NO_THROW(p3 = PackageStatusFromJSON("package_3.json"));
+  ASSERT_TRUE(p3.MoveCursorForward());
+
+  std::ostringstream out;
+  p3.DescribePreviousUpdates(out);
+  EXPECT_EQ(descr1, out.str());
+
+  std::string buffer;
+  p3.DescribeFollowingUpdates(buffer);
+  p3.DescribeCursorUpdate(buffer);
+  EXPECT_EQ(descr2 + descr3 + descr2, buffer);
+
+  std::string pieces;
+  p3.DescribeAllUpdates([&](std::string_view piece) { pieces += piece; });
+  EXPECT_EQ(descr1 + descr2 + descr3, pieces);
+
+  // ranges are clamped to the updates that exist
+  EXPECT_EQ(3, p3.Updates().Size());
+  EXPECT_EQ(2, p3.Updates(1, 10).Size());
+  EXPECT_EQ(0, p3.Updates(5, 1).Size());
+  std::string page;
+  p3.Updates(1, 1).DescribeTo(page);
+  EXPECT_EQ(descr2, page);
+
+  std::vector<std::time_t> timestamps;
+  for (ShippingUpdate update : p3.Updates(1, 2)) {
+    timestamps.push_back(update.Timestamp());
+  }
+  EXPECT_EQ((std::vector<std::time_t>{1516111440, 1516188120}), timestamps);
+}
+
+TEST(PackageStatusDescribe, RenderedViews) {
+
+  PackageStatus ps("Z123");
+  ps.AddUpdate("d1", "l1", 100);
+  ps.AddUpdate("d2", "l2", 200);
+  EXPECT_EQ("100 d1 l1\n", ps.DescribeCursorUpdateView());
+  EXPECT_EQ("", ps.DescribePreviousUpdatesView());
+  EXPECT_EQ("100 d1 l1\n200 d2 l2\n", ps.DescribeFollowingUpdatesView());
+
+  // updates added after the first Describe call are picked up
+  ps.AddUpdate("d3", "l3", 300);
+  ASSERT_TRUE(ps.SeekCursor(2));
+  EXPECT_EQ("100 d1 l1\n200 d2 l2\n", ps.DescribePreviousUpdatesView());
+  EXPECT_EQ("300 d3 l3\n", ps.DescribeFollowingUpdatesView());
+  EXPECT_EQ("100 d1 l1\n200 d2 l2\n300 d3 l3\n", ps.DescribeAllUpdates());
+
+  // copies carry their own cache
+  PackageStatus copy = ps;
+  copy.AddUpdate("d4", "l4", 400);
+  EXPECT_EQ("300 d3 l3\n400 d4 l4\n", copy.DescribeFollowingUpdatesView());
+  EXPECT_EQ("300 d3 l3\n", ps.DescribeFollowingUpdatesView());
+}
+
+TEST(PackageStore, ShardedUpdates) {
+
+  PackageStore store(4);
+  EXPECT_EQ(0, store.Size());
+  EXPECT_FALSE(store.Find("missing", [](const PackageStatus&) { FAIL(); }));
+
+  // many threads adding to many packages, enough to grow every shard
+  const int kPackages = 500;
+  ThreadPool pool(4);
+  pool.ParallelFor(kPackages, [&](std::size_t i) {
+    for (std::time_t timestamp : {100, 200, 300}) {
+      store.AddUpdate("Z" + std::to_string(i), "d", "l", timestamp);
+    }
+  });
+  EXPECT_EQ(kPackages, store.Size());
+
+  std::size_t updates = 0;
+  store.ForEach([&](const PackageStatus& package) { updates += package.Size(); });
+  EXPECT_EQ(kPackages * 3, updates);
+
+  ASSERT_TRUE(store.Find("Z42", [](const PackageStatus& package) {
+    EXPECT_EQ("Z42", package.TrackingNumber());
+    EXPECT_EQ(3, package.Size());
+  }));
+  EXPECT_THROW(store.AddUpdate("Z42", "d", "l", 0), std::invalid_argument);
+
+  // Upsert replaces whole packages
+  PackageStatus replacement("Z42");
+  replacement.AddUpdate("new", "here", 500);
+  EXPECT_FALSE(store.Upsert(replacement));
+  EXPECT_TRUE(store.Upsert(PackageStatus("Z999")));
+  EXPECT_EQ(kPackages + 1, store.Size());
+  ASSERT_TRUE(store.Modify("Z42", [](PackageStatus& package) {
+    EXPECT_EQ("500 new here\n", package.DescribeAllUpdates());
+  }));
+}
+
+TEST(ConcurrentPackage, LockFreeReaders) {
+
+  auto pool = std::make_shared<StringPool>();
+  ConcurrentPackage package("Z123", pool);
+  EXPECT_TRUE(package.Read().Empty());
+  EXPECT_THROW(package.Read().Last(), std::logic_error);
+
+  // readers check that every snapshot is a consistent prefix while
+  // the writer keeps appending, interning new strings as it goes
+  const std::size_t kUpdates = 20000;
+  std::atomic<bool> consistent(true);
+  std::thread writer([&] {
+    for (std::size_t i = 0; i < kUpdates; i++) {
+      package.AddUpdate("d" + std::to_string(i), "l", i + 1);
+    }
+  });
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 2; r++) {
+    readers.emplace_back([&] {
+      for (std::size_t seen = 0; seen < kUpdates; ) {
+	ConcurrentPackage::Snapshot snapshot = package.Read();
+	if (snapshot.Size() < seen) {
+	  consistent = false;
+	}
+	seen = snapshot.Size();
+	if (!snapshot.Empty()) {
+	  ShippingUpdate last = snapshot.Last();
+	  if ((last.Timestamp() != static_cast<std::time_t>(seen))
+	      || (last.Description() != "d" + std::to_string(seen - 1))) {
+	    consistent = false;
+	  }
+	}
+      }
+    });
+  }
+  writer.join();
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+  EXPECT_TRUE(consistent);
+  EXPECT_EQ(kUpdates, package.Size());
+  EXPECT_EQ(kUpdates + 2, pool->Size());
+  EXPECT_THROW(package.AddUpdate("d", "l", 1), std::invalid_argument);
+
+  ConcurrentPackage::Snapshot slice = package.Read().Slice(kUpdates - 2, 10);
+  EXPECT_EQ(2, slice.Size());
+  EXPECT_EQ(kUpdates - 1, slice.At(0).Timestamp());
+  EXPECT_THROW(slice.At(2), std::out_of_range);
+  PackageStatus status = package.ToPackageStatus();
+  EXPECT_EQ(kUpdates, status.Size());
+  std::string expected;
+  status.Updates(kUpdates - 2, 2).DescribeTo(expected);
+  EXPECT_EQ(expected, slice.Describe());
+}
+
+TEST(AddUpdate, ReorderWindow) {
+
+  PackageStatus ps("Z123");
+  EXPECT_EQ(0, ps.ReorderWindow());
+  EXPECT_THROW(ps.SetReorderWindow(-1), std::invalid_argument);
+  ps.SetReorderWindow(60);
+  ps.AddUpdate("a", "l", 1000);
+  ps.AddUpdate("c", "l", 1030);
+  ps.AddUpdate("d", "l", 1050);
+  ASSERT_TRUE(ps.SeekCursor(1));
+  EXPECT_EQ("1000 a l\n1030 c l\n1050 d l\n", ps.DescribeAllUpdates());
+
+  // a late update lands in position, and the cursor follows its update
+  ps.AddUpdate("b", "l", 1010);
+  EXPECT_EQ(4, ps.Size());
+  EXPECT_EQ("c", ps.GetCursor().Description());
+  EXPECT_EQ("1000 a l\n1010 b l\n", ps.DescribePreviousUpdatesView());
+  EXPECT_EQ("1000 a l\n1010 b l\n1030 c l\n1050 d l\n", ps.DescribeAllUpdates());
+
+  // equal timestamps keep arrival order; insertions after the cursor
+  // leave it alone
+  ps.AddUpdate("c2", "l", 1030);
+  EXPECT_EQ("c", ps.GetCursor().Description());
+  EXPECT_EQ("1030 c l\n1030 c2 l\n1050 d l\n", ps.DescribeFollowingUpdatesView());
+
+  // too late for the window
+  EXPECT_THROW(ps.AddUpdate("x", "l", 989), std::invalid_argument);
+  EXPECT_EQ(5, ps.Size());
+
+  // batches are checked against a running maximum, all or nothing
+  std::vector<ShippingUpdate> late{ShippingUpdate("e", "l", 1100),
+				   ShippingUpdate("x", "l", 1039)};
+  EXPECT_THROW(ps.AddUpdates(late), std::invalid_argument);
+  EXPECT_EQ(5, ps.Size());
+  late[1] = ShippingUpdate("c3", "l", 1040);
+  ps.AddUpdates(late);
+  EXPECT_EQ("1030 c l\n1030 c2 l\n1040 c3 l\n1050 d l\n1100 e l\n",
+	    ps.DescribeFollowingUpdates());
+}
+
+TEST(PackageStatusDescribe, TimeRanges) {
+
+  PackageStatus ps("Z123");
+  EXPECT_EQ(-1, ps.FirstUpdateAtOrAfter(0));
+  EXPECT_FALSE(ps.SeekCursorToTime(0));
+  EXPECT_TRUE(ps.UpdatesBetween(0, 1000).Empty());
+  ps.AddUpdate("a", "l", 100);
+  ps.AddUpdate("b", "l", 200);
+  ps.AddUpdate("c", "l", 200);
+  ps.AddUpdate("d", "l", 300);
+
+  EXPECT_EQ(0, ps.FirstUpdateAtOrAfter(50));
+  EXPECT_EQ(1, ps.FirstUpdateAtOrAfter(200));
+  EXPECT_EQ(3, ps.FirstUpdateAtOrAfter(201));
+  EXPECT_EQ(-1, ps.FirstUpdateAtOrAfter(301));
+
+  ASSERT_TRUE(ps.SeekCursorToTime(150));
+  EXPECT_EQ("b", ps.GetCursor().Description());
+  EXPECT_FALSE(ps.SeekCursorToTime(400));
+  EXPECT_EQ("b", ps.GetCursor().Description());
+
+  // both ends are inclusive
+  PackageStatus::UpdateRange range = ps.UpdatesBetween(200, 300);
+  EXPECT_EQ(1, range.First());
+  EXPECT_EQ(3, range.Size());
+  EXPECT_TRUE(ps.UpdatesBetween(300, 200).Empty());
+  EXPECT_TRUE(ps.UpdatesBetween(201, 299).Empty());
+  EXPECT_EQ("200 b l\n200 c l\n", ps.DescribeUpdatesBetween(200, 200));
+  EXPECT_EQ("100 a l\n200 b l\n200 c l\n300 d l\n", ps.DescribeUpdatesBetweenView(0, 1000));
+  std::ostringstream out;
+  ps.DescribeUpdatesBetween(250, 1000, out);
+  EXPECT_EQ("300 d l\n", out.str());
+}
+
+TEST(PackageStore, LocationIndex) {
+
+  auto pool = std::make_shared<StringPool>();
+  PackageStore store(4, pool);
+  store.SetReorderWindow(100);
+  LocationIndex index(4);
+  store.AddListener(index);
+
+  store.AddUpdate("Z1", "Arrived", "San Bernardino", 1000);
+  store.AddUpdate("Z2", "Arrived", "San Bernardino", 1500);
+  store.AddUpdate("Z1", "Departed", "San Bernardino", 2000);
+  store.AddUpdate("Z1", "Arrived", "Phoenix", 3000);
+  EXPECT_EQ(4, index.Size());
+  EXPECT_EQ(3, index.Count("San Bernardino", 0, 5000));
+  EXPECT_EQ(0, index.Count("Nowhere", 0, 5000));
+  EXPECT_EQ(0, index.Count("San Bernardino", 2000, 1000));
+
+  std::vector<LocationIndex::Posting> found = index.Lookup("San Bernardino", 1500, 2000);
+  ASSERT_EQ(2, found.size());
+  EXPECT_EQ("Z2", found[0].package.ToString());
+  EXPECT_EQ(0, found[0].position);
+  EXPECT_EQ("Z1", found[1].package.ToString());
+  EXPECT_EQ(1, found[1].position);
+
+  // a late update is indexed in time order, and moves the positions
+  // of the updates after it
+  store.AddUpdate("Z1", "Sorted", "Phoenix", 2950);
+  found = index.Lookup("Phoenix", 0, 5000);
+  ASSERT_EQ(2, found.size());
+  EXPECT_EQ(2950, found[0].timestamp);
+  EXPECT_EQ(2, found[0].position);
+  EXPECT_EQ(3, found[1].position);
+  EXPECT_EQ(1, index.Lookup("San Bernardino", 2000, 2000)[0].position);
+
+  // a late update goes between the postings already at its location
+  store.AddUpdate("Z2", "Sorted", "San Bernardino", 1450);
+  found = index.Lookup("San Bernardino", 0, 5000);
+  ASSERT_EQ(4, found.size());
+  EXPECT_EQ(1000, found[0].timestamp);
+  EXPECT_EQ(1450, found[1].timestamp);
+  EXPECT_EQ(0, found[1].position);
+  EXPECT_EQ(1, found[2].position);
+  EXPECT_EQ(2000, found[3].timestamp);
+
+  // replacing a package replaces its postings
+  PackageStatus replacement("Z1");
+  replacement.AddUpdate("Arrived", "Tucson", 4000);
+  store.Upsert(replacement);
+  EXPECT_EQ(2, index.Count("San Bernardino", 0, 5000));
+  EXPECT_EQ(0, index.Count("Phoenix", 0, 5000));
+  EXPECT_EQ(1, index.Count("Tucson", 4000, 4000));
+  EXPECT_EQ(3, index.Size());
+
+  // tracking numbers are kept by the index, not interned into the pool
+  StringId id;
+  EXPECT_FALSE(pool->Find("Z1", id));
+}
+
+TEST(PackageStore, LatestStatusTable) {
+
+  auto pool = std::make_shared<StringPool>();
+  PackageStore store(4, pool);
+  store.SetReorderWindow(100);
+  LatestStatusTable table(4, pool);
+  store.AddListener(table);
+
+  store.AddUpdate("Z1", "In transit", "Phoenix", 1000);
+  store.AddUpdate("Z1", "Out for delivery", "Phoenix", 2000);
+  store.AddUpdate("Z2", "Out for delivery", "Tucson", 2100);
+  store.AddUpdate("Z3", "Out for delivery", "Phoenix", 2200);
+  store.AddUpdate("Z4", "In transit", "Tucson", 2300);
+  // late, so Z1's latest update stays the same
+  store.AddUpdate("Z1", "Sorted", "Mesa", 1950);
+  EXPECT_EQ(4, table.Size());
+
+  LatestStatusTable::Filter out;
+  out.description = "Out for delivery";
+  EXPECT_EQ(3, table.Count(out));
+  std::unordered_map<StringId, std::size_t> by_location =
+    table.CountBy(LatestStatusTable::Column::Location, out);
+  EXPECT_EQ(2, by_location.size());
+  EXPECT_EQ(2, by_location[pool->Intern("Phoenix")]);
+  EXPECT_EQ(1, by_location[pool->Intern("Tucson")]);
+
+  out.since = 2100;
+  std::vector<LatestStatusTable::Row> rows = table.Select(out);
+  EXPECT_EQ(2, rows.size());
+  LatestStatusTable::Filter nowhere;
+  nowhere.location = "Nowhere";
+  EXPECT_EQ(0, table.Count(nowhere));
+  EXPECT_EQ(4, table.Count(LatestStatusTable::Filter()));
+
+  // replacing and emptying packages
+  PackageStatus delivered("Z2");
+  delivered.AddUpdate("Delivered", "Tucson", 3000);
+  store.Upsert(delivered);
+  store.Upsert(PackageStatus("Z3"));
+  EXPECT_EQ(3, table.Size());
+  out.since = 0;
+  EXPECT_EQ(1, table.Count(out));
+  LatestStatusTable::Filter done;
+  done.description = "Delivered";
+  rows = table.Select(done);
+  ASSERT_EQ(1, rows.size());
+  EXPECT_EQ("Z2", rows[0].package.ToString());
+  EXPECT_EQ(3000, rows[0].timestamp);
+  StringId id;
+  EXPECT_FALSE(pool->Find("Z2", id));
+}
+
+TEST(PackageStatusDescribe, FrozenHistories) {
+
+  PackageStatus ps("Z123");
+  ps.Freeze();
+  EXPECT_FALSE(ps.Frozen());
+  ps.AddUpdate("Shipped", "Seattle", -5);
+  ps.AddUpdate("In transit", "Boise", 1516111440);
+  ps.AddUpdate("In transit", "Boise", 1516111440);
+  ps.AddUpdate("Out for delivery", "Seattle", 1516188120);
+  EXPECT_FALSE(ps.Delivered());
+  std::string all = ps.DescribeAllUpdates();
+  ASSERT_TRUE(ps.SeekCursor(2));
+
+  // a delivery alone does not freeze; size and the cursor need no
+  // decoding
+  ps.AddUpdate("Delivered", "Seattle", 1516200000);
+  all += "1516200000 Delivered Seattle\n";
+  EXPECT_TRUE(ps.Delivered());
+  EXPECT_FALSE(ps.Frozen());
+  ps.Freeze();
+  EXPECT_TRUE(ps.Frozen());
+  EXPECT_TRUE(ps.Delivered());
+  EXPECT_EQ(5, ps.Size());
+  EXPECT_TRUE(ps.MoveCursorForward());
+
+  // reads decode a temporary copy, and leave the history frozen
+  EXPECT_EQ(all, ps.DescribeAllUpdates());
+  EXPECT_EQ("1516188120 Out for delivery Seattle\n", ps.DescribeCursorUpdate());
+  EXPECT_EQ(-5, (*ps.Updates().begin()).Timestamp());
+  EXPECT_EQ(1516188120, ps.GetCursor().Timestamp());
+  EXPECT_EQ(1, ps.FirstUpdateAtOrAfter(0));
+  EXPECT_EQ("1516200000 Delivered Seattle\n", ps.DescribeUpdatesBetween(1516200000, 1516200000));
+  EXPECT_TRUE(ps.Frozen());
+
+  // concurrent const reads are safe
+  std::vector<std::thread> readers;
+  std::atomic<int> matched(0);
+  const PackageStatus& frozen_ps = ps;
+  for (int i = 0; i < 4; i++) {
+    readers.emplace_back([&] {
+      std::string text;
+      frozen_ps.Updates().DescribeTo(text);
+      matched += (text == all);
+    });
+  }
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(4, matched);
+  EXPECT_TRUE(ps.Frozen());
+
+  // copies share the frozen form; a view needs the render cache, so
+  // it decodes in place
+  PackageStatus copy = ps;
+  EXPECT_EQ(all, copy.DescribeAllUpdatesView());
+  EXPECT_FALSE(copy.Frozen());
+  EXPECT_TRUE(ps.Frozen());
+
+  // adding to a frozen history decodes it first
+  ps.AddUpdate("Returned", "Seattle", 1516300000);
+  EXPECT_FALSE(ps.Frozen());
+  EXPECT_EQ(6, ps.Size());
+
+  // the store freezes delivered packages, and reads them without
+  // decoding them in place
+  PackageStore store(1);
+  store.AddUpdate("Z9", "Out for delivery", "Boise", 100);
+  bool frozen = true;
+  ASSERT_TRUE(store.Modify("Z9", [&](PackageStatus& package) { frozen = package.Frozen(); }));
+  EXPECT_FALSE(frozen);
+  store.AddUpdate("Z9", "Delivered", "Boise", 200);
+  store.FreezeDelivered();
+  ASSERT_TRUE(store.Modify("Z9", [&](PackageStatus& package) { frozen = package.Frozen(); }));
+  EXPECT_TRUE(frozen);
+  ASSERT_TRUE(store.Find("Z9", [](const PackageStatus& package) {
+    EXPECT_EQ(2, package.Updates().Size());
+  }));
+  ASSERT_TRUE(store.Modify("Z9", [&](PackageStatus& package) { frozen = package.Frozen(); }));
+  EXPECT_TRUE(frozen);
+
+  // a late update to a delivered package leaves it decoded until its
+  // shard's batch is frozen, and then it is frozen with the update
+  PackageStatus upserted("Z7");
+  upserted.AddUpdate("Delivered", "Boise", 300);
+  store.Upsert(upserted);
+  ASSERT_TRUE(store.Modify("Z7", [&](PackageStatus& package) { frozen = package.Frozen(); }));
+  EXPECT_TRUE(frozen);
+  store.AddUpdate("Z9", "Delivered", "Boise", 250);
+  store.AddUpdate("Z9", "Delivered", "Boise", 260);
+  ASSERT_TRUE(store.Modify("Z9", [&](PackageStatus& package) { frozen = package.Frozen(); }));
+  EXPECT_FALSE(frozen);
+  for (int i = 0; i < 63; i++) {
+    store.AddUpdate("Y" + std::to_string(i), "Delivered", "Boise", 100);
+  }
+  ASSERT_TRUE(store.Find("Z9", [&](const PackageStatus& package) {
+    EXPECT_TRUE(package.Frozen());
+    std::string text;
+    package.Updates().DescribeTo(text);
+    EXPECT_EQ("100 Out for delivery Boise\n200 Delivered Boise\n"
+	      "250 Delivered Boise\n260 Delivered Boise\n", text);
+  }));
+  ASSERT_TRUE(store.Find("Y0", [&](const PackageStatus& package) {
+    EXPECT_TRUE(package.Frozen());
+  }));
+  store.SetFreezeDelivered(false);
+  store.AddUpdate("Z8", "Delivered", "Boise", 200);
+  ASSERT_TRUE(store.Modify("Z8", [&](PackageStatus& package) { frozen = package.Frozen(); }));
+  EXPECT_FALSE(frozen);
+}
+
+TEST(TrackingKey, PackAndValidate) {
+
+  TrackingKey ups("1Z4310X3YW25357495");
+  EXPECT_EQ(16, sizeof(TrackingKey));
+  EXPECT_FALSE(ups.Interned());
+  EXPECT_EQ(18, ups.Length());
+  EXPECT_EQ("1Z4310X3YW25357495", ups.ToString());
+  EXPECT_EQ(ups, TrackingKey("1Z4310X3YW25357495"));
+  EXPECT_NE(ups, TrackingKey("1Z4310X3YW25357496"));
+  EXPECT_EQ(ups.Hash(), TrackingKey("1Z4310X3YW25357495").Hash());
+  EXPECT_TRUE(TrackingKey().Empty());
+
+  // keys sort like their strings
+  EXPECT_TRUE(TrackingKey("A") < TrackingKey("AB"));
+  EXPECT_TRUE(TrackingKey("AZ") < TrackingKey("Aa"));
+  EXPECT_TRUE(TrackingKey("9") < TrackingKey("A"));
+  EXPECT_TRUE(TrackingKey("1234567890") < TrackingKey("1234567890A"));
+  std::string inline_longest(TrackingKey::kInlineLength, 'z');
+  EXPECT_EQ(inline_longest, TrackingKey(inline_longest).ToString());
+  EXPECT_FALSE(TrackingKey(inline_longest).Interned());
+
+  // longer numbers are interned, and still compare, hash and sort
+  // like their strings
+  TrackingKey key;
+  std::string usps = "9274899987654321012345", longest(TrackingKey::kMaxLength, 'z');
+  EXPECT_FALSE(TrackingKey::TryFind(usps, key));
+  EXPECT_TRUE(TrackingKey::TryPack(usps, key));
+  EXPECT_TRUE(key.Interned());
+  EXPECT_EQ(key, TrackingKey(usps));
+  EXPECT_EQ(key.Hash(), TrackingKey(usps).Hash());
+  EXPECT_TRUE(TrackingKey::TryFind(usps, key));
+  EXPECT_EQ(usps, key.ToString());
+  EXPECT_EQ(22, key.Length());
+  EXPECT_EQ(longest, TrackingKey(longest).ToString());
+  EXPECT_EQ(TrackingKey::kMaxLength, TrackingKey(longest).Length());
+  EXPECT_NE(TrackingKey(longest), TrackingKey(longest.substr(1) + "y"));
+  EXPECT_TRUE(TrackingKey(usps) < TrackingKey(inline_longest));
+  EXPECT_TRUE(TrackingKey("9") < TrackingKey(usps));
+  EXPECT_FALSE(TrackingKey(usps) < TrackingKey(usps));
+
+
+  EXPECT_FALSE(TrackingKey::TryPack("", key));
+  EXPECT_FALSE(TrackingKey::TryPack(longest + "z", key));
+  EXPECT_FALSE(TrackingKey::TryPack("1Z-43", key));
+  EXPECT_THROW(TrackingKey("caf\xc3\xa9"), std::invalid_argument);
+
+  std::vector<std::string_view> numbers{
+    "1Z4310X3YW25357495",	// valid check digit
+    "1Z4310X3YW25357496",	// wrong check digit
+    "1Z4310X3YW2535749",	// too short for UPS
+    "9400111899223197428490",	// USPS, 22 digits
+    "Z123",
+    "Z 123",
+    "",
+    "92748999876543210123456789",	// USPS, 26 digits
+    "92748999876543210123456789 ",	// a bad character in the tail block
+    "12345678901234567890123456789012345678901",	// too long
+  };
+  bool valid[10];
+  EXPECT_EQ(4, ValidateTrackingNumbers(numbers.data(), numbers.size(), valid));
+  EXPECT_TRUE(valid[0]);
+  EXPECT_FALSE(valid[1]);
+  EXPECT_FALSE(valid[2]);
+  EXPECT_TRUE(valid[3]);
+  EXPECT_TRUE(valid[4]);
+  EXPECT_FALSE(valid[5]);
+  EXPECT_FALSE(valid[6]);
+  EXPECT_TRUE(valid[7]);
+  EXPECT_FALSE(valid[8]);
+  EXPECT_FALSE(valid[9]);
+
+  // ingestion drops malformed numbers
+  std::string path = ::testing::TempDir() + "malformed.ndjson";
+  std::ofstream(path) << R"({"tracking_number" : "1Z4310X3YW25357495", "updates" : []})" << "\n"
+		      << R"({"tracking_number" : "1Z4310X3YW25357496", "updates" : []})" << "\n"
+		      << R"({"tracking_number" : "not valid", "updates" : []})" << "\n";
+  CorpusResult corpus = PackagesFromNDJSON(path);
+  ASSERT_EQ(1, corpus.packages.size());
+  ASSERT_EQ(2, corpus.errors.size());
+  EXPECT_EQ(2, corpus.errors[0].line);
+  EXPECT_EQ("malformed tracking number", corpus.errors[0].message);
+  EXPECT_EQ(3, corpus.errors[1].line);
+
+  PackageStore store;
+  EXPECT_THROW(store.AddUpdate("not valid", "d", "l", 1), std::invalid_argument);
+  EXPECT_FALSE(store.Find("not valid", [](const PackageStatus&) { }));
+}
+
+TEST(QueryServer, ParseQuery) {
+
+  Query query;
+  std::string error;
+  ASSERT_TRUE(ParseQuery("package_1.json previous 2", query, error));
+  EXPECT_EQ("package_1.json", query.path);
+  EXPECT_EQ(Query::Kind::Select, query.kind);
+  EXPECT_EQ(How::Previous, query.how);
+  EXPECT_EQ(2, query.index);
+  ASSERT_TRUE(ParseQuery("  my packages/p.json  between 10 20\r", query, error));
+  EXPECT_EQ("my packages/p.json", query.path);
+  EXPECT_EQ(Query::Kind::Between, query.kind);
+  EXPECT_EQ(10, query.t0);
+  EXPECT_EQ(20, query.t1);
+  EXPECT_FALSE(ParseQuery("p.json sideways 2", query, error));
+  EXPECT_FALSE(ParseQuery("p.json all x", query, error));
+  EXPECT_FALSE(ParseQuery("all 2", query, error));
+  EXPECT_FALSE(ParseQuery("", query, error));
+}
+
+TEST(QueryServer, AnswersOverSocket) {
+
+  std::string socket_path = ::testing::TempDir() + "track_test.sock",
+    package_path = ::testing::TempDir() + "served_package.json";
+  std::ofstream(package_path) << R"({"tracking_number" : "Z1", "updates" : [["d1", "l1", 100]]})";
+
+  QueryServer server(socket_path, 2);
+  std::thread runner([&] { server.Run(); });
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  socket_path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+  ASSERT_EQ(0, connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)));
+
+  // read one reply: a header line, then for OK its body
+  std::string received;
+  auto fill = [&](std::size_t size) {
+    char chunk[4096];
+    while (received.size() < size) {
+      ssize_t count = recv(fd, chunk, sizeof(chunk), 0);
+      if (count <= 0) {
+	return false;
+      }
+      received.append(chunk, count);
+    }
+    return true;
+  };
+  auto reply = [&]() {
+    std::size_t end;
+    while ((end = received.find('\n')) == std::string::npos) {
+      if (!fill(received.size() + 1)) {
+	return std::string("closed");
+      }
+    }
+    std::string header = received.substr(0, end);
+    received.erase(0, end + 1);
+    if (header.compare(0, 3, "OK ") != 0) {
+      return header;
+    }
+    std::size_t length = std::stoul(header.substr(3));
+    fill(length);
+    std::string body = received.substr(0, length);
+    received.erase(0, length);
+    return body;
+  };
+  auto send_line = [&](const std::string& line) {
+    std::string request = line + "\n";
+    send(fd, request.data(), request.size(), 0);
+  };
+
+  // pipelined queries are answered in order
+  send_line(package_path + " all 0");
+  send_line(package_path + " following 5");
+  send_line("no_such_file.json all 0");
+  send_line("garbage");
+  EXPECT_EQ("100 d1 l1\n", reply());
+  EXPECT_EQ("ERROR index out of range", reply());
+  EXPECT_EQ("ERROR could not open \"no_such_file.json\"", reply());
+  EXPECT_EQ(0, reply().compare(0, 6, "ERROR "));
+
+  // changed files are reloaded
+  std::ofstream(package_path) << R"({"tracking_number" : "Z1", "updates" : [["d1", "l1", 100], )"
+			      << R"(["d2", "l2", 200]]})";
+  send_line(package_path + " between 150 250");
+  EXPECT_EQ("200 d2 l2\n", reply());
+  EXPECT_EQ(2, server.Cache().Loads());
+
+  close(fd);
+  server.Stop();
+  runner.join();
+}
+
+TEST(QueryServer, PackageCacheBounds) {
+
+  std::vector<std::string> paths;
+  for (int i = 0; i < 3; i++) {
+    paths.push_back(::testing::TempDir() + "cached_package_" + std::to_string(i) + ".json");
+    std::ofstream(paths.back()) << R"({"tracking_number" : "Z1", "updates" : [["d1", "l1", 100]]})";
+  }
+  auto query = [](const std::string& path) {
+    Query query;
+    std::string error;
+    EXPECT_TRUE(ParseQuery(path + " all 0", query, error));
+    return query;
+  };
+
+  EXPECT_THROW(PackageCache(0), std::invalid_argument);
+  PackageCache cache(2);
+  std::string buffer;
+  std::size_t default_pool_size = StringPool::Default()->Size();
+
+  // the least recently queried file is dropped
+  cache.Answer(query(paths[0]), buffer);
+  cache.Answer(query(paths[1]), buffer);
+  cache.Answer(query(paths[0]), buffer);
+  cache.Answer(query(paths[2]), buffer);
+  EXPECT_EQ(2, cache.Size());
+  EXPECT_EQ(3, cache.Loads());
+  cache.Answer(query(paths[0]), buffer);
+  EXPECT_EQ(3, cache.Loads());
+  cache.Answer(query(paths[1]), buffer);
+  EXPECT_EQ(4, cache.Loads());
+  EXPECT_EQ("100 d1 l1\n", buffer.substr(0, 10));
+
+  // files that cannot be loaded are not kept, even if they once were
+  EXPECT_THROW(cache.Answer(query("no_such_file.json"), buffer), std::invalid_argument);
+  EXPECT_EQ(2, cache.Size());
+  std::ofstream(paths[1]) << "{";
+  EXPECT_THROW(cache.Answer(query(paths[1]), buffer), std::invalid_argument);
+  EXPECT_EQ(1, cache.Size());
+
+  // nor are their strings, which go into pools of their own
+  EXPECT_EQ(default_pool_size, StringPool::Default()->Size());
+}
+
+TEST(QueryServer, StopsAndRefusesFiles) {
+
+  // only a socket file is replaced
+  std::string file_path = ::testing::TempDir() + "not_a_socket";
+  std::ofstream(file_path) << "keep me";
+  EXPECT_THROW(QueryServer server(file_path), std::invalid_argument);
+  std::ifstream kept(file_path);
+  std::string text;
+  std::getline(kept, text);
+  EXPECT_EQ("keep me", text);
+
+  std::string socket_path = ::testing::TempDir() + "track_stop_test.sock";
+  auto connect_to = [&]() {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    socket_path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+    EXPECT_EQ(0, connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)));
+    return fd;
+  };
+  auto receive_all = [](int fd) {
+    std::string received;
+    char chunk[4096];
+    ssize_t count;
+    while ((count = recv(fd, chunk, sizeof(chunk), 0)) > 0) {
+      received.append(chunk, count);
+    }
+    return received;
+  };
+
+  int idle, flooding;
+  {
+    QueryServer server(socket_path, 1);
+    std::thread runner([&] { server.Run(); });
+
+    // a line that never ends is cut off
+    flooding = connect_to();
+    std::string flood(1 << 16, 'x');
+    send(flooding, flood.data(), flood.size(), 0);
+    EXPECT_EQ("ERROR query is too long\n", receive_all(flooding));
+
+    // an idle connection does not keep the server from stopping
+    idle = connect_to();
+    send(idle, "garbage\n", 8, 0);
+    std::string reply;
+    char c;
+    while ((recv(idle, &c, 1, 0) == 1) && (c != '\n')) {
+      reply += c;
+    }
+    EXPECT_EQ(0, reply.compare(0, 6, "ERROR "));
+    server.Stop();
+    runner.join();
+  }
+  EXPECT_EQ("", receive_all(idle));
+  close(idle);
+  close(flooding);
+}
+
+TEST(QueryServer, ClientsThatDoNotRead) {
+
+  std::string socket_path = ::testing::TempDir() + "track_slow_test.sock",
+    package_path = ::testing::TempDir() + "large_package.json";
+  {
+    std::ofstream out(package_path);
+    out << R"({"tracking_number" : "Z1", "updates" : [)";
+    for (int i = 0; i < 200; i++) {
+      out << (i ? ", " : "") << R"([")" << std::string(40, 'd') << R"(", "l", )" << i << "]";
+    }
+    out << "]}";
+  }
+  auto connect_to = [&]() {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    socket_path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+    EXPECT_EQ(0, connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)));
+    return fd;
+  };
+  auto receive = [](int fd, std::size_t size) {
+    std::string received;
+    char chunk[4096];
+    ssize_t count;
+    while ((received.size() < size) && ((count = recv(fd, chunk, sizeof(chunk), 0)) > 0)) {
+      received.append(chunk, count);
+    }
+    return received;
+  };
+
+  QueryServer server(socket_path, 1);
+  std::thread runner([&] { server.Run(); });
+
+  // megabytes of replies go unread, yet the only worker is not held up
+  int slow = connect_to();
+  std::string queries;
+  for (int i = 0; i < 500; i++) {
+    queries += package_path + " all 0\n";
+  }
+  send(slow, queries.data(), queries.size(), 0);
+  int fast = connect_to();
+  send(fast, "garbage\n", 8, 0);
+  EXPECT_EQ(0, receive(fast, 6).compare(0, 6, "ERROR "));
+  close(fast);
+
+  // and every reply arrives, in full, once the client reads
+  shutdown(slow, SHUT_WR);
+  std::string received = receive(slow, std::string::npos);
+  std::size_t replies = 0, at = 0;
+  while (received.compare(at, 3, "OK ") == 0) {
+    std::size_t end = received.find('\n', at);
+    at = end + 1 + std::stoul(received.substr(at + 3, end - at - 3));
+    replies++;
+  }
+  EXPECT_EQ(500, replies);
+  EXPECT_EQ(received.size(), at);
+  close(slow);
+
+  server.Stop();
+  runner.join();
+}
+
+TEST(Batch, AnswerQueries) {
+
+  std::string path = ::testing::TempDir() + "batch_package.json";
+  std::ofstream(path) << R"({"tracking_number" : "Z1", "updates" : [["d1", "l1", 100], )"
+		      << R"(["d2", "l2", 200]]})";
+
+  std::istringstream input(path + " following 1\n"
+			   "\n"
+			   "no_such_file.json all 0\n" +
+			   path + " all 7\n" +
+			   path + " between 150 250\n");
+  std::ostringstream output;
+  EXPECT_EQ(2, AnswerQueries(input, output, 2));
+  EXPECT_EQ("==> " + path + " following 1 <==\n"
+	    "200 d2 l2\n"
+	    "==> no_such_file.json all 0 <==\n"
+	    "error: could not open \"no_such_file.json\"\n"
+	    "==> " + path + " all 7 <==\n"
+	    "error: index out of range\n"
+	    "==> " + path + " between 150 250 <==\n"
+	    "200 d2 l2\n",
+	    output.str());
+}
+
+TEST(Batch, LongInputInOrder) {
+
+  std::string path = ::testing::TempDir() + "batch_package.json";
+  std::ofstream(path) << R"({"tracking_number" : "Z1", "updates" : [["d1", "l1", 100], )"
+		      << R"(["d2", "l2", 200]]})";
+
+  // more queries than the window holds, alternating between a good
+  // file and a missing one
+  std::string queries, expected;
+  for (int i = 0; i < 500; i++) {
+    std::string query = (i % 2 == 0) ? path + ((i % 4 == 0) ? " previous 1" : " following 1")
+				     : std::string("no_such_file.json all 0");
+    queries += query + "\n";
+    expected += "==> " + query + " <==\n";
+    expected += (i % 2 == 1) ? "error: could not open \"no_such_file.json\"\n"
+			     : (i % 4 == 0) ? "100 d1 l1\n" : "200 d2 l2\n";
+  }
+  std::istringstream input(queries);
+  std::ostringstream output;
+  EXPECT_EQ(250, AnswerQueries(input, output, 2));
+  EXPECT_EQ(expected, output.str());
+}
+
+TEST(ReadingJSON, PackageWatcher) {
+
+  std::string path = ::testing::TempDir() + "watched_package.json";
+  auto write = [&](const std::string& text) {
+    std::ofstream(path) << text;
+  };
+  write(R"({"tracking_number" : "Z1", "updates" : [)" "\n"
+	R"(  ["d1", "l1", 100],)" "\n"
+	R"(  ["d2", "l2", 200])" "\n"
+	"]}\n");
+  PackageWatcher watcher(path);
+  PackageStatus& status = watcher.Status();
+  ASSERT_EQ(2, status.Size());
+  EXPECT_TRUE(status.SeekCursor(1));
+
+  // nothing new
+  EXPECT_EQ(PackageWatcher::Change::None, watcher.Refresh());
+
+  // appended updates are added in place, keeping the cursor
+  write(R"({"tracking_number" : "Z1", "updates" : [)" "\n"
+	R"(  ["d1", "l1", 100],)" "\n"
+	R"(  ["d2", "l2", 200],)" "\n"
+	R"(  ["d3", "l3", 300],)" "\n"
+	R"(  ["d\u0034", "l4", 400])" "\n"
+	"], \"carrier\" : \"UPS\"}\n");
+  EXPECT_EQ(PackageWatcher::Change::Appended, watcher.Wait(1000));
+  EXPECT_EQ(1, watcher.Loads());
+  EXPECT_EQ(&status, &watcher.Status());
+  EXPECT_EQ("200 d2 l2\n300 d3 l3\n400 d4 l4\n", status.DescribeFollowingUpdates());
+  EXPECT_EQ(200, status.GetCursor().Timestamp());
+
+  // an edit before the end is not an append, so the file is reloaded
+  write(R"({"tracking_number" : "Z1", "updates" : [)" "\n"
+	R"(  ["d1", "l1", 100],)" "\n"
+	R"(  ["edited", "l2", 200],)" "\n"
+	R"(  ["d3", "l3", 300],)" "\n"
+	R"(  ["d4", "l4", 400])" "\n"
+	"]}\n");
+  EXPECT_EQ(PackageWatcher::Change::Reloaded, watcher.Refresh());
+  EXPECT_EQ(2, watcher.Loads());
+  EXPECT_EQ("100 d1 l1\n200 edited l2\n300 d3 l3\n400 d4 l4\n", status.DescribeAllUpdates());
+  EXPECT_EQ(200, status.GetCursor().Timestamp());
+
+  // and so is a file replaced by rename, even if it only grew
+  std::string replacement = path + ".new";
+  std::ofstream(replacement) << R"({"tracking_number" : "Z1", "updates" : [)" "\n"
+			     << R"(  ["d1", "l1", 100],)" "\n"
+			     << R"(  ["edited", "l2", 200],)" "\n"
+			     << R"(  ["d3", "l3", 300],)" "\n"
+			     << R"(  ["d4", "l4", 400], ["d5", "l5", 500])" "\n"
+			     << "]}\n";
+  ASSERT_EQ(0, std::rename(replacement.c_str(), path.c_str()));
+  EXPECT_EQ(PackageWatcher::Change::Reloaded, watcher.Wait(1000));
+  EXPECT_EQ(5, status.Size());
+  EXPECT_EQ(3, watcher.Loads());
+
+  // so is an appended update that is out of order
+  write(R"({"tracking_number" : "Z1", "updates" : [)" "\n"
+	R"(  ["d1", "l1", 100],)" "\n"
+	R"(  ["edited", "l2", 200],)" "\n"
+	R"(  ["d3", "l3", 300],)" "\n"
+	R"(  ["d4", "l4", 400], ["late", "l5", 50])" "\n"
+	"]}\n");
+  EXPECT_THROW(watcher.Refresh(), std::invalid_argument);
+  EXPECT_EQ(5, status.Size());
+
+  // and an empty updates array that gains its first update
+  write(R"({"tracking_number" : "Z2", "updates" : []})");
+  EXPECT_EQ(PackageWatcher::Change::Reloaded, watcher.Refresh());
+  EXPECT_TRUE(status.Empty());
+  write(R"({"tracking_number" : "Z2", "updates" : [["d1", "l1", 100]]})");
+  EXPECT_EQ(PackageWatcher::Change::Appended, watcher.Refresh());
+  EXPECT_EQ("100 d1 l1\n", status.DescribeAllUpdates());
+  EXPECT_EQ(4, watcher.Loads());
+}
+
+TEST(Stats, CountersTimersAndTrace) {
+
+  Stats::Reset();
+  Stats::SetTracing(true);
+  Stats::Add(Stats::Counter::OutputBytes, 5);
+  EXPECT_EQ(5, Stats::Get(Stats::Counter::OutputBytes));
+  {
+    static Stats::Site site("test \"span\"", true);
+    Stats::ScopedTimer timer(site);
+  }
+  PackageStatus status = PackageStatusFromJSON("package_8.json");
+  EXPECT_THROW(PackageStatusFromJSON("no_such_file.json"), std::invalid_argument);
+  Stats::SetTracing(false);
+
+  std::ostringstream report, trace;
+  Stats::WriteReport(report);
+  Stats::WriteChromeTrace(trace);
+  EXPECT_NE(std::string::npos, trace.str().find(R"({"name":"test \"span\"","cat":"track","ph":"X","pid":1,)"));
+  if (Stats::kEnabled) {
+    EXPECT_EQ(8, Stats::Get(Stats::Counter::UpdatesParsed));
+    EXPECT_EQ(1, Stats::Get(Stats::Counter::ExceptionsThrown));
+    EXPECT_LT(0, Stats::Get(Stats::Counter::BytesRead));
+    EXPECT_NE(std::string::npos, report.str().find("PackageStatusFromJSON"));
+    EXPECT_NE(std::string::npos, trace.str().find(R"({"name":"PackageStatusFromJSON")"));
+  } else {
+    EXPECT_EQ(0, Stats::Get(Stats::Counter::UpdatesParsed));
+  }
+  Stats::Reset();
+  EXPECT_EQ(0, Stats::Get(Stats::Counter::OutputBytes));
+}
+
+TEST(MemoryUsage, PackagesAndPools) {
+
+  // blocks are sized as glibc's malloc sizes them
+  MemoryUsage block;
+  block.AddAllocation(20, 24);
+  EXPECT_EQ(20, block.payload);
+  EXPECT_EQ(8, block.overhead);
+  EXPECT_EQ(4, block.slack);
+  EXPECT_EQ(32, block.Total());
+
+  // an update is two ids and a timestamp; its text is in the pool
+  ShippingUpdate update("Shipped", "Seattle", 100);
+  EXPECT_EQ(sizeof(StringId) * 2 + sizeof(std::time_t), update.MemoryUsage().payload);
+  EXPECT_EQ(sizeof(ShippingUpdate), update.MemoryUsage().Total());
+
+  // a history grows with its updates, and freezing makes it smaller
+  auto pool = std::make_shared<StringPool>();
+  PackageStatus ps("Z123", pool), other("Z456", pool);
+  MemoryUsage empty = ps.MemoryUsage();
+  EXPECT_EQ(sizeof(PackageStatus), empty.Total());
+  for (int i = 0; i < 100; i++) {
+    ps.AddUpdate("In transit", "Boise", 1000 + i);
+  }
+  MemoryUsage thawed = ps.MemoryUsage();
+  EXPECT_LT(empty.Total(), thawed.Total());
+  EXPECT_LE(100 * (sizeof(StringId) * 2 + sizeof(std::time_t)), thawed.payload);
+  ps.Freeze();
+  ASSERT_TRUE(ps.Frozen());
+  EXPECT_GT(thawed.payload, ps.MemoryUsage().payload);
+
+  // the report counts a shared pool once
+  other.AddUpdate("Delivered", "Boise", 2000);
+  other.Freeze();
+  std::vector<PackageStatus> packages{ps, other};
+  MemoryReport report = ReportMemory(packages);
+  EXPECT_EQ(2, report.packages);
+  EXPECT_EQ(101, report.updates);
+  EXPECT_EQ(1, report.pools);
+  EXPECT_EQ(pool->MemoryUsage().Total(), report.pool_usage.Total());
+  EXPECT_EQ(ps.MemoryUsage().Total() + other.MemoryUsage().Total(), report.package_usage.Total());
+  EXPECT_EQ(report.package_usage.Total() + report.pool_usage.Total(), report.Total().Total());
+
+  std::ostringstream out;
+  WriteMemoryReport(report, out);
+  EXPECT_EQ(0, out.str().find("memory: 2 packages, 101 updates, 2 frozen, 1 string pools\n"));
+  EXPECT_NE(std::string::npos, out.str().find("per update"));
+}
@@ -0,0 +1,101 @@
+////////////////////////////////////////////////////////////////////////////////
+// UpdateCursor.h
+//
+// class template UpdateCursor
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef UPDATE_CURSOR_H
+#define UPDATE_CURSOR_H
+
+namespace PackageTracking {
+
+  // The cursor of a history of updates, shared by PackageStatus and
+  // PackageView: its motion, and the runs of updates the Describe
+  // functions select relative to it.
+  //
+  // Derived inherits from UpdateCursor<Derived> and makes it a
+  // friend. It must have a Size() member, the number of updates, and
+  // a RequireNotEmpty() member that throws std::logic_error when
+  // there are none.
+  template <typename Derived>
+  class UpdateCursor {
+  public:
+
+    // Move the cursor one step backward or forward, to an index, or
+    // delta steps, in constant time. If there are no updates, or the
+    // destination is out of range, these have no effect and return
+    // false.
+    bool MoveCursorBackward() noexcept {
+      return MoveCursor(-1);
+    }
+
+    bool MoveCursorForward() noexcept {
+      return MoveCursor(1);
+    }
+
+    bool SeekCursor(int index) noexcept {
+      if ((index < 0) || (index >= Self().Size())) {
+	return false;
+      }
+      cursor_ = index;
+      return true;
+    }
+
+    bool MoveCursor(int delta) noexcept {
+      int size = Self().Size();
+      if (size == 0) {
+	return false;
+      }
+      // compare against the distance to each end rather than computing
+      // cursor_ + delta, which could overflow
+      if ((delta > 0) ? (delta > size - 1 - cursor_) : (delta < -cursor_)) {
+	return false;
+      }
+      cursor_ += delta;
+      return true;
+    }
+
+  protected:
+    // A run of updates by index, [first, last).
+    struct Range {
+      int first, last;
+    };
+
+    UpdateCursor() noexcept
+    : cursor_(0) { }
+
+    // The update at the cursor, the updates before it, and the updates
+    // from it on. Each throws std::logic_error if there are no
+    // updates.
+    Range CursorRange() const {
+      Self().RequireNotEmpty();
+      return Range{cursor_, cursor_ + 1};
+    }
+
+    Range PreviousRange() const {
+      Self().RequireNotEmpty();
+      return Range{0, cursor_};
+    }
+
+    Range FollowingRange() const {
+      Self().RequireNotEmpty();
+      return Range{cursor_, Self().Size()};
+    }
+
+    // Every update; empty if there are none.
+    Range AllRange() const noexcept {
+      return Range{0, Self().Size()};
+    }
+
+    //index of the update the cursor points at
+    int cursor_;
+
+  private:
+    const Derived& Self() const noexcept {
+      return static_cast<const Derived&>(*this);
+    }
+  };
+
+}
+
+#endif